@@ -3,18 +3,25 @@ precision highp float;
 
 in vec3 Normal;
 in vec3 FragPos;
+in vec3 Color;
+// emissive, roughness
+flat in vec2 MaterialParams;
+// baked ambient occlusion, 1 when open
+in float Occlusion;
 
 out vec4 FragColor;
 
-uniform vec4 color;
-uniform vec4 ambient_dir;
-uniform vec4 ambient_color;
-uniform vec4 light_pos;
-uniform vec4 light_color;
-uniform vec4 camera_eye;
-uniform vec4 fog_color;
-// fog props x and y are near and far start/end for in camera fog
-uniform vec4 fog_props;
+layout (std140) uniform FrameData {
+  mat4 view_proj;
+  vec4 ambient_dir;
+  vec4 ambient_color;
+  vec4 light_pos;
+  vec4 light_color;
+  vec4 camera_eye;
+  vec4 fog_color;
+  // fog props x and y are near and far start/end for in camera fog
+  vec4 fog_props;
+};
 
 float get_fog(float d) {
   if (d>= fog_props.y) return 1.0;
@@ -41,7 +48,15 @@ void main()
     float fog_dist = distance(camera_eye.xyz, FragPos);
     float fog_alpha = get_fog(fog_dist);
 
-    vec3 lit_color = (light_albeto + ambient_albeto) * color.rgb;
+    // highlight from the point light, none at all for fully rough materials
+    float roughness = MaterialParams.y;
+    vec3 view_n = normalize(camera_eye.xyz - FragPos);
+    vec3 half_n = normalize(light_n + view_n);
+    float shininess = mix(64.0, 4.0, roughness);
+    float specular = pow(max(dot(n, half_n), 0.0), shininess) * (1.0 - roughness);
+
+    vec3 lit_color = ((light_albeto + ambient_albeto) * Occlusion + MaterialParams.x) * Color +
+                     specular * light_color.rgb;
     vec3 final_color = mix(lit_color, fog_color.rgb, fog_alpha);
     FragColor = vec4(final_color.r, final_color.g, final_color.b, 1.0f);
 }
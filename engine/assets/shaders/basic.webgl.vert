@@ -1,17 +1,55 @@
 #version 300 es
-in vec3 aPos;
-in vec3 aNormal;
+// MeshVertex: corner position in x y z, face and ambient occlusion in w,
+// palette index in x
+layout (location = 0) in uvec4 aPosFace;
+layout (location = 1) in uvec4 aMaterial;
 
-uniform mat4 view_proj;
+layout (std140) uniform FrameData {
+  mat4 view_proj;
+  vec4 ambient_dir;
+  vec4 ambient_color;
+  vec4 light_pos;
+  vec4 light_color;
+  vec4 camera_eye;
+  vec4 fog_color;
+  // fog props x and y are near and far start/end for in camera fog
+  vec4 fog_props;
+};
+// translation to the chunk's min corner
 uniform mat4 model;
+// GridMaterial entries, params x is emissive and y roughness
+struct Material {
+  vec4 color;
+  vec4 params;
+};
+layout (std140) uniform Palette {
+  // GRID_MAX_COLORS
+  Material materials[256];
+};
+
+// indexed by MeshFace
+const vec3 face_normals[6] = vec3[6](
+    vec3(1.0, 0.0, 0.0), vec3(-1.0, 0.0, 0.0),
+    vec3(0.0, 1.0, 0.0), vec3(0.0, -1.0, 0.0),
+    vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0));
+
+// brightness of each ambient occlusion level, MESH_AO_MAX is open
+const float ao_curve[4] = float[4](0.45, 0.65, 0.85, 1.0);
 
 out vec3 Normal;
 out vec3 FragPos;
+out vec3 Color;
+flat out vec2 MaterialParams;
+out float Occlusion;
 
 void main()
 {
-    vec4 vert = vec4(aPos.x, aPos.y, aPos.z, 1.0);
+    vec4 vert = vec4(vec3(aPosFace.xyz), 1.0);
     gl_Position = view_proj * model * vert;
     FragPos = vec3(model * vert);
-    Normal = aNormal;
+    Normal = face_normals[aPosFace.w & 7u];
+    Material material = materials[aMaterial.x];
+    Color = material.color.rgb;
+    MaterialParams = material.params.xy;
+    Occlusion = ao_curve[(aPosFace.w >> 3) & 3u];
 }
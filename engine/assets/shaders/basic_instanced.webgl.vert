@@ -0,0 +1,44 @@
+#version 300 es
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec3 aOffset;
+layout (location = 3) in uint aPalette;
+
+layout (std140) uniform FrameData {
+  mat4 view_proj;
+  vec4 ambient_dir;
+  vec4 ambient_color;
+  vec4 light_pos;
+  vec4 light_color;
+  vec4 camera_eye;
+  vec4 fog_color;
+  // fog props x and y are near and far start/end for in camera fog
+  vec4 fog_props;
+};
+// GridMaterial entries, params x is emissive and y roughness
+struct Material {
+  vec4 color;
+  vec4 params;
+};
+layout (std140) uniform Palette {
+  // GRID_MAX_COLORS
+  Material materials[256];
+};
+
+out vec3 Normal;
+out vec3 FragPos;
+out vec3 Color;
+flat out vec2 MaterialParams;
+out float Occlusion;
+
+void main()
+{
+    vec4 vert = vec4(aPos + aOffset, 1.0);
+    gl_Position = view_proj * vert;
+    FragPos = vert.xyz;
+    Normal = aNormal;
+    Material material = materials[aPalette & 255u];
+    Color = material.color.rgb;
+    MaterialParams = material.params.xy;
+    Occlusion = 1.0;
+}
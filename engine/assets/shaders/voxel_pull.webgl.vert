@@ -0,0 +1,78 @@
+#version 300 es
+// no vertex inputs: every quad is two words of faces (MESH_FORMAT_FACES),
+// drawn through the shared 0 1 2, 2 3 0 quad indices so gl_VertexID is
+// face * 4 + corner
+
+layout (std140) uniform FrameData {
+  mat4 view_proj;
+  vec4 ambient_dir;
+  vec4 ambient_color;
+  vec4 light_pos;
+  vec4 light_color;
+  vec4 camera_eye;
+  vec4 fog_color;
+  // fog props x and y are near and far start/end for in camera fog
+  vec4 fog_props;
+};
+// translation to the chunk's min corner
+uniform mat4 model;
+// GridMaterial entries, params x is emissive and y roughness
+struct Material {
+  vec4 color;
+  vec4 params;
+};
+layout (std140) uniform Palette {
+  // GRID_MAX_COLORS
+  Material materials[256];
+};
+// rows of DATA_TEXTURE_WIDTH words
+uniform highp usampler2D faces;
+
+// indexed by MeshFace
+const vec3 face_normals[6] = vec3[6](
+    vec3(1.0, 0.0, 0.0), vec3(-1.0, 0.0, 0.0),
+    vec3(0.0, 1.0, 0.0), vec3(0.0, -1.0, 0.0),
+    vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0));
+
+// brightness of each ambient occlusion level, MESH_AO_MAX is open
+const float ao_curve[4] = float[4](0.45, 0.65, 0.85, 1.0);
+
+out vec3 Normal;
+out vec3 FragPos;
+out vec3 Color;
+flat out vec2 MaterialParams;
+out float Occlusion;
+
+void main()
+{
+    int index = (gl_VertexID >> 2) * 2;
+    uint word = texelFetch(faces, ivec2(index & 255, index >> 8), 0).r;
+    // index is even, so both words sit on the same row
+    uint ao = texelFetch(faces, ivec2((index & 255) + 1, index >> 8), 0).r;
+    // flipped quads are split along their other diagonal
+    int corner = ((gl_VertexID & 3) + int(word >> 31)) & 3;
+    uint face = (word >> 12) & 7u;
+    int axis = int(face >> 1);
+    bool positive = (face & 1u) == 0u;
+
+    // corners run counter clockwise seen from the front: the u step comes
+    // first on +axis faces and last on -axis faces
+    vec3 pos = vec3(uvec3(word, word >> 4, word >> 8) & 15u);
+    if (positive)
+        pos[axis] += 1.0;
+    int u_corners = positive ? 6 : 12;
+    int v_corners = positive ? 12 : 6;
+    float width = float(((word >> 15) & 15u) + 1u);
+    float height = float(((word >> 19) & 15u) + 1u);
+    pos[(axis + 1) % 3] += float((u_corners >> corner) & 1) * width;
+    pos[(axis + 2) % 3] += float((v_corners >> corner) & 1) * height;
+
+    vec4 vert = vec4(pos, 1.0);
+    gl_Position = view_proj * model * vert;
+    FragPos = vec3(model * vert);
+    Normal = face_normals[face];
+    Material material = materials[(word >> 23) & 255u];
+    Color = material.color.rgb;
+    MaterialParams = material.params.xy;
+    Occlusion = ao_curve[(ao >> (2 * corner)) & 3u];
+}
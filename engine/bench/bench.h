@@ -0,0 +1,63 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// shared helpers for the CPU benchmarks in bench/. include this first so the
+// posix clock is visible under -std=c99.
+#define _POSIX_C_SOURCE 199309L
+
+#include "voxel/grid.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <time.h>
+
+static inline double bench_now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// small deterministic rng so every run benchmarks the same world.
+static inline uint32_t bench_rand(uint32_t *state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+// rolling hills with a few color bands, roughly what a level looks like.
+static inline void bench_fill_terrain(struct Grid *grid) {
+  for (uint32_t z = 0; z < grid->size_z; ++z) {
+    for (uint32_t x = 0; x < grid->size_x; ++x) {
+      float h = 0.5f + 0.25f * sinf(x * 0.11f) * cosf(z * 0.07f) +
+                0.1f * sinf((x + z) * 0.31f);
+      uint32_t height = (uint32_t)(h * grid->size_y);
+      if (height > grid->size_y)
+        height = grid->size_y;
+      for (uint32_t y = 0; y < height; ++y) {
+        char color = GRID_TAN;
+        if (y + 1 == height)
+          color = GRID_GREEN;
+        else if (y + 4 > height)
+          color = GRID_BEIGE;
+        grid_set(grid, x, y, z, color);
+      }
+    }
+  }
+}
+
+// every cell a random color, the worst case for greedy merging.
+static inline void bench_fill_noise(struct Grid *grid, uint32_t seed) {
+  for (uint32_t z = 0; z < grid->size_z; ++z) {
+    for (uint32_t y = 0; y < grid->size_y; ++y) {
+      for (uint32_t x = 0; x < grid->size_x; ++x) {
+        uint32_t r = bench_rand(&seed);
+        grid_set(grid, x, y, z, (r & 1) ? (char)(1 + (r >> 1) % 10) : 0);
+      }
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,211 @@
+#include "bench.h"
+
+#include "core/jobs.h"
+#include "math/matrix4.h"
+#include "voxel/grid.h"
+#include "voxel/mesher.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define RAY_COUNT (1u << 18)
+#define POINT_COUNT (1u << 22)
+#define EMPTY_JOBS 100000
+#define NESTED_JOBS 64
+
+static float rand_unit(uint32_t *seed) {
+  return (bench_rand(seed) & 0xFFFFFF) / (float)0xFFFFFF;
+}
+
+struct Workload {
+  struct JobSystem *js;
+  struct Grid grid;
+  struct Vector4 *origins;
+  struct Vector4 *directions;
+  uint32_t ray_hits;
+  uint64_t vertex_count;
+  float *points;
+  struct Matrix4 transform;
+  uint64_t sum;
+};
+
+static void sum_range(void *data, uint32_t begin, uint32_t end) {
+  struct Workload *w = (struct Workload *)data;
+  uint64_t sum = 0;
+  for (uint32_t i = begin; i < end; ++i) {
+    sum += i;
+  }
+  __atomic_fetch_add(&w->sum, sum, __ATOMIC_RELAXED);
+}
+
+static void raycast_range(void *data, uint32_t begin, uint32_t end) {
+  struct Workload *w = (struct Workload *)data;
+  uint32_t hits = 0;
+  for (uint32_t i = begin; i < end; ++i) {
+    struct GridRayHit hit;
+    hits += grid_raycast(&w->grid, w->origins[i], w->directions[i], 256.f,
+                         &hit);
+  }
+  __atomic_fetch_add(&w->ray_hits, hits, __ATOMIC_RELAXED);
+}
+
+static void mesh_range(void *data, uint32_t begin, uint32_t end) {
+  struct Workload *w = (struct Workload *)data;
+  struct MeshData mesh = mesh_data_new(MESH_FORMAT_PACKED);
+  uint64_t vertices = 0;
+  for (uint32_t i = begin; i < end; ++i) {
+    mesh_data_clear(&mesh);
+    mesher_build_chunk(&w->grid, i, &mesh);
+    vertices += mesh.vertex_count;
+  }
+  mesh_data_free(&mesh);
+  __atomic_fetch_add(&w->vertex_count, vertices, __ATOMIC_RELAXED);
+}
+
+static void transform_range(void *data, uint32_t begin, uint32_t end) {
+  struct Workload *w = (struct Workload *)data;
+  float *x = w->points, *y = x + POINT_COUNT, *z = y + POINT_COUNT;
+  Matrix4_transform_points_soa(&w->transform, x + begin, y + begin, z + begin,
+                               x + begin, y + begin, z + begin, end - begin);
+}
+
+static void empty_job(void *data) { (void)data; }
+
+// a job that fans out more jobs and waits for them, like a mesh job waiting
+// on the chunks it depends on.
+static void nested_job(void *data) {
+  struct Workload *w = (struct Workload *)data;
+  struct Job jobs[NESTED_JOBS];
+  for (int i = 0; i < NESTED_JOBS; ++i) {
+    jobs[i] = (struct Job){.func = empty_job};
+  }
+  struct JobCounter counter = {0};
+  jobs_run(w->js, jobs, NESTED_JOBS, &counter);
+  jobs_wait(w->js, &counter);
+  __atomic_fetch_add(&w->sum, 1, __ATOMIC_RELAXED);
+}
+
+static int check(struct Workload *w) {
+  w->sum = 0;
+  jobs_parallel_for(w->js, 1000000, 1, sum_range, w);
+  uint64_t expected = 1000000ull * 999999ull / 2;
+  if (w->sum != expected) {
+    printf("parallel_for sum %llu, expected %llu\n",
+           (unsigned long long)w->sum, (unsigned long long)expected);
+    return 1;
+  }
+
+  w->sum = 0;
+  struct Job jobs[NESTED_JOBS];
+  for (int i = 0; i < NESTED_JOBS; ++i) {
+    jobs[i] = (struct Job){.func = nested_job, .data = w};
+  }
+  struct JobCounter counter = {0};
+  jobs_run(w->js, jobs, NESTED_JOBS, &counter);
+  jobs_wait(w->js, &counter);
+  if (w->sum != NESTED_JOBS) {
+    printf("nested jobs finished %llu of %d\n", (unsigned long long)w->sum,
+           NESTED_JOBS);
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  uint32_t max_threads = argc > 1 ? (uint32_t)atoi(argv[1]) : jobs_cpu_count();
+  if (max_threads < 1)
+    max_threads = 1;
+  if (max_threads > JOBS_MAX_WORKERS + 1)
+    max_threads = JOBS_MAX_WORKERS + 1;
+  printf("%u logical cores, testing 1 to %u threads\n", jobs_cpu_count(),
+         max_threads);
+
+  struct Workload w = {0};
+  w.grid = grid_new(256, 64, 256, Vector4_new_point(0.f, 0.f, 0.f));
+  bench_fill_terrain(&w.grid);
+
+  w.origins = (struct Vector4 *)malloc(RAY_COUNT * sizeof(struct Vector4));
+  w.directions = (struct Vector4 *)malloc(RAY_COUNT * sizeof(struct Vector4));
+  uint32_t seed = 11;
+  for (uint32_t i = 0; i < RAY_COUNT; ++i) {
+    w.origins[i] = Vector4_new_point(rand_unit(&seed) * 256.f, 74.f,
+                                     rand_unit(&seed) * 256.f);
+    w.directions[i] = Vector4_new_vector(rand_unit(&seed) - 0.5f, -1.f,
+                                         rand_unit(&seed) - 0.5f);
+  }
+  w.points = (float *)malloc(3 * POINT_COUNT * sizeof(float));
+  for (uint32_t i = 0; i < 3 * POINT_COUNT; ++i) {
+    w.points[i] = rand_unit(&seed);
+  }
+  w.transform = Matrix4_rotation_y(0.001f);
+
+  double base[4] = {0};
+  for (uint32_t threads = 1; threads <= max_threads; ++threads) {
+    struct JobSystem js;
+    if (!jobs_new(&js, threads - 1))
+      return EXIT_FAILURE;
+    w.js = &js;
+
+    if (check(&w)) {
+      jobs_free(&js);
+      return EXIT_FAILURE;
+    }
+
+    double times[4];
+    double start = bench_now_ms();
+    struct Job *empty = (struct Job *)calloc(EMPTY_JOBS, sizeof(struct Job));
+    for (uint32_t i = 0; i < EMPTY_JOBS; ++i) {
+      empty[i].func = empty_job;
+    }
+    struct JobCounter counter = {0};
+    // in slices so the deques never overflow into inline execution
+    for (uint32_t i = 0; i < EMPTY_JOBS; i += JOBS_DEQUE_SIZE / 2) {
+      uint32_t count = EMPTY_JOBS - i < JOBS_DEQUE_SIZE / 2
+                           ? EMPTY_JOBS - i
+                           : JOBS_DEQUE_SIZE / 2;
+      jobs_run(&js, empty + i, count, &counter);
+      jobs_wait(&js, &counter);
+    }
+    free(empty);
+    times[0] = bench_now_ms() - start;
+
+    w.ray_hits = 0;
+    start = bench_now_ms();
+    jobs_parallel_for(&js, RAY_COUNT, 256, raycast_range, &w);
+    times[1] = bench_now_ms() - start;
+
+    w.vertex_count = 0;
+    start = bench_now_ms();
+    jobs_parallel_for(&js, grid_chunk_count(&w.grid), 1, mesh_range, &w);
+    times[2] = bench_now_ms() - start;
+
+    start = bench_now_ms();
+    jobs_parallel_for(&js, POINT_COUNT, 4096, transform_range, &w);
+    times[3] = bench_now_ms() - start;
+
+    uint64_t stolen = 0;
+    for (uint32_t i = 0; i <= js.worker_count; ++i) {
+      stolen += js.stats[i].stolen;
+    }
+    jobs_free(&js);
+
+    if (threads == 1) {
+      for (int i = 0; i < 4; ++i) {
+        base[i] = times[i];
+      }
+    }
+    printf("%2u threads: empty jobs %.0f ns/job, raycast %.1f ms (%.2fx), "
+           "mesh %.1f ms (%.2fx), transform %.1f ms (%.2fx), %llu steals\n",
+           threads, times[0] * 1e6 / EMPTY_JOBS, times[1], base[1] / times[1],
+           times[2], base[2] / times[2], times[3], base[3] / times[3],
+           (unsigned long long)stolen);
+    printf("            %u hits, %llu mesh vertices\n", w.ray_hits,
+           (unsigned long long)w.vertex_count);
+  }
+
+  free(w.origins);
+  free(w.directions);
+  free(w.points);
+  grid_free(&w.grid);
+  return EXIT_SUCCESS;
+}
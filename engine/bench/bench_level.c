@@ -0,0 +1,161 @@
+#include "bench.h"
+
+#include "platform/file.h"
+#include "voxel/level.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LEVEL_SIZE 512
+#define RUNS 3
+
+static char const *const flat_path = "/tmp/bench_level.flat";
+static char const *const raw_path = "/tmp/bench_level_raw.tjlv";
+static char const *const lz_path = "/tmp/bench_level_lz.tjlv";
+
+static long file_size(char const *path) {
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL)
+    return -1;
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fclose(fp);
+  return size;
+}
+
+// the naive format: a small header then one byte per voxel, x fastest.
+static bool write_flat(struct Grid const *grid, char const *path) {
+  FILE *fp = fopen(path, "wb");
+  if (fp == NULL)
+    return false;
+  uint32_t size[3] = {grid->size_x, grid->size_y, grid->size_z};
+  bool ok = fwrite(size, sizeof(size), 1, fp) == 1;
+  char *row = (char *)malloc(grid->size_x);
+  for (uint32_t z = 0; ok && z < grid->size_z; ++z) {
+    for (uint32_t y = 0; ok && y < grid->size_y; ++y) {
+      for (uint32_t x = 0; x < grid->size_x; ++x) {
+        row[x] = grid_get(grid, x, y, z);
+      }
+      ok = fwrite(row, 1, grid->size_x, fp) == grid->size_x;
+    }
+  }
+  free(row);
+  return fclose(fp) == 0 && ok;
+}
+
+// read the whole file, then grid_set every voxel.
+static bool load_flat(struct Grid *grid, char const *path) {
+  struct File file;
+  if (!file_read_all(&file, path))
+    return false;
+  uint32_t size[3];
+  memcpy(size, file.data, sizeof(size));
+  *grid = grid_new(size[0], size[1], size[2], Vector4_new_point(0.f, 0.f, 0.f));
+  char const *voxels = file.data + sizeof(size);
+  for (uint32_t z = 0; z < size[2]; ++z) {
+    for (uint32_t y = 0; y < size[1]; ++y) {
+      for (uint32_t x = 0; x < size[0]; ++x) {
+        char v = *voxels++;
+        if (v != GRID_EMPTY)
+          grid_set(grid, x, y, z, v);
+      }
+    }
+  }
+  file_free(&file);
+  return true;
+}
+
+// sums every solid voxel, which also pulls in the pages a mapping deferred.
+static uint64_t grid_checksum(struct Grid const *grid) {
+  uint64_t sum = 0;
+  for (uint32_t i = 0; i < grid_chunk_count(grid); ++i) {
+    struct GridChunk const *chunk = grid->chunks[i];
+    if (chunk == NULL)
+      continue;
+    for (uint32_t v = 0; v < GRID_CHUNK_VOLUME; ++v) {
+      sum += (uint64_t)(uint8_t)chunk->voxels[v] * (v + 1);
+    }
+  }
+  return sum;
+}
+
+static bool grids_equal(struct Grid const *a, struct Grid const *b) {
+  if (grid_chunk_count(a) != grid_chunk_count(b))
+    return false;
+  static char va[GRID_CHUNK_VOLUME], vb[GRID_CHUNK_VOLUME];
+  for (uint32_t i = 0; i < grid_chunk_count(a); ++i) {
+    grid_chunk_read(a, i, va);
+    grid_chunk_read(b, i, vb);
+    if (memcmp(va, vb, GRID_CHUNK_VOLUME) != 0)
+      return false;
+  }
+  return true;
+}
+
+int main(void) {
+  struct Grid grid = grid_new(LEVEL_SIZE, LEVEL_SIZE, LEVEL_SIZE,
+                              Vector4_new_point(0.f, 0.f, 0.f));
+  bench_fill_terrain(&grid);
+  uint64_t expected = grid_checksum(&grid);
+  // a material past the built in colors, saved with the palette
+  struct GridMaterial glow = {.color = {1.f, 0.8f, 0.2f, 1.f},
+                              .emissive = 2.f,
+                              .roughness = 0.25f};
+  grid_set_material(&grid, 200, &glow);
+
+  if (!write_flat(&grid, flat_path) || !level_save(&grid, raw_path, false) ||
+      !level_save(&grid, lz_path, true)) {
+    printf("Failed to write the test levels\n");
+    return EXIT_FAILURE;
+  }
+  printf("%u^3 level, %.1f MB of chunks\n", LEVEL_SIZE,
+         grid_memory_usage(&grid) / (1024.0 * 1024.0));
+  printf("  flat %.1f MB, raw %.1f MB, lz %.1f MB\n",
+         file_size(flat_path) / (1024.0 * 1024.0),
+         file_size(raw_path) / (1024.0 * 1024.0),
+         file_size(lz_path) / (1024.0 * 1024.0));
+
+  // the files were just written so every run reads from the page cache
+  double best[3] = {1e30, 1e30, 1e30}, touched[3] = {1e30, 1e30, 1e30};
+  for (int run = 0; run < RUNS; ++run) {
+    for (int mode = 0; mode < 3; ++mode) {
+      struct Grid loaded;
+      struct FileMap map = {0};
+      double start = bench_now_ms();
+      bool ok = mode == 0   ? load_flat(&loaded, flat_path)
+                : mode == 1 ? level_load(&loaded, &map, raw_path)
+                            : level_load(&loaded, &map, lz_path);
+      double load = bench_now_ms() - start;
+      if (!ok)
+        return EXIT_FAILURE;
+      uint64_t sum = grid_checksum(&loaded);
+      double total = bench_now_ms() - start;
+      bool palette_ok =
+          mode == 0 || memcmp(grid.palette, loaded.palette,
+                              sizeof(grid.palette)) == 0;
+      if (sum != expected || !palette_ok ||
+          (run == 0 && !grids_equal(&grid, &loaded))) {
+        printf("mode %d loaded a different level\n", mode);
+        return EXIT_FAILURE;
+      }
+      best[mode] = load < best[mode] ? load : best[mode];
+      touched[mode] = total < touched[mode] ? total : touched[mode];
+      grid_free(&loaded);
+      file_unmap(&map);
+    }
+  }
+
+  char const *names[3] = {"fread + grid_set", "mmap raw", "lz"};
+  for (int mode = 0; mode < 3; ++mode) {
+    printf("  %-16s load %8.2f ms, load + touch every voxel %8.2f ms "
+           "(%.1fx)\n",
+           names[mode], best[mode], touched[mode], touched[0] / touched[mode]);
+  }
+
+  grid_free(&grid);
+  remove(flat_path);
+  remove(raw_path);
+  remove(lz_path);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,341 @@
+#include "bench.h"
+
+#include "math/matrix4.h"
+#include "math/simd.h"
+#include "math/vector4.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CHECK_COUNT 1000000
+#define BENCH_COUNT 4096
+#define BENCH_ROUNDS 2000
+#define POINT_COUNT (1 << 16)
+#define POINT_ROUNDS 200
+
+static float rand_float(uint32_t *seed) {
+  return (bench_rand(seed) & 0xFFFFFF) / (float)0xFFFFFF * 4.f - 2.f;
+}
+
+static struct Vector4 rand_vector(uint32_t *seed) {
+  return (struct Vector4){rand_float(seed), rand_float(seed), rand_float(seed),
+                          rand_float(seed)};
+}
+
+static struct Matrix4 rand_matrix(uint32_t *seed) {
+  struct Matrix4 m;
+  for (int i = 0; i < 16; ++i) {
+    m.f[i] = rand_float(seed);
+  }
+  return m;
+}
+
+// the largest difference relative to the magnitude of the reference values.
+static float relative_error(float const *a, float const *b, int count) {
+  float scale = 1.f;
+  float error = 0.f;
+  for (int i = 0; i < count; ++i) {
+    if (fabsf(b[i]) > scale)
+      scale = fabsf(b[i]);
+  }
+  for (int i = 0; i < count; ++i) {
+    float e = fabsf(a[i] - b[i]);
+    if (e > error)
+      error = e;
+  }
+  return error / scale;
+}
+
+struct Check {
+  char const *name;
+  float tolerance;
+  float worst;
+  int failures;
+};
+
+static void check_result(struct Check *check, float const *simd,
+                         float const *scalar, int count) {
+  float error = relative_error(simd, scalar, count);
+  if (error > check->worst)
+    check->worst = error;
+  if (!(error <= check->tolerance))
+    ++check->failures;
+}
+
+static int check(void) {
+  // everything but the inverse does the same operations in the same order,
+  // so any difference at all is a bug. the inverse uses a different
+  // factorization and is compared against well conditioned inputs.
+  struct Check checks[] = {
+      {"Matrix4_multiply", 0.f, 0.f, 0},  {"Matrix4_transform", 0.f, 0.f, 0},
+      {"Matrix4_invert", 1e-3f, 0.f, 0},  {"Vector4_lerp", 0.f, 0.f, 0},
+      {"Vector4_add", 0.f, 0.f, 0},       {"Vector4_subtract", 0.f, 0.f, 0},
+      {"Vector4_scale", 0.f, 0.f, 0},
+  };
+  int check_count = sizeof(checks) / sizeof(checks[0]);
+
+  uint32_t seed = 1234;
+  for (int i = 0; i < CHECK_COUNT; ++i) {
+    struct Matrix4 a = rand_matrix(&seed);
+    struct Matrix4 b = rand_matrix(&seed);
+    struct Vector4 u = rand_vector(&seed);
+    struct Vector4 v = rand_vector(&seed);
+    float t = rand_float(&seed);
+
+    struct Matrix4 m1 = Matrix4_multiply(&a, &b);
+    struct Matrix4 m2 = Matrix4_multiply_scalar(&a, &b);
+    check_result(&checks[0], m1.f, m2.f, 16);
+
+    struct Vector4 v1 = Matrix4_transform(&a, u);
+    struct Vector4 v2 = Matrix4_transform_scalar(&a, u);
+    check_result(&checks[1], &v1.x, &v2.x, 4);
+
+    // rotation, scale and translation like the engine actually inverts, plus
+    // a perspective projection every so often
+    struct Matrix4 r = Matrix4_rotation_y(t);
+    struct Matrix4 s = Matrix4_scale(1.f + fabsf(u.x), 1.f + fabsf(u.y),
+                                     1.f + fabsf(u.z));
+    struct Matrix4 tr = Matrix4_translation(v.x * 50.f, v.y * 50.f, v.z);
+    struct Matrix4 rs = Matrix4_multiply_scalar(&r, &s);
+    struct Matrix4 affine = Matrix4_multiply_scalar(&tr, &rs);
+    if (i % 4 == 0) {
+      struct Matrix4 p =
+          Matrix4_perspective(1.2f, 1.f + fabsf(t), 0.1f, 150.f);
+      affine = Matrix4_multiply_scalar(&p, &affine);
+    }
+    m1 = Matrix4_invert(&affine);
+    m2 = Matrix4_invert_scalar(&affine);
+    check_result(&checks[2], m1.f, m2.f, 16);
+
+    v1 = Vector4_lerp(u, v, t);
+    v2 = Vector4_lerp_scalar(u, v, t);
+    check_result(&checks[3], &v1.x, &v2.x, 4);
+
+    v1 = Vector4_add(u, v);
+    v2 = Vector4_add_scalar(u, v);
+    check_result(&checks[4], &v1.x, &v2.x, 4);
+
+    v1 = Vector4_subtract(u, v);
+    v2 = Vector4_subtract_scalar(u, v);
+    check_result(&checks[5], &v1.x, &v2.x, 4);
+
+    v1 = Vector4_scale(u, t);
+    v2 = Vector4_scale_scalar(u, t);
+    check_result(&checks[6], &v1.x, &v2.x, 4);
+  }
+
+  int failures = 0;
+  for (int i = 0; i < check_count; ++i) {
+    printf("%-18s %d / %d mismatches, worst relative error %g\n",
+           checks[i].name, checks[i].failures, CHECK_COUNT, checks[i].worst);
+    failures += checks[i].failures;
+  }
+  return failures != 0;
+}
+
+// the batch transforms against Matrix4_transform_scalar one point at a time.
+// the soa path sums in pairs, so it is allowed a few ulps.
+static int check_batch(void) {
+  enum { COUNT = 1003 }; // not a multiple of 4 so the tail runs too
+  static struct Vector4 aos[COUNT], aos_out[COUNT], proj_out[COUNT];
+  static float x[COUNT], y[COUNT], z[COUNT];
+  static float ox[COUNT], oy[COUNT], oz[COUNT];
+  static float px[COUNT], py[COUNT], pz[COUNT];
+
+  uint32_t seed = 77;
+  struct Matrix4 p = Matrix4_perspective(1.2f, 1.5f, 0.1f, 150.f);
+  struct Matrix4 c = Matrix4_lookat(Vector4_new_point(3.f, 8.f, 20.f),
+                                    Vector4_zero_point(),
+                                    Vector4_new_vector(0.f, 1.f, 0.f));
+  struct Matrix4 vp = Matrix4_multiply_scalar(&p, &c);
+  for (int i = 0; i < COUNT; ++i) {
+    // all well in front of the camera, w near 0 would amplify any rounding
+    aos[i] = Vector4_new_point(rand_float(&seed) * 5.f,
+                               rand_float(&seed) * 5.f,
+                               rand_float(&seed) * 5.f);
+    x[i] = aos[i].x;
+    y[i] = aos[i].y;
+    z[i] = aos[i].z;
+  }
+
+  Matrix4_transform_array(&vp, aos, aos_out, COUNT);
+  Matrix4_project_array(&vp, aos, proj_out, COUNT);
+  Matrix4_transform_points_soa(&vp, x, y, z, ox, oy, oz, COUNT);
+  Matrix4_project_points_soa(&vp, x, y, z, px, py, pz, COUNT);
+
+  struct Check checks[] = {
+      {"transform_array", 0.f, 0.f, 0},
+      {"project_array", 0.f, 0.f, 0},
+      {"transform_soa", 1e-6f, 0.f, 0},
+      {"project_soa", 1e-5f, 0.f, 0},
+  };
+  for (int i = 0; i < COUNT; ++i) {
+    struct Vector4 r = Matrix4_transform_scalar(&vp, aos[i]);
+    check_result(&checks[0], &aos_out[i].x, &r.x, 4);
+    struct Vector4 projected = Vector4_scale_scalar(r, 1.f / r.w);
+    check_result(&checks[1], &proj_out[i].x, &projected.x, 4);
+    float soa[3] = {ox[i], oy[i], oz[i]};
+    check_result(&checks[2], soa, &r.x, 3);
+    float soa_projected[3] = {px[i], py[i], pz[i]};
+    check_result(&checks[3], soa_projected, &projected.x, 3);
+  }
+
+  int failures = 0;
+  for (int i = 0; i < 4; ++i) {
+    printf("%-18s %d / %d mismatches, worst relative error %g\n",
+           checks[i].name, checks[i].failures, COUNT, checks[i].worst);
+    failures += checks[i].failures;
+  }
+  return failures != 0;
+}
+
+// volatile sink so the timed loops can't be thrown away.
+static volatile float g_sink;
+
+static void report_points(char const *name, double ms) {
+  double points = (double)POINT_COUNT * POINT_ROUNDS;
+  printf("%-24s %.1f M points/s\n", name, points / ms / 1000.0);
+}
+
+static void bench_batch(void) {
+  struct Vector4 *aos =
+      (struct Vector4 *)malloc(POINT_COUNT * sizeof(struct Vector4));
+  struct Vector4 *aos_out =
+      (struct Vector4 *)malloc(POINT_COUNT * sizeof(struct Vector4));
+  float *soa = (float *)malloc(6 * POINT_COUNT * sizeof(float));
+  float *x = soa, *y = x + POINT_COUNT, *z = y + POINT_COUNT;
+  float *ox = z + POINT_COUNT, *oy = ox + POINT_COUNT, *oz = oy + POINT_COUNT;
+
+  uint32_t seed = 3;
+  for (int i = 0; i < POINT_COUNT; ++i) {
+    aos[i] = Vector4_new_point(rand_float(&seed), rand_float(&seed),
+                               rand_float(&seed) - 5.f);
+    x[i] = aos[i].x;
+    y[i] = aos[i].y;
+    z[i] = aos[i].z;
+  }
+  struct Matrix4 m = Matrix4_perspective(1.2f, 1.5f, 0.1f, 150.f);
+
+  double start = bench_now_ms();
+  for (int round = 0; round < POINT_ROUNDS; ++round) {
+    for (int i = 0; i < POINT_COUNT; ++i) {
+      aos_out[i] = Matrix4_transform_scalar(&m, aos[i]);
+    }
+    g_sink = aos_out[round].x;
+  }
+  report_points("transform (one by one)", bench_now_ms() - start);
+
+  start = bench_now_ms();
+  for (int round = 0; round < POINT_ROUNDS; ++round) {
+    Matrix4_transform_array(&m, aos, aos_out, POINT_COUNT);
+    g_sink = aos_out[round].x;
+  }
+  report_points("transform_array", bench_now_ms() - start);
+
+  start = bench_now_ms();
+  for (int round = 0; round < POINT_ROUNDS; ++round) {
+    Matrix4_transform_points_soa(&m, x, y, z, ox, oy, oz, POINT_COUNT);
+    g_sink = ox[round];
+  }
+  report_points("transform_points_soa", bench_now_ms() - start);
+
+  start = bench_now_ms();
+  for (int round = 0; round < POINT_ROUNDS; ++round) {
+    Matrix4_project_array(&m, aos, aos_out, POINT_COUNT);
+    g_sink = aos_out[round].x;
+  }
+  report_points("project_array", bench_now_ms() - start);
+
+  start = bench_now_ms();
+  for (int round = 0; round < POINT_ROUNDS; ++round) {
+    Matrix4_project_points_soa(&m, x, y, z, ox, oy, oz, POINT_COUNT);
+    g_sink = ox[round];
+  }
+  report_points("project_points_soa", bench_now_ms() - start);
+
+  free(aos);
+  free(aos_out);
+  free(soa);
+}
+
+static void report(char const *name, double simd_ms, double scalar_ms) {
+  double ops = (double)BENCH_COUNT * BENCH_ROUNDS;
+  printf("%-18s simd %.2f ns/op, scalar %.2f ns/op, %.2fx\n", name,
+         simd_ms * 1e6 / ops, scalar_ms * 1e6 / ops, scalar_ms / simd_ms);
+}
+
+int main(void) {
+#if MATH_SIMD_SSE
+  printf("backend: sse\n");
+#elif MATH_SIMD_WASM
+  printf("backend: wasm simd128\n");
+#elif MATH_SIMD_NEON
+  printf("backend: neon\n");
+#else
+  printf("backend: scalar\n");
+#endif
+
+  if (check() || check_batch())
+    return EXIT_FAILURE;
+
+  struct Matrix4 *matrices =
+      (struct Matrix4 *)malloc(BENCH_COUNT * sizeof(struct Matrix4));
+  struct Vector4 *vectors =
+      (struct Vector4 *)malloc(BENCH_COUNT * sizeof(struct Vector4));
+  uint32_t seed = 42;
+  for (int i = 0; i < BENCH_COUNT; ++i) {
+    struct Matrix4 t =
+        Matrix4_translation(rand_float(&seed), rand_float(&seed), 1.f);
+    struct Matrix4 r = Matrix4_rotation_x(rand_float(&seed));
+    matrices[i] = Matrix4_multiply_scalar(&t, &r);
+    vectors[i] = rand_vector(&seed);
+  }
+
+  // each benchmark is a chain through the arrays so the compiler can't hoist
+  // anything out of the loop.
+#define BENCH_KERNEL(name, expr)                                               \
+  do {                                                                         \
+    double times[2];                                                           \
+    for (int pass = 0; pass < 2; ++pass) {                                     \
+      int scalar = pass;                                                       \
+      float sum = 0.f;                                                         \
+      double start = bench_now_ms();                                           \
+      for (int round = 0; round < BENCH_ROUNDS; ++round) {                     \
+        for (int i = 0; i < BENCH_COUNT; ++i) {                                \
+          struct Matrix4 const *a = &matrices[i];                              \
+          struct Matrix4 const *b = &matrices[(i + 1) & (BENCH_COUNT - 1)];    \
+          struct Vector4 u = vectors[i];                                       \
+          struct Vector4 v = vectors[(i + 1) & (BENCH_COUNT - 1)];             \
+          (void)a, (void)b, (void)u, (void)v;                                  \
+          sum += (expr);                                                       \
+        }                                                                      \
+      }                                                                        \
+      times[pass] = bench_now_ms() - start;                                    \
+      g_sink = sum;                                                            \
+      (void)scalar;                                                            \
+    }                                                                          \
+    report(name, times[0], times[1]);                                          \
+  } while (0)
+
+  BENCH_KERNEL("Matrix4_multiply",
+               (scalar ? Matrix4_multiply_scalar(a, b)
+                       : Matrix4_multiply(a, b)).f[(i & 15)]);
+  BENCH_KERNEL("Matrix4_transform",
+               (scalar ? Matrix4_transform_scalar(a, u)
+                       : Matrix4_transform(a, u)).x);
+  BENCH_KERNEL("Matrix4_invert",
+               (scalar ? Matrix4_invert_scalar(a) : Matrix4_invert(a))
+                   .f[(i & 15)]);
+  BENCH_KERNEL("Vector4_lerp", (scalar ? Vector4_lerp_scalar(u, v, 0.3f)
+                                       : Vector4_lerp(u, v, 0.3f)).z);
+  BENCH_KERNEL("Vector4_add",
+               (scalar ? Vector4_add_scalar(u, v) : Vector4_add(u, v)).w);
+#undef BENCH_KERNEL
+
+  bench_batch();
+
+  free(matrices);
+  free(vectors);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,245 @@
+#include "bench.h"
+
+#include "voxel/grid.h"
+#include "voxel/mesher.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct Size {
+  uint32_t x, y, z;
+};
+
+static uint64_t count_exposed_faces(struct Grid const *grid,
+                                    uint64_t *solid_count) {
+  static const int offsets[6][3] = {{1, 0, 0},  {-1, 0, 0}, {0, 1, 0},
+                                    {0, -1, 0}, {0, 0, 1},  {0, 0, -1}};
+  uint64_t faces = 0;
+  *solid_count = 0;
+  for (uint32_t z = 0; z < grid->size_z; ++z) {
+    for (uint32_t y = 0; y < grid->size_y; ++y) {
+      for (uint32_t x = 0; x < grid->size_x; ++x) {
+        if (grid_get(grid, x, y, z) == GRID_EMPTY)
+          continue;
+        ++*solid_count;
+        for (int i = 0; i < 6; ++i) {
+          uint32_t nx = x + offsets[i][0];
+          uint32_t ny = y + offsets[i][1];
+          uint32_t nz = z + offsets[i][2];
+          if (nx >= grid->size_x || ny >= grid->size_y || nz >= grid->size_z ||
+              grid_get(grid, nx, ny, nz) == GRID_EMPTY) {
+            ++faces;
+          }
+        }
+      }
+    }
+  }
+  return faces;
+}
+
+// every quad covers an integer number of unit faces, so the total area must
+// equal the number of exposed faces if nothing was dropped or doubled.
+static double mesh_area(struct MeshData const *data) {
+  double area = 0.0;
+  for (uint32_t t = 0; t < data->vertex_count / 3; ++t) {
+    float const *vertices = (float const *)data->vertices;
+    float const *a = vertices + (t * 3 + 0) * MESHER_VERTEX_FLOATS;
+    float const *b = vertices + (t * 3 + 1) * MESHER_VERTEX_FLOATS;
+    float const *c = vertices + (t * 3 + 2) * MESHER_VERTEX_FLOATS;
+    double e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    double e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+    double cx = e1[1] * e2[2] - e1[2] * e2[1];
+    double cy = e1[2] * e2[0] - e1[0] * e2[2];
+    double cz = e1[0] * e2[1] - e1[1] * e2[0];
+    area += 0.5 * sqrt(cx * cx + cy * cy + cz * cz);
+  }
+  return area;
+}
+
+// meshes every chunk the way the voxel renderer does, returns the best time
+// and the vertex bytes of the whole grid.
+static double mesh_chunks(struct Grid const *grid, enum MeshFormat format,
+                          size_t *bytes) {
+  struct MeshData data = mesh_data_new(format);
+  double best = 1e30;
+  for (int i = 0; i < 3; ++i) {
+    *bytes = 0;
+    double start = bench_now_ms();
+    for (uint32_t c = 0; c < grid_chunk_count(grid); ++c) {
+      mesh_data_clear(&data);
+      mesher_build_chunk(grid, c, &data);
+      *bytes += data.vertices_size;
+    }
+    double elapsed = bench_now_ms() - start;
+    if (elapsed < best)
+      best = elapsed;
+  }
+  mesh_data_free(&data);
+  return best;
+}
+
+// the corners the voxel_pull shader builds from a quad's face words, the
+// same arithmetic on the CPU.
+static struct MeshVertex decode_face_word(uint32_t const words[2], int vertex) {
+  uint32_t word = words[0];
+  int corner = (vertex + (int)(word >> 31)) & 3;
+  uint32_t ao = (words[1] >> (2 * corner)) & 3;
+  uint32_t face = (word >> MESH_FACE_WORD_FACE_SHIFT) & 7;
+  int axis = (int)(face >> 1);
+  bool positive = (face & 1) == 0;
+  uint32_t pos[3] = {word & 15, (word >> 4) & 15, (word >> 8) & 15};
+  if (positive)
+    pos[axis] += 1;
+  int u_corners = positive ? 6 : 12;
+  int v_corners = positive ? 12 : 6;
+  uint32_t width = ((word >> MESH_FACE_WORD_WIDTH_SHIFT) & 15) + 1;
+  uint32_t height = ((word >> MESH_FACE_WORD_HEIGHT_SHIFT) & 15) + 1;
+  pos[(axis + 1) % 3] += ((u_corners >> corner) & 1) * width;
+  pos[(axis + 2) % 3] += ((v_corners >> corner) & 1) * height;
+  return (struct MeshVertex){
+      .x = (uint8_t)pos[0],
+      .y = (uint8_t)pos[1],
+      .z = (uint8_t)pos[2],
+      .face_ao = (uint8_t)(face | ao << MESH_AO_SHIFT),
+      .color = (uint8_t)(word >> MESH_FACE_WORD_COLOR_SHIFT)};
+}
+
+// every chunk's face words must expand to exactly its packed quads.
+static bool check_face_words(struct Grid const *grid) {
+  struct MeshData packed = mesh_data_new(MESH_FORMAT_PACKED);
+  struct MeshData faces = mesh_data_new(MESH_FORMAT_FACES);
+  bool ok = true;
+  for (uint32_t c = 0; ok && c < grid_chunk_count(grid); ++c) {
+    mesh_data_clear(&packed);
+    mesh_data_clear(&faces);
+    mesher_build_chunk(grid, c, &packed);
+    mesher_build_chunk(grid, c, &faces);
+    ok = packed.vertex_count == faces.vertex_count;
+    struct MeshVertex const *vertices =
+        (struct MeshVertex const *)packed.vertices;
+    uint32_t const *words = (uint32_t const *)faces.vertices;
+    for (uint32_t i = 0; ok && i < packed.vertex_count; ++i) {
+      struct MeshVertex v = decode_face_word(&words[i / 4 * 2], i % 4);
+      ok = memcmp(&v, &vertices[i], sizeof(v)) == 0;
+    }
+  }
+  mesh_data_free(&packed);
+  mesh_data_free(&faces);
+  return ok;
+}
+
+// a 3x3 floor with a voxel on its center: the floor's top corners under the
+// voxel are occluded and the outer ones open. setting a voxel on a chunk
+// corner has to dirty the 8 chunks around it.
+static bool check_ambient_occlusion(void) {
+  struct Grid grid = grid_new(3, 2, 3, Vector4_new_point(0.f, 0.f, 0.f));
+  for (uint32_t z = 0; z < 3; ++z) {
+    for (uint32_t x = 0; x < 3; ++x) {
+      grid_set(&grid, x, 0, z, 1);
+    }
+  }
+  grid_set(&grid, 1, 1, 1, 2);
+
+  struct MeshData packed = mesh_data_new(MESH_FORMAT_PACKED);
+  mesher_build(&grid, &packed);
+  struct MeshVertex const *vertices = (struct MeshVertex const *)packed.vertices;
+  bool ok = packed.vertex_count > 0;
+  for (uint32_t i = 0; ok && i < packed.vertex_count; ++i) {
+    struct MeshVertex v = vertices[i];
+    if ((v.face_ao & 7) != MESH_FACE_POS_Y || v.y != 1)
+      continue;
+    bool under = v.x >= 1 && v.x <= 2 && v.z >= 1 && v.z <= 2;
+    uint32_t ao = v.face_ao >> MESH_AO_SHIFT;
+    ok = under ? ao < MESH_AO_MAX : ao == MESH_AO_MAX;
+  }
+  mesh_data_free(&packed);
+  grid_free(&grid);
+
+  uint32_t size = 3 * GRID_CHUNK_SIZE;
+  grid = grid_new(size, size, size, Vector4_new_point(0.f, 0.f, 0.f));
+  for (uint32_t c = 0; c < grid_chunk_count(&grid); ++c) {
+    grid_chunk_clear_dirty(&grid, c);
+  }
+  grid_set(&grid, GRID_CHUNK_MASK, GRID_CHUNK_MASK, GRID_CHUNK_MASK, 1);
+  uint32_t dirty = 0;
+  for (uint32_t c = 0; c < grid_chunk_count(&grid); ++c) {
+    dirty += grid_chunk_is_dirty(&grid, c);
+  }
+  ok = ok && dirty == 8;
+  grid_free(&grid);
+  return ok;
+}
+
+static int run(char const *name, struct Size size, bool noise) {
+  struct Grid grid =
+      grid_new(size.x, size.y, size.z, Vector4_new_point(0.f, 0.f, 0.f));
+  if (noise) {
+    bench_fill_noise(&grid, 1234);
+  } else {
+    bench_fill_terrain(&grid);
+  }
+
+  uint64_t solid = 0;
+  uint64_t exposed = count_exposed_faces(&grid, &solid);
+
+  struct MeshData data = mesh_data_new(MESH_FORMAT_FLOAT);
+  int iterations = size.x * size.y * size.z > (1u << 20) ? 3 : 10;
+  double best = 1e30;
+  for (int i = 0; i < iterations; ++i) {
+    mesh_data_clear(&data);
+    double start = bench_now_ms();
+    mesher_build(&grid, &data);
+    double elapsed = bench_now_ms() - start;
+    if (elapsed < best)
+      best = elapsed;
+  }
+
+  double area = mesh_area(&data);
+  bool ok = fabs(area - (double)exposed) < 0.5;
+
+  printf("%-8s %4ux%3ux%4u  solid %9llu  per-voxel tris %10llu  culled tris "
+         "%9llu  greedy tris %8u  %9.3f ms %s\n",
+         name, size.x, size.y, size.z, (unsigned long long)solid,
+         (unsigned long long)(solid * 12), (unsigned long long)(exposed * 2),
+         data.vertex_count / 3, best, ok ? "" : "AREA MISMATCH");
+
+  size_t float_bytes = 0, packed_bytes = 0, face_bytes = 0;
+  double float_ms = mesh_chunks(&grid, MESH_FORMAT_FLOAT, &float_bytes);
+  double packed_ms = mesh_chunks(&grid, MESH_FORMAT_PACKED, &packed_bytes);
+  double face_ms = mesh_chunks(&grid, MESH_FORMAT_FACES, &face_bytes);
+  bool faces_ok = check_face_words(&grid);
+  printf("         per chunk vertices  float %8.2f MiB %9.3f ms  packed %8.2f "
+         "MiB %9.3f ms  faces %8.2f MiB %9.3f ms %s\n",
+         float_bytes / (1024.0 * 1024.0), float_ms,
+         packed_bytes / (1024.0 * 1024.0), packed_ms,
+         face_bytes / (1024.0 * 1024.0), face_ms,
+         faces_ok ? "" : "FACE WORD MISMATCH");
+  ok = ok && faces_ok;
+
+  mesh_data_free(&data);
+  grid_free(&grid);
+  return ok ? 0 : 1;
+}
+
+int main(void) {
+  static const struct Size sizes[] = {
+      {32, 32, 32}, {64, 64, 64}, {128, 64, 128}, {256, 64, 256}};
+  int failures = 0;
+
+  if (!check_ambient_occlusion()) {
+    printf("AMBIENT OCCLUSION MISMATCH\n");
+    ++failures;
+  }
+
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+    failures += run("terrain", sizes[i], false);
+  }
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+    failures += run("noise", sizes[i], true);
+  }
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
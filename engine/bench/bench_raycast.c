@@ -0,0 +1,130 @@
+#include "bench.h"
+
+#include "voxel/grid.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define RAY_COUNT (1u << 20)
+#define CHECK_COUNT 2000
+
+static float rand_unit(uint32_t *seed) {
+  return (bench_rand(seed) & 0xFFFFFF) / (float)0xFFFFFF;
+}
+
+// tiny fixed steps, slow but obviously right.
+static bool march(struct Grid const *grid, struct Vector4 o, struct Vector4 d,
+                  float max_distance, uint32_t cell[3]) {
+  Vector4_normalize(&d);
+  for (float t = 0.f; t < max_distance; t += 0.0005f) {
+    float x = o.x + d.x * t - grid->origin.x + 0.5f;
+    float y = o.y + d.y * t - grid->origin.y + 0.5f;
+    float z = o.z + d.z * t - grid->origin.z + 0.5f;
+    if (x < 0.f || y < 0.f || z < 0.f || x >= grid->size_x ||
+        y >= grid->size_y || z >= grid->size_z)
+      continue;
+    if (grid_get(grid, (uint32_t)x, (uint32_t)y, (uint32_t)z) != GRID_EMPTY) {
+      cell[0] = (uint32_t)x;
+      cell[1] = (uint32_t)y;
+      cell[2] = (uint32_t)z;
+      return true;
+    }
+  }
+  return false;
+}
+
+static int check(void) {
+  struct Grid grid =
+      grid_new(32, 32, 32, Vector4_new_point(-16.f, -16.f, -16.f));
+  uint32_t seed = 99;
+  for (uint32_t z = 0; z < 32; ++z)
+    for (uint32_t y = 0; y < 32; ++y)
+      for (uint32_t x = 0; x < 32; ++x)
+        if (bench_rand(&seed) % 40 == 0)
+          grid_set(&grid, x, y, z, GRID_RED);
+
+  int mismatches = 0;
+  for (int i = 0; i < CHECK_COUNT; ++i) {
+    struct Vector4 o = Vector4_new_point(rand_unit(&seed) * 60.f - 30.f,
+                                         rand_unit(&seed) * 60.f - 30.f,
+                                         rand_unit(&seed) * 60.f - 30.f);
+    struct Vector4 d = Vector4_new_vector(rand_unit(&seed) - 0.5f,
+                                          rand_unit(&seed) - 0.5f,
+                                          rand_unit(&seed) - 0.5f);
+    struct GridRayHit hit;
+    uint32_t cell[3];
+    bool a = grid_raycast(&grid, o, d, 80.f, &hit);
+    bool b = march(&grid, o, d, 80.f, cell);
+    if (a != b || (a && (hit.x != cell[0] || hit.y != cell[1] ||
+                         hit.z != cell[2]))) {
+      ++mismatches;
+    }
+  }
+  grid_free(&grid);
+  printf("dda vs march: %d / %d mismatches\n", mismatches, CHECK_COUNT);
+  // a fixed step march can clip a voxel corner the dda correctly reports
+  return mismatches * 100 > CHECK_COUNT;
+}
+
+int main(void) {
+  if (check())
+    return EXIT_FAILURE;
+
+  uint32_t size_x = 512, size_y = 128, size_z = 512;
+  struct Grid grid = grid_new(size_x, size_y, size_z,
+                              Vector4_new_point(0.f, 0.f, 0.f));
+  bench_fill_terrain(&grid);
+
+  struct Vector4 *origins =
+      (struct Vector4 *)malloc(RAY_COUNT * sizeof(struct Vector4));
+  struct Vector4 *directions =
+      (struct Vector4 *)malloc(RAY_COUNT * sizeof(struct Vector4));
+  struct GridRayHit *hits =
+      (struct GridRayHit *)malloc(RAY_COUNT * sizeof(struct GridRayHit));
+  bool *hit_mask = (bool *)malloc(RAY_COUNT * sizeof(bool));
+
+  // picking style rays from above, then line of sight rays between points
+  // just over the terrain
+  char const *names[2] = {"pick", "line of sight"};
+  for (int kind = 0; kind < 2; ++kind) {
+    uint32_t seed = 5 + kind;
+    for (uint32_t i = 0; i < RAY_COUNT; ++i) {
+      float x = rand_unit(&seed) * size_x;
+      float z = rand_unit(&seed) * size_z;
+      if (kind == 0) {
+        origins[i] = Vector4_new_point(x, size_y + 10.f, z);
+        directions[i] = Vector4_new_vector(rand_unit(&seed) - 0.5f, -1.f,
+                                           rand_unit(&seed) - 0.5f);
+      } else {
+        origins[i] = Vector4_new_point(x, size_y * 0.8f, z);
+        float angle = rand_unit(&seed) * 6.2831853f;
+        directions[i] = Vector4_new_vector(cosf(angle), -0.05f, sinf(angle));
+      }
+    }
+
+    double start = bench_now_ms();
+    uint32_t hit_count = grid_raycast_batch(&grid, origins, directions,
+                                            RAY_COUNT, 256.f, hits, hit_mask);
+    double elapsed = bench_now_ms() - start;
+
+    double mean_distance = 0.0;
+    for (uint32_t i = 0; i < RAY_COUNT; ++i) {
+      if (hit_mask[i])
+        mean_distance += hits[i].distance;
+    }
+    mean_distance /= hit_count ? hit_count : 1;
+
+    printf("%-14s %u rays in %.1f ms: %.2f M rays/s, %.1f%% hit, mean "
+           "distance %.1f\n",
+           names[kind], RAY_COUNT, elapsed, RAY_COUNT / elapsed / 1000.0,
+           100.0 * hit_count / RAY_COUNT, mean_distance);
+  }
+
+  free(origins);
+  free(directions);
+  free(hits);
+  free(hit_mask);
+  grid_free(&grid);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,76 @@
+#include "bench.h"
+
+#include "voxel/grid.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SIZE_X 512
+#define SIZE_Y 128
+#define SIZE_Z 512
+#define RANDOM_OPS (1u << 24)
+
+static char const *storage_name(enum GridStorage storage) {
+  return storage == GRID_STORAGE_DENSE ? "dense" : "packed";
+}
+
+static void run(enum GridStorage storage) {
+  struct Grid grid = grid_new_with_storage(SIZE_X, SIZE_Y, SIZE_Z,
+                                           Vector4_new_point(0.f, 0.f, 0.f),
+                                           storage);
+
+  double start = bench_now_ms();
+  bench_fill_terrain(&grid);
+  double fill_ms = bench_now_ms() - start;
+
+  size_t voxel_count = (size_t)SIZE_X * SIZE_Y * SIZE_Z;
+  size_t bytes = grid_memory_usage(&grid);
+
+  // sequential reads in memory order of the old flat layout
+  uint32_t checksum = 0;
+  start = bench_now_ms();
+  for (uint32_t z = 0; z < SIZE_Z; ++z) {
+    for (uint32_t y = 0; y < SIZE_Y; ++y) {
+      for (uint32_t x = 0; x < SIZE_X; ++x) {
+        checksum += (uint8_t)grid_get(&grid, x, y, z);
+      }
+    }
+  }
+  double sequential_ms = bench_now_ms() - start;
+
+  uint32_t seed = 7;
+  start = bench_now_ms();
+  for (uint32_t i = 0; i < RANDOM_OPS; ++i) {
+    uint32_t r = bench_rand(&seed);
+    checksum += (uint8_t)grid_get(&grid, r % SIZE_X, (r >> 9) % SIZE_Y,
+                                  (r >> 16) % SIZE_Z);
+  }
+  double random_get_ms = bench_now_ms() - start;
+
+  // repaint existing solid voxels so chunks are not allocated or freed
+  seed = 11;
+  start = bench_now_ms();
+  for (uint32_t i = 0; i < RANDOM_OPS; ++i) {
+    uint32_t r = bench_rand(&seed);
+    grid_set(&grid, r % SIZE_X, (r >> 9) % (SIZE_Y / 4), (r >> 16) % SIZE_Z,
+             (char)(GRID_BEIGE + (r >> 28) % 4));
+  }
+  double random_set_ms = bench_now_ms() - start;
+
+  printf("%-7s fill %7.1f ms  memory %7.2f MiB (%.2f bits/voxel)  "
+         "seq get %7.1f M/s  rand get %6.1f M/s  rand set %6.1f M/s  [%u]\n",
+         storage_name(storage), fill_ms, bytes / (1024.0 * 1024.0),
+         8.0 * bytes / voxel_count, voxel_count / sequential_ms / 1000.0,
+         RANDOM_OPS / random_get_ms / 1000.0,
+         RANDOM_OPS / random_set_ms / 1000.0, checksum);
+
+  grid_free(&grid);
+}
+
+int main(void) {
+  printf("%ux%ux%u terrain, flat char array would be %.2f MiB\n", SIZE_X,
+         SIZE_Y, SIZE_Z, (double)SIZE_X * SIZE_Y * SIZE_Z / (1024.0 * 1024.0));
+  run(GRID_STORAGE_DENSE);
+  run(GRID_STORAGE_PACKED);
+  return EXIT_SUCCESS;
+}
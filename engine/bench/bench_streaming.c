@@ -0,0 +1,199 @@
+#include "bench.h"
+
+#include "core/jobs.h"
+#include "voxel/grid.h"
+#include "voxel/mesh_queue.h"
+#include "voxel/mesher.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAME_COUNT 240
+#define BRUSH_RADIUS 24
+// the rest of a frame, rendering and waiting on vsync, when workers get the
+// cores the main thread isn't using
+#define FRAME_IDLE_MS 8
+// same budget as the voxel renderer
+#define UPLOAD_BUDGET (1u << 20)
+#define HISTOGRAM_BUCKETS 7
+
+static double const bucket_ms[HISTOGRAM_BUCKETS - 1] = {1, 2, 4, 8, 16, 33};
+
+// stands in for glBufferData, copies into a buffer that only grows.
+struct FakeGpu {
+  uint8_t *buffer;
+  size_t capacity;
+  size_t bytes;
+};
+
+static void fake_upload(struct FakeGpu *gpu, struct MeshData const *data) {
+  size_t size = data->vertices_size;
+  if (size > gpu->capacity) {
+    gpu->buffer = (uint8_t *)realloc(gpu->buffer, size);
+    gpu->capacity = size;
+  }
+  memcpy(gpu->buffer, data->vertices, size);
+  gpu->bytes += size;
+}
+
+// a sphere that alternately carves and fills, moving across the terrain.
+static void apply_brush(struct Grid *grid, uint32_t frame) {
+  int32_t cx = BRUSH_RADIUS +
+               (int32_t)(frame * 3 % (grid->size_x - 2 * BRUSH_RADIUS));
+  int32_t cz = BRUSH_RADIUS +
+               (int32_t)(frame * 7 % (grid->size_z - 2 * BRUSH_RADIUS));
+  int32_t cy = (int32_t)grid->size_y / 2;
+  char value = frame % 2 ? GRID_ORANGE : GRID_EMPTY;
+  for (int32_t z = -BRUSH_RADIUS; z <= BRUSH_RADIUS; ++z) {
+    for (int32_t y = -BRUSH_RADIUS; y <= BRUSH_RADIUS; ++y) {
+      for (int32_t x = -BRUSH_RADIUS; x <= BRUSH_RADIUS; ++x) {
+        if (x * x + y * y + z * z > BRUSH_RADIUS * BRUSH_RADIUS)
+          continue;
+        grid_set(grid, cx + x, cy + y, cz + z, value);
+      }
+    }
+  }
+}
+
+// the old voxel_renderer_update, every dirty chunk meshed and uploaded now.
+static void frame_inline(struct Grid *grid, struct MeshData *data,
+                         struct FakeGpu *gpu) {
+  uint32_t chunk_count = grid_chunk_count(grid);
+  for (uint32_t i = 0; i < chunk_count; ++i) {
+    if (!grid_chunk_is_dirty(grid, i))
+      continue;
+    grid_chunk_clear_dirty(grid, i);
+    mesh_data_clear(data);
+    mesher_build_chunk(grid, i, data);
+    fake_upload(gpu, data);
+  }
+}
+
+// the main thread's share of voxel_renderer_update.
+static uint32_t frame_queued(struct Grid *grid, struct MeshQueue *queue,
+                             struct FakeGpu *gpu) {
+  mesh_queue_dispatch(queue, grid, MESH_QUEUE_DISPATCH_BUDGET);
+  size_t start = gpu->bytes;
+  uint32_t uploaded = 0;
+  while (gpu->bytes - start < UPLOAD_BUDGET) {
+    struct MeshResult *result = mesh_queue_pop(queue);
+    if (result == NULL)
+      break;
+    fake_upload(gpu, &result->data);
+    mesh_queue_release(queue, result);
+    ++uploaded;
+  }
+  return uploaded;
+}
+
+static void frame_idle(void) {
+  struct timespec ts = {0, FRAME_IDLE_MS * 1000000L};
+  nanosleep(&ts, NULL);
+}
+
+static int compare_double(void const *a, void const *b) {
+  double da = *(double const *)a;
+  double db = *(double const *)b;
+  return (da > db) - (da < db);
+}
+
+static void report(char const *name, double *frames, uint32_t count) {
+  uint32_t histogram[HISTOGRAM_BUCKETS] = {0};
+  double total = 0.0;
+  for (uint32_t i = 0; i < count; ++i) {
+    int bucket = 0;
+    while (bucket < HISTOGRAM_BUCKETS - 1 && frames[i] >= bucket_ms[bucket])
+      ++bucket;
+    histogram[bucket]++;
+    total += frames[i];
+  }
+  qsort(frames, count, sizeof(double), compare_double);
+
+  printf("%-8s mean %6.2f ms  p50 %6.2f  p99 %6.2f  max %6.2f\n", name,
+         total / count, frames[count / 2], frames[count * 99 / 100],
+         frames[count - 1]);
+  printf("         ");
+  for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+    if (i < HISTOGRAM_BUCKETS - 1)
+      printf("<%2.0f ms %4u  ", bucket_ms[i], histogram[i]);
+    else
+      printf(">=%2.0f ms %4u", bucket_ms[i - 1], histogram[i]);
+  }
+  printf("\n");
+}
+
+int main(int argc, char **argv) {
+  uint32_t workers = jobs_cpu_count() - 1;
+  if (argc > 1)
+    workers = (uint32_t)atoi(argv[1]);
+  struct JobSystem js;
+  if (!jobs_new(&js, workers))
+    return EXIT_FAILURE;
+  printf("%u workers, brush radius %d, %d frames\n", js.worker_count,
+         BRUSH_RADIUS, FRAME_COUNT);
+
+  struct Grid grid = grid_new(256, 64, 256, Vector4_new_point(0.f, 0.f, 0.f));
+  bench_fill_terrain(&grid);
+  struct MeshData data = mesh_data_new(MESH_FORMAT_PACKED);
+  struct FakeGpu gpu = {0};
+  double frames[FRAME_COUNT];
+
+  // the level load, then a brush edit every frame. edits aren't timed.
+  double start = bench_now_ms();
+  frame_inline(&grid, &data, &gpu);
+  printf("inline   level load %.1f ms in one frame\n", bench_now_ms() - start);
+  for (uint32_t f = 0; f < FRAME_COUNT; ++f) {
+    apply_brush(&grid, f);
+    start = bench_now_ms();
+    frame_inline(&grid, &data, &gpu);
+    frames[f] = bench_now_ms() - start;
+    frame_idle();
+  }
+  report("inline", frames, FRAME_COUNT);
+
+  struct MeshQueue queue;
+  if (!mesh_queue_new(&queue, &grid, &js, MESH_FORMAT_PACKED))
+    return EXIT_FAILURE;
+  grid_mark_all_dirty(&grid);
+  uint32_t load_frames = 0;
+  double worst = 0.0;
+  uint32_t chunk_count = grid_chunk_count(&grid);
+  for (uint32_t uploaded = 0; uploaded < chunk_count; ++load_frames) {
+    start = bench_now_ms();
+    uploaded += frame_queued(&grid, &queue, &gpu);
+    double ms = bench_now_ms() - start;
+    worst = ms > worst ? ms : worst;
+    frame_idle();
+  }
+  printf("queued   level load over %u frames, worst %.2f ms\n", load_frames,
+         worst);
+
+  uint32_t uploaded = 0;
+  for (uint32_t f = 0; f < FRAME_COUNT; ++f) {
+    apply_brush(&grid, f);
+    start = bench_now_ms();
+    uploaded += frame_queued(&grid, &queue, &gpu);
+    frames[f] = bench_now_ms() - start;
+    frame_idle();
+  }
+  // let the stragglers through so the two runs do the same work
+  uint32_t drain_frames = 0;
+  while (queue.in_flight_count > 0 ||
+         mesh_queue_dispatch(&queue, &grid, 0) > 0) {
+    uploaded += frame_queued(&grid, &queue, &gpu);
+    ++drain_frames;
+    frame_idle();
+  }
+  report("queued", frames, FRAME_COUNT);
+  printf("         %u chunks uploaded, %u frames to catch up after the last "
+         "edit\n",
+         uploaded, drain_frames);
+
+  mesh_queue_free(&queue);
+  jobs_free(&js);
+  free(gpu.buffer);
+  mesh_data_free(&data);
+  grid_free(&grid);
+  return EXIT_SUCCESS;
+}
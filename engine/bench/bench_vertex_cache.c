@@ -0,0 +1,217 @@
+#include "bench.h"
+
+#include "core/vertex_cache.h"
+#include "voxel/grid.h"
+#include "voxel/mesher.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PLANE_SIZE 256
+#define SPHERE_RINGS 96
+#define SPHERE_SEGMENTS 192
+
+static uint32_t const cache_sizes[] = {8, 16, 32};
+#define CACHE_SIZE_COUNT (sizeof(cache_sizes) / sizeof(cache_sizes[0]))
+
+struct IndexedMesh {
+  uint32_t *indices;
+  uint32_t index_count;
+  uint32_t vertex_count;
+};
+
+// row by row, the order a naive exporter writes a height field in.
+static struct IndexedMesh make_plane(uint32_t size) {
+  struct IndexedMesh mesh = {0};
+  mesh.vertex_count = (size + 1) * (size + 1);
+  mesh.indices = (uint32_t *)malloc(size * size * 6 * sizeof(uint32_t));
+  for (uint32_t y = 0; y < size; ++y) {
+    for (uint32_t x = 0; x < size; ++x) {
+      uint32_t a = y * (size + 1) + x;
+      uint32_t b = a + 1, c = a + size + 1, d = c + 1;
+      uint32_t quad[6] = {a, b, d, d, c, a};
+      memcpy(mesh.indices + mesh.index_count, quad, sizeof(quad));
+      mesh.index_count += 6;
+    }
+  }
+  return mesh;
+}
+
+// latitude rings with a pole vertex at each end.
+static struct IndexedMesh make_sphere(uint32_t rings, uint32_t segments) {
+  struct IndexedMesh mesh = {0};
+  mesh.vertex_count = (rings - 1) * segments + 2;
+  uint32_t south = mesh.vertex_count - 1;
+  mesh.indices = (uint32_t *)malloc(rings * segments * 6 * sizeof(uint32_t));
+  for (uint32_t r = 0; r < rings; ++r) {
+    for (uint32_t s = 0; s < segments; ++s) {
+      uint32_t s1 = (s + 1) % segments;
+      // ring r - 1 as vertex rows, row 0 starts after the north pole
+      uint32_t a = r == 0 ? 0 : 1 + (r - 1) * segments + s;
+      uint32_t b = r == 0 ? 0 : 1 + (r - 1) * segments + s1;
+      uint32_t c = r + 1 == rings ? south : 1 + r * segments + s;
+      uint32_t d = r + 1 == rings ? south : 1 + r * segments + s1;
+      if (r != 0) {
+        uint32_t tri[3] = {a, c, b};
+        memcpy(mesh.indices + mesh.index_count, tri, sizeof(tri));
+        mesh.index_count += 3;
+      }
+      if (r + 1 != rings) {
+        uint32_t tri[3] = {b, c, d};
+        memcpy(mesh.indices + mesh.index_count, tri, sizeof(tri));
+        mesh.index_count += 3;
+      }
+    }
+  }
+  return mesh;
+}
+
+static struct IndexedMesh copy_mesh(struct IndexedMesh const *src) {
+  struct IndexedMesh mesh = *src;
+  mesh.indices = (uint32_t *)malloc(src->index_count * sizeof(uint32_t));
+  memcpy(mesh.indices, src->indices, src->index_count * sizeof(uint32_t));
+  return mesh;
+}
+
+// triangles in random order, what a mesh looks like after a careless merge.
+static void shuffle_triangles(struct IndexedMesh *mesh, uint32_t seed) {
+  uint32_t tri_count = mesh->index_count / 3;
+  for (uint32_t i = tri_count - 1; i > 0; --i) {
+    uint32_t j = bench_rand(&seed) % (i + 1);
+    for (int k = 0; k < 3; ++k) {
+      uint32_t t = mesh->indices[i * 3 + k];
+      mesh->indices[i * 3 + k] = mesh->indices[j * 3 + k];
+      mesh->indices[j * 3 + k] = t;
+    }
+  }
+}
+
+// the packed chunk meshes of a terrain with identical vertices merged, so
+// quads of the same face and color share their corners.
+static struct IndexedMesh make_welded_terrain(void) {
+  struct Grid grid = grid_new(64, 64, 64, Vector4_new_point(0.f, 0.f, 0.f));
+  bench_fill_terrain(&grid);
+  struct MeshData data = mesh_data_new(MESH_FORMAT_PACKED);
+  mesher_build(&grid, &data);
+  grid_free(&grid);
+
+  struct MeshVertex const *vertices = (struct MeshVertex const *)data.vertices;
+  uint32_t quad_count = data.vertex_count / 4;
+  struct IndexedMesh mesh = {0};
+  mesh.indices = (uint32_t *)malloc(quad_count * 6 * sizeof(uint32_t));
+
+  // open addressing on the 8 vertex bytes
+  uint32_t table_size = 1;
+  while (table_size < data.vertex_count * 2) {
+    table_size *= 2;
+  }
+  uint64_t *keys = (uint64_t *)malloc(table_size * sizeof(uint64_t));
+  uint32_t *ids = (uint32_t *)malloc(table_size * sizeof(uint32_t));
+  memset(ids, 0xFF, table_size * sizeof(uint32_t));
+  uint32_t *remap = (uint32_t *)malloc(data.vertex_count * sizeof(uint32_t));
+  for (uint32_t i = 0; i < data.vertex_count; ++i) {
+    uint64_t key;
+    memcpy(&key, &vertices[i], sizeof(key));
+    uint32_t slot = (uint32_t)((key * 0x9E3779B97F4A7C15ull) >> 32) &
+                    (table_size - 1);
+    while (ids[slot] != UINT32_MAX && keys[slot] != key) {
+      slot = (slot + 1) & (table_size - 1);
+    }
+    if (ids[slot] == UINT32_MAX) {
+      keys[slot] = key;
+      ids[slot] = mesh.vertex_count++;
+    }
+    remap[i] = ids[slot];
+  }
+
+  static const uint32_t pattern[6] = {0, 1, 2, 2, 3, 0};
+  for (uint32_t q = 0; q < quad_count; ++q) {
+    for (int k = 0; k < 6; ++k) {
+      mesh.indices[mesh.index_count++] = remap[q * 4 + pattern[k]];
+    }
+  }
+  free(keys);
+  free(ids);
+  free(remap);
+  mesh_data_free(&data);
+  return mesh;
+}
+
+static void print_acmr(char const *label, struct IndexedMesh const *mesh) {
+  printf("  %-10s", label);
+  for (uint32_t i = 0; i < CACHE_SIZE_COUNT; ++i) {
+    printf("  fifo %2u %.3f", cache_sizes[i],
+           vertex_cache_acmr(mesh->indices, mesh->index_count,
+                             cache_sizes[i]));
+  }
+  printf("\n");
+}
+
+// the optimizer must only reorder whole triangles, never change them.
+static bool same_triangles(struct IndexedMesh const *a,
+                           struct IndexedMesh const *b) {
+  uint32_t tri_count = a->index_count / 3;
+  uint64_t *ka = (uint64_t *)malloc(tri_count * sizeof(uint64_t));
+  uint64_t *kb = (uint64_t *)malloc(tri_count * sizeof(uint64_t));
+  for (uint32_t t = 0; t < tri_count; ++t) {
+    uint32_t const *x = a->indices + t * 3, *y = b->indices + t * 3;
+    // rotate so the smallest index leads, keeping the winding
+    uint32_t rx = x[0] < x[1] ? (x[0] < x[2] ? 0 : 2) : (x[1] < x[2] ? 1 : 2);
+    uint32_t ry = y[0] < y[1] ? (y[0] < y[2] ? 0 : 2) : (y[1] < y[2] ? 1 : 2);
+    ka[t] = (uint64_t)x[rx] << 42 ^ (uint64_t)x[(rx + 1) % 3] << 21 ^
+            x[(rx + 2) % 3];
+    kb[t] = (uint64_t)y[ry] << 42 ^ (uint64_t)y[(ry + 1) % 3] << 21 ^
+            y[(ry + 2) % 3];
+  }
+  uint64_t sum_a = 0, sum_b = 0, xor_a = 0, xor_b = 0;
+  for (uint32_t t = 0; t < tri_count; ++t) {
+    sum_a += ka[t] * 0x9E3779B97F4A7C15ull;
+    sum_b += kb[t] * 0x9E3779B97F4A7C15ull;
+    xor_a ^= ka[t];
+    xor_b ^= kb[t];
+  }
+  free(ka);
+  free(kb);
+  return sum_a == sum_b && xor_a == xor_b;
+}
+
+static int run(char const *name, struct IndexedMesh *mesh) {
+  printf("%s: %u vertices, %u triangles\n", name, mesh->vertex_count,
+         mesh->index_count / 3);
+  print_acmr("input", mesh);
+
+  struct IndexedMesh optimized = copy_mesh(mesh);
+  double start = bench_now_ms();
+  bool ok = vertex_cache_optimize(optimized.indices, optimized.index_count,
+                                  optimized.vertex_count);
+  double elapsed = bench_now_ms() - start;
+  print_acmr("optimized", &optimized);
+  printf("  optimized in %.2f ms (%.0f ns per triangle)\n", elapsed,
+         elapsed * 1e6 / (mesh->index_count / 3));
+
+  ok = ok && same_triangles(mesh, &optimized);
+  if (!ok)
+    printf("  TRIANGLES CHANGED\n");
+  free(optimized.indices);
+  free(mesh->indices);
+  return ok ? 0 : 1;
+}
+
+int main(void) {
+  int failures = 0;
+
+  struct IndexedMesh plane = make_plane(PLANE_SIZE);
+  struct IndexedMesh shuffled = copy_mesh(&plane);
+  shuffle_triangles(&shuffled, 7);
+  failures += run("plane", &plane);
+  failures += run("plane, shuffled", &shuffled);
+
+  struct IndexedMesh sphere = make_sphere(SPHERE_RINGS, SPHERE_SEGMENTS);
+  failures += run("sphere", &sphere);
+
+  struct IndexedMesh terrain = make_welded_terrain();
+  failures += run("welded terrain", &terrain);
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,102 @@
+#include "bench.h"
+
+#include "voxel/grid.h"
+#include "voxel/mesher.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define EDIT_COUNT 2000
+
+// remeshes every dirty chunk inline, without the gpu upload.
+static uint32_t remesh_dirty(struct Grid *grid, struct MeshData *data,
+                             uint64_t *triangles) {
+  uint32_t remeshed = 0;
+  uint32_t chunk_count = grid_chunk_count(grid);
+  for (uint32_t i = 0; i < chunk_count; ++i) {
+    if (!grid_chunk_is_dirty(grid, i))
+      continue;
+    grid_chunk_clear_dirty(grid, i);
+    mesh_data_clear(data);
+    mesher_build_chunk(grid, i, data);
+    *triangles += mesh_data_triangle_count(data);
+    ++remeshed;
+  }
+  return remeshed;
+}
+
+static int compare_double(void const *a, void const *b) {
+  double da = *(double const *)a;
+  double db = *(double const *)b;
+  return (da > db) - (da < db);
+}
+
+int main(void) {
+  uint32_t size_x = 1024, size_y = 128, size_z = 1024;
+  struct Grid grid =
+      grid_new(size_x, size_y, size_z, Vector4_new_point(0.f, 0.f, 0.f));
+
+  double start = bench_now_ms();
+  bench_fill_terrain(&grid);
+  double fill_ms = bench_now_ms() - start;
+
+  uint32_t chunk_count = grid_chunk_count(&grid);
+  uint32_t allocated = 0;
+  for (uint32_t i = 0; i < chunk_count; ++i) {
+    if (grid.chunks[i] != NULL)
+      ++allocated;
+  }
+  size_t dense_bytes = (size_t)size_x * size_y * size_z;
+  size_t chunked_bytes = grid_memory_usage(&grid);
+
+  printf("world %ux%ux%u filled in %.1f ms\n", size_x, size_y, size_z,
+         fill_ms);
+  printf("chunks allocated %u / %u (%.1f%%)\n", allocated, chunk_count,
+         100.0 * allocated / chunk_count);
+  printf("memory dense %.1f MiB  chunked %.1f MiB (%.1f%%)\n",
+         dense_bytes / (1024.0 * 1024.0), chunked_bytes / (1024.0 * 1024.0),
+         100.0 * chunked_bytes / dense_bytes);
+
+  struct MeshData data = mesh_data_new(MESH_FORMAT_PACKED);
+  uint64_t triangles = 0;
+  start = bench_now_ms();
+  uint32_t remeshed = remesh_dirty(&grid, &data, &triangles);
+  double full_ms = bench_now_ms() - start;
+  printf("full remesh %u chunks, %llu tris in %.1f ms\n", remeshed,
+         (unsigned long long)triangles, full_ms);
+
+  // single voxel edits around the surface, each followed by the remesh a
+  // frame would do before drawing.
+  double *latency = (double *)malloc(EDIT_COUNT * sizeof(double));
+  uint32_t seed = 42;
+  uint64_t total_remeshed = 0;
+  for (int i = 0; i < EDIT_COUNT; ++i) {
+    uint32_t x = bench_rand(&seed) % size_x;
+    uint32_t y = size_y / 4 + bench_rand(&seed) % (size_y / 2);
+    uint32_t z = bench_rand(&seed) % size_z;
+    char value = grid_get(&grid, x, y, z) == GRID_EMPTY ? GRID_ORANGE
+                                                        : GRID_EMPTY;
+
+    start = bench_now_ms();
+    grid_set(&grid, x, y, z, value);
+    triangles = 0;
+    total_remeshed += remesh_dirty(&grid, &data, &triangles);
+    latency[i] = bench_now_ms() - start;
+  }
+
+  qsort(latency, EDIT_COUNT, sizeof(double), compare_double);
+  double sum = 0.0;
+  for (int i = 0; i < EDIT_COUNT; ++i) {
+    sum += latency[i];
+  }
+  printf("edit to frame over %d edits: avg %.3f ms  p50 %.3f ms  p99 %.3f ms  "
+         "max %.3f ms  chunks/edit %.2f\n",
+         EDIT_COUNT, sum / EDIT_COUNT, latency[EDIT_COUNT / 2],
+         latency[EDIT_COUNT * 99 / 100], latency[EDIT_COUNT - 1],
+         (double)total_remeshed / EDIT_COUNT);
+
+  free(latency);
+  mesh_data_free(&data);
+  grid_free(&grid);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,10 @@
+#!/bin/bash
+# CPU benchmarks, these do not need SDL or a GL context.
+BENCH_SRC="src/core/jobs.c src/core/profiler.c src/core/vertex_cache.c src/math/*.c src/platform/*.c src/voxel/*.c"
+
+mkdir -p ./bin
+
+for bench in bench/*.c; do
+  name=$(basename $bench .c)
+  cc -Wall -Wextra -Werror -std=c99 -O3 -I./include $bench $BENCH_SRC -pthread -lm -o ./bin/$name || exit 1
+done
@@ -5,5 +5,5 @@ BIN_NAME=techjam
 
 mkdir -p ./bin
 
-cc -Wall -Wextra -Werror -std=c99 -O3 $SDL_CFLAGS -I./include -I./deps/glad-330/include src/main.c src/**/*.c ./deps/glad-330/src/glad.c $SDL_LDFLAGS -o ./bin/$BIN_NAME-rel
-cc -Wall -Wextra -Werror -std=c99 $SDL_CFLAGS -I./include -I./deps/glad-330/include -g src/main.c src/**/*.c ./deps/glad-330/src/glad.c $SDL_LDFLAGS -fsanitize=address -o ./bin/$BIN_NAME-asan
+cc -Wall -Wextra -Werror -std=c99 -O3 $SDL_CFLAGS -I./include -I./deps/glad-330/include src/main.c src/**/*.c ./deps/glad-330/src/glad.c $SDL_LDFLAGS -pthread -o ./bin/$BIN_NAME-rel
+cc -Wall -Wextra -Werror -std=c99 $SDL_CFLAGS -I./include -I./deps/glad-330/include -g src/main.c src/**/*.c ./deps/glad-330/src/glad.c $SDL_LDFLAGS -pthread -fsanitize=address -o ./bin/$BIN_NAME-asan
@@ -4,35 +4,90 @@
 #include "math/vector4.h"
 #include "render/gfx_api.h"
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 
 struct Matrix4;
 
+// position and an RGBA8 color (red in the lowest byte), 16 bytes.
+struct LineVertex {
+  float x;
+  float y;
+  float z;
+  uint32_t color;
+};
+
 struct Line {
-  struct Vector4 a;
-  struct Vector4 color_a;
-  struct Vector4 b;
-  struct Vector4 color_b;
+  struct LineVertex a;
+  struct LineVertex b;
 };
 
-struct Debug {
+struct DebugLines {
   struct Line *lines;
   size_t lines_capacity;
   size_t lines_size;
+};
+
+struct Debug {
+  // rebuilt every frame and streamed
+  struct DebugLines frame;
   uint32_t lines_vao;
-  uint32_t lines_vb;
+  struct StreamBuffer lines_stream;
+  // built between debug_begin_static / debug_end_static and kept on the GPU
+  // until debug_clear_static
+  struct DebugLines persistent;
+  uint32_t static_vao;
+  uint32_t static_vb;
+  uint32_t static_vertex_count;
+  // where the debug_add_* calls currently write, NULL means frame
+  struct DebugLines *target;
   struct Shader lines_shader;
-  uint32_t lines_shader_view_proj;
 };
 
 struct Debug debug_new(void);
 void debug_free(struct Debug *debug);
+
+uint32_t debug_pack_color(struct Vector4 color);
+
+// makes room for count lines in the current target and returns them for the
+// caller to fill, or NULL if the allocation failed.
+struct Line *debug_reserve_lines(struct Debug *debug, size_t count);
+
+// everything added between begin and end is uploaded once and drawn every
+// frame until debug_clear_static.
+void debug_begin_static(struct Debug *debug);
+void debug_end_static(struct Debug *debug);
+void debug_clear_static(struct Debug *debug);
+
+// draws with the view_proj from the FrameData uniform block.
+void debug_update(struct Debug *debug);
+
 void debug_add_line(struct Debug *debug, struct Vector4 a, struct Vector4 b,
                     struct Vector4 color);
-void debug_update(struct Debug *debug, struct Matrix4 const *view_proj);
 
 void debug_add_aabb(struct Debug *debug, struct Vector4 center,
                     struct Vector4 extents, struct Vector4 color);
 
+// three great circles around the axes.
+void debug_add_sphere(struct Debug *debug, struct Vector4 center, float radius,
+                      uint32_t segments, struct Vector4 color);
+
+// the frustum of a view projection, pass its inverse.
+void debug_add_frustum(struct Debug *debug, struct Matrix4 const *inverse_vp,
+                       struct Vector4 color);
+
+// cells x cells grid on the xz plane centered on center.
+void debug_add_grid(struct Debug *debug, struct Vector4 center, uint32_t cells,
+                    float spacing, struct Vector4 color);
+
+void debug_add_arrow(struct Debug *debug, struct Vector4 from,
+                     struct Vector4 to, struct Vector4 color);
+
+// profiler overlay in the bottom left corner of the screen: the frame time
+// graph with 16.6 and 33.3 ms marks, and a bar per zone of the last frame,
+// longest first (profiler_print has the names). lines are placed in screen
+// space through the inverse of the view projection that draws them.
+void debug_add_profiler(struct Debug *debug, struct Matrix4 const *inverse_vp);
+
 #endif
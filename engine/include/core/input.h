@@ -10,6 +10,8 @@ enum Keycode {
   KEYCODE_UNSUPPORTED,
   KEYCODE_A,
   KEYCODE_D,
+  KEYCODE_P,
+  KEYCODE_R,
   KEYCODE_S,
   KEYCODE_W,
   KEYCODE_COUNT
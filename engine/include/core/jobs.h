@@ -0,0 +1,76 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// fixed pool of worker threads, each with a work stealing deque. the thread
+// that called jobs_new owns deque 0 and helps out while it waits. on the web
+// build without pthreads there are no workers and jobs run on the calling
+// thread inside jobs_wait.
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define JOBS_THREADS 0
+#else
+#define JOBS_THREADS 1
+#endif
+
+#define JOBS_MAX_WORKERS 15
+// per thread, a job that doesn't fit runs inline instead. power of two.
+#define JOBS_DEQUE_SIZE 4096
+
+typedef void (*JobFunc)(void *data);
+typedef void (*JobRangeFunc)(void *data, uint32_t begin, uint32_t end);
+
+// number of jobs still to finish. a job's counter is decremented when it
+// returns, so a counter can gate work that depends on a batch of jobs.
+struct JobCounter {
+  int32_t value;
+};
+
+struct Job {
+  JobFunc func;
+  void *data;
+  // filled in by jobs_run
+  struct JobCounter *counter;
+};
+
+struct JobStats {
+  uint64_t executed;
+  uint64_t stolen;
+};
+
+struct JobDeque;
+struct JobWorkers;
+
+struct JobSystem {
+  uint32_t worker_count;
+  // worker_count + 1 deques, index 0 belongs to the owning thread
+  struct JobDeque *deques;
+  struct JobStats stats[JOBS_MAX_WORKERS + 1];
+  struct JobWorkers *workers;
+  int32_t pending;
+  int32_t quit;
+};
+
+// logical cores available to the process.
+uint32_t jobs_cpu_count(void);
+
+// starts worker_count threads (clamped to JOBS_MAX_WORKERS, 0 is fine). the
+// struct must stay at the same address until jobs_free.
+bool jobs_new(struct JobSystem *js, uint32_t worker_count);
+void jobs_free(struct JobSystem *js);
+
+// queues count jobs, adding count to counter first if it isn't NULL. must be
+// called from the owning thread or from inside a job.
+void jobs_run(struct JobSystem *js, struct Job const *jobs, uint32_t count,
+              struct JobCounter *counter);
+
+// runs queued jobs on the calling thread until counter reaches zero.
+void jobs_wait(struct JobSystem *js, struct JobCounter *counter);
+
+// splits [0, count) into batches of at least min_batch and blocks until func
+// has run over all of them.
+void jobs_parallel_for(struct JobSystem *js, uint32_t count,
+                       uint32_t min_batch, JobRangeFunc func, void *data);
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// threads that can record zones, the owning thread plus every job worker
+#define PROFILER_MAX_THREADS 16
+// zones a thread can record between two profiler_frame calls. power of two.
+#define PROFILER_RING_SIZE 4096
+// zones open at once on one thread
+#define PROFILER_MAX_DEPTH 32
+// distinct zone names aggregated per frame
+#define PROFILER_MAX_ZONES 64
+// frame times kept for the overlay graph
+#define PROFILER_HISTORY 128
+// most recent zones kept for profiler_write_chrome_trace
+#define PROFILER_CAPTURE_SIZE 65536
+// GPU timings reported per frame
+#define PROFILER_MAX_GPU_ZONES 16
+// track the GPU timings show up on in traces
+#define PROFILER_GPU_THREAD PROFILER_MAX_THREADS
+
+// zones are timed with a monotonic nanosecond clock. names must be string
+// literals or otherwise outlive the profiler, they are stored by pointer.
+// build with -DPROFILER_DISABLE to compile the zones out.
+#ifdef PROFILER_DISABLE
+#define PROFILE_BEGIN(name) ((void)0)
+#define PROFILE_END() ((void)0)
+#else
+#define PROFILE_BEGIN(name) profiler_begin(name)
+#define PROFILE_END() profiler_end()
+#endif
+
+// a finished zone. depth is how many zones were open around it.
+struct ProfilerEvent {
+  char const *name;
+  uint64_t begin;
+  uint64_t end;
+  uint32_t thread;
+  uint32_t depth;
+};
+
+// inclusive time of every zone with this name in one frame, over all threads.
+struct ProfilerZone {
+  char const *name;
+  uint64_t total_ns;
+  uint32_t calls;
+};
+
+struct ProfilerFrame {
+  float frame_ms;
+  // sorted by total_ns, largest first
+  struct ProfilerZone zones[PROFILER_MAX_ZONES];
+  uint32_t zone_count;
+  // zones lost because a ring filled up before the frame was collected
+  uint32_t dropped;
+};
+
+// the profiler is global so zones can be recorded from anywhere without
+// passing it around. the thread that calls profiler_init owns it and is
+// thread 0 in traces, others get an index the first time they record a zone.
+// until profiler_init the zones do nothing.
+bool profiler_init(void);
+void profiler_shutdown(void);
+
+uint64_t profiler_now(void);
+
+void profiler_begin(char const *name);
+void profiler_end(void);
+
+// owning thread only. a duration measured elsewhere, e.g. a GPU timer query,
+// counted with the next profiler_frame. there is no start time, in traces
+// the GPU zones of a frame are laid end to end from the start of that frame.
+void profiler_gpu_zone(char const *name, uint64_t duration_ns);
+
+// owning thread only. collects the zones every thread recorded since the last
+// call into the frame stats and the capture.
+void profiler_frame(void);
+
+struct ProfilerFrame const *profiler_last_frame(void);
+// frame times in ms, oldest first.
+void profiler_history(float out[PROFILER_HISTORY]);
+void profiler_print(uint32_t max_zones);
+
+// writes the capture in the Chrome trace event format, for chrome://tracing
+// or https://ui.perfetto.dev.
+bool profiler_write_chrome_trace(char const *path);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef TIMESTEP_H
+#define TIMESTEP_H
+
+#include <stdint.h>
+
+#define TIMESTEP_DEFAULT_HZ 60
+// steps run per frame at most, time beyond that is dropped so a long stall
+// (a breakpoint, a level load) can't snowball into ever longer frames
+#define TIMESTEP_MAX_STEPS 8
+
+// fixed step accumulator. time is measured in ticks of whatever counter the
+// caller feeds it (SDL_GetPerformanceCounter in the game), kept as integers so
+// the step length never drifts. a headless run can pass made up counter values
+// to simulate faster than real time.
+struct Timestep {
+  uint64_t frequency;
+  uint64_t step_ticks;
+  uint64_t accumulator;
+  uint64_t last;
+  uint32_t max_steps;
+  // seconds per step, what the simulation integrates with
+  float dt;
+  // how far the accumulator is into the next step, 0 to 1. the renderer blends
+  // the last two simulation states by this much.
+  float alpha;
+  uint64_t steps;
+  uint64_t dropped_ticks;
+};
+
+// hz steps per second of a counter running at frequency ticks per second,
+// starting at now.
+struct Timestep timestep_new(uint32_t hz, uint64_t frequency, uint64_t now);
+
+// adds the time since the last call and returns how many steps to run,
+// updating alpha for the time left over.
+uint32_t timestep_advance(struct Timestep *timestep, uint64_t now);
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef VERTEX_CACHE_H
+#define VERTEX_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// cache size the optimizer scores for. GPUs have used 16 to 32 entries, an
+// order that is good for 32 stays close to optimal for smaller caches.
+#define VERTEX_CACHE_SIZE 32
+// largest cache vertex_cache_acmr can simulate
+#define VERTEX_CACHE_MAX_SIMULATED 64
+
+// reorders the triangles of an indexed triangle list in place so vertices
+// are reused while they are still in the post transform cache (Forsyth,
+// "Linear-Speed Vertex Cache Optimisation"). winding is kept, the vertex
+// buffer is not touched. returns false if the scratch allocation failed,
+// leaving indices as they were.
+bool vertex_cache_optimize(uint32_t *indices, uint32_t index_count,
+                           uint32_t vertex_count);
+
+// average cache miss ratio: vertices transformed per triangle with a FIFO
+// cache of cache_size entries. 3 is no reuse at all, about 0.5 is the floor
+// for a large regular grid.
+float vertex_cache_acmr(uint32_t const *indices, uint32_t index_count,
+                        uint32_t cache_size);
+
+#endif
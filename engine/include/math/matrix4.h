@@ -10,6 +10,9 @@
 
 #include "math/vector4.h"
 
+#include <stdbool.h>
+#include <stddef.h>
+
 /**
  * A 4x4 square matrix.
  *
@@ -60,6 +63,28 @@ float Matrix4_determinant(struct Matrix4 const *m);
 struct Matrix4 Matrix4_frustum(float left, float right, float bottom, float top,
                                float near, float far);
 
+/**
+ * Extracts the six clipping planes of a view projection matrix
+ * (Gribb/Hartmann). Each plane is (a, b, c, d) with a normalized normal
+ * pointing into the frustum, so a point p is inside when a*x + b*y + c*z + d
+ * >= 0.
+ *
+ * @param m - the view projection matrix.
+ * @param planes - receives the left, right, bottom, top, near and far planes.
+ */
+void Matrix4_frustum_planes(struct Matrix4 const *m, struct Vector4 planes[6]);
+
+/**
+ * Conservative test of an axis aligned box against frustum planes.
+ *
+ * @param planes - planes from Matrix4_frustum_planes.
+ * @param min - the minimum corner of the box.
+ * @param max - the maximum corner of the box.
+ * @return - false only if the box is fully outside one of the planes.
+ */
+bool Matrix4_frustum_intersects_aabb(struct Vector4 const planes[6],
+                                     struct Vector4 min, struct Vector4 max);
+
 /**
  * Returns the first column as a Vector4.
  *
@@ -139,6 +164,11 @@ struct Matrix4 Matrix4_identity(void);
  */
 struct Matrix4 Matrix4_invert(struct Matrix4 const *m);
 
+/**
+ * Scalar reference of Matrix4_invert, see math/simd.h.
+ */
+struct Matrix4 Matrix4_invert_scalar(struct Matrix4 const *m);
+
 /**
  * Generate a camera matrix that is looking at a target. RH
  *
@@ -160,6 +190,12 @@ struct Matrix4 Matrix4_lookat(struct Vector4 eye, struct Vector4 target,
 struct Matrix4 Matrix4_multiply(struct Matrix4 const *a,
                                 struct Matrix4 const *b);
 
+/**
+ * Scalar reference of Matrix4_multiply, see math/simd.h.
+ */
+struct Matrix4 Matrix4_multiply_scalar(struct Matrix4 const *a,
+                                       struct Matrix4 const *b);
+
 /**
  * Generates an orthographic projection matrix.
  *
@@ -199,6 +235,33 @@ struct Matrix4 Matrix4_orthographic_nf(float left, float right, float bottom,
 struct Matrix4 Matrix4_perspective(float fovy, float aspect_ratio, float near,
                                    float far);
 
+/**
+ * Transforms an array of Vector4s and divides each result by its w, e.g. to
+ * take NDC coordinates back to world space through an inverse view
+ * projection. The results have w == 1.
+ *
+ * @param m - the matrix that will transform the vectors.
+ * @param in - count vectors to transform.
+ * @param out - receives count projected vectors, may alias in.
+ * @param count - the number of vectors.
+ */
+void Matrix4_project_array(struct Matrix4 const *m, struct Vector4 const *in,
+                           struct Vector4 *out, size_t count);
+
+/**
+ * Transforms points (w == 1) stored as separate x, y and z streams and
+ * divides each result by its w.
+ *
+ * @param m - the matrix that will transform the points.
+ * @param x, y, z - count input coordinates each.
+ * @param out_x, out_y, out_z - receive count projected coordinates each, may
+ * alias the inputs.
+ * @param count - the number of points.
+ */
+void Matrix4_project_points_soa(struct Matrix4 const *m, float const *x,
+                                float const *y, float const *z, float *out_x,
+                                float *out_y, float *out_z, size_t count);
+
 /**
  * Generates a rotation matrix around the X axis.
  *
@@ -306,6 +369,38 @@ struct Matrix4 Matrix4_scale(float x, float y, float z);
  */
 struct Vector4 Matrix4_transform(struct Matrix4 const *m, struct Vector4 v);
 
+/**
+ * Scalar reference of Matrix4_transform, see math/simd.h.
+ */
+struct Vector4 Matrix4_transform_scalar(struct Matrix4 const *m,
+                                        struct Vector4 v);
+
+/**
+ * Multiply a Matrix4 with every Vector4 of an array. M * V[i]
+ *
+ * @param m - the matrix that will transform the vectors.
+ * @param in - count vectors to transform.
+ * @param out - receives count transformed vectors, may alias in.
+ * @param count - the number of vectors.
+ */
+void Matrix4_transform_array(struct Matrix4 const *m, struct Vector4 const *in,
+                             struct Vector4 *out, size_t count);
+
+/**
+ * Transforms points (w == 1) stored as separate x, y and z streams. The w of
+ * the result is dropped, use Matrix4_project_points_soa for projections.
+ *
+ * @param m - the matrix that will transform the points.
+ * @param x, y, z - count input coordinates each.
+ * @param out_x, out_y, out_z - receive count transformed coordinates each,
+ * may alias the inputs.
+ * @param count - the number of points.
+ */
+void Matrix4_transform_points_soa(struct Matrix4 const *m, float const *x,
+                                  float const *y, float const *z,
+                                  float *out_x, float *out_y, float *out_z,
+                                  size_t count);
+
 /**
  * Generates a translation matrix.
  *
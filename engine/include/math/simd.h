@@ -0,0 +1,97 @@
+/**
+ * @file
+ *
+ * @section DESCRIPTION
+ * A thin 4 wide float abstraction over the SIMD instruction sets the engine
+ * builds for. The backend is picked at compile time:
+ *
+ * - SSE2 on x86 (always present on x86_64).
+ * - WASM SIMD128 when emscripten is given -msimd128.
+ * - NEON on aarch64.
+ *
+ * Define MATH_NO_SIMD to force the scalar code paths. MATH_SIMD is 1 when a
+ * backend is available and 0 otherwise, the scalar reference implementations
+ * are always compiled so the two can be compared.
+ */
+#ifndef MathSimd_h
+#define MathSimd_h
+
+#if defined(MATH_NO_SIMD)
+#define MATH_SIMD 0
+#elif defined(__wasm_simd128__)
+#define MATH_SIMD 1
+#define MATH_SIMD_WASM 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#define MATH_SIMD 1
+#define MATH_SIMD_SSE 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define MATH_SIMD 1
+#define MATH_SIMD_NEON 1
+#else
+#define MATH_SIMD 0
+#endif
+
+#if MATH_SIMD_SSE
+#include <emmintrin.h>
+
+typedef __m128 simd4f;
+
+#define simd4f_load(p) _mm_loadu_ps(p)
+#define simd4f_store(p, a) _mm_storeu_ps(p, a)
+#define simd4f_set(x, y, z, w) _mm_setr_ps(x, y, z, w)
+#define simd4f_splat(s) _mm_set1_ps(s)
+#define simd4f_add(a, b) _mm_add_ps(a, b)
+#define simd4f_sub(a, b) _mm_sub_ps(a, b)
+#define simd4f_mul(a, b) _mm_mul_ps(a, b)
+#define simd4f_div(a, b) _mm_div_ps(a, b)
+#define simd4f_first(a) _mm_cvtss_f32(a)
+// (a[x], a[y], b[z], b[w])
+#define simd4f_shuffle(a, b, x, y, z, w)                                       \
+  _mm_shuffle_ps(a, b, _MM_SHUFFLE(w, z, y, x))
+
+#elif MATH_SIMD_WASM
+#include <wasm_simd128.h>
+
+typedef v128_t simd4f;
+
+#define simd4f_load(p) wasm_v128_load(p)
+#define simd4f_store(p, a) wasm_v128_store(p, a)
+#define simd4f_set(x, y, z, w) wasm_f32x4_make(x, y, z, w)
+#define simd4f_splat(s) wasm_f32x4_splat(s)
+#define simd4f_add(a, b) wasm_f32x4_add(a, b)
+#define simd4f_sub(a, b) wasm_f32x4_sub(a, b)
+#define simd4f_mul(a, b) wasm_f32x4_mul(a, b)
+#define simd4f_div(a, b) wasm_f32x4_div(a, b)
+#define simd4f_first(a) wasm_f32x4_extract_lane(a, 0)
+// (a[x], a[y], b[z], b[w])
+#define simd4f_shuffle(a, b, x, y, z, w)                                       \
+  wasm_i32x4_shuffle(a, b, x, y, (z) + 4, (w) + 4)
+
+#elif MATH_SIMD_NEON
+#include <arm_neon.h>
+
+typedef float32x4_t simd4f;
+
+#define simd4f_load(p) vld1q_f32(p)
+#define simd4f_store(p, a) vst1q_f32(p, a)
+#define simd4f_set(x, y, z, w) ((float32x4_t){x, y, z, w})
+#define simd4f_splat(s) vdupq_n_f32(s)
+#define simd4f_add(a, b) vaddq_f32(a, b)
+#define simd4f_sub(a, b) vsubq_f32(a, b)
+#define simd4f_mul(a, b) vmulq_f32(a, b)
+#define simd4f_div(a, b) vdivq_f32(a, b)
+#define simd4f_first(a) vgetq_lane_f32(a, 0)
+// (a[x], a[y], b[z], b[w])
+#define simd4f_shuffle(a, b, x, y, z, w)                                       \
+  __builtin_shufflevector(a, b, x, y, (z) + 4, (w) + 4)
+
+#endif
+
+#if MATH_SIMD
+// (a[x], a[y], a[z], a[w])
+#define simd4f_swizzle(a, x, y, z, w) simd4f_shuffle(a, a, x, y, z, w)
+// all lanes set to a[i]
+#define simd4f_lane(a, i) simd4f_shuffle(a, a, i, i, i, i)
+#endif
+
+#endif
@@ -174,4 +174,14 @@ struct Vector4 Vector4_subtract(struct Vector4 a, struct Vector4 b);
  */
 struct Vector4 Vector4_scale(struct Vector4 v, float s);
 
+/**
+ * Scalar references of the functions above that have SIMD kernels, see
+ * math/simd.h. Dot and cross stay scalar, a horizontal reduction or a
+ * shuffle costs more than it saves on a single by value Vector4.
+ */
+struct Vector4 Vector4_lerp_scalar(struct Vector4 a, struct Vector4 b, float t);
+struct Vector4 Vector4_add_scalar(struct Vector4 a, struct Vector4 b);
+struct Vector4 Vector4_subtract_scalar(struct Vector4 a, struct Vector4 b);
+struct Vector4 Vector4_scale_scalar(struct Vector4 v, float s);
+
 #endif
@@ -0,0 +1,21 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// LZ77 in the LZ4 block format (token, literals, 16 bit offset, match
+// length), a greedy single probe compressor and a bounds checked decoder.
+// favours decode speed over ratio.
+
+// largest output lz_compress can produce for size bytes.
+size_t lz_compress_bound(size_t size);
+
+// returns the compressed size, 0 if it didn't fit in capacity.
+size_t lz_compress(uint8_t const *src, size_t size, uint8_t *dst,
+                   size_t capacity);
+
+// false unless src decodes to exactly dst_size bytes.
+bool lz_decompress(uint8_t const *src, size_t size, uint8_t *dst,
+                   size_t dst_size);
+#endif
@@ -1,6 +1,7 @@
 #ifndef FILE_H
 #define FILE_H
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 struct File {
@@ -8,6 +9,92 @@ struct File {
   size_t length;
 };
 
+// a whole file mapped into memory. writes land in private copy on write
+// pages and never reach the file. where mmap isn't available (the web build)
+// the file is read into an allocation instead.
+struct FileMap {
+  uint8_t *data;
+  size_t length;
+  bool mapped;
+};
+
 bool file_read_all(struct File *file, char const *path);
 void file_free(struct File *file);
+
+bool file_map(struct FileMap *map, char const *path);
+void file_unmap(struct FileMap *map);
+
+// asynchronous reads on a small pool of io threads doing positioned reads, so
+// the calling thread never waits on the disk. on the web build without
+// pthreads the reads happen inside file_io_poll and file_io_wait instead.
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define FILE_IO_THREADS 0
+#else
+#define FILE_IO_THREADS 2
+#endif
+
+#define FILE_IO_MAX_REQUESTS 64
+#define FILE_IO_MAX_PATH 256
+// largest single read, also the piece size handed to on_chunk
+#define FILE_IO_CHUNK_SIZE (256 * 1024)
+
+// 0 is never a valid request
+typedef uint32_t FileRequest;
+
+enum FileRequestStatus {
+  // finished and released, or never issued
+  FILE_REQUEST_INVALID,
+  FILE_REQUEST_PENDING,
+  FILE_REQUEST_DONE,
+  FILE_REQUEST_FAILED
+};
+
+// runs on an io thread as each piece of the file arrives, offset is from the
+// start of the file.
+typedef void (*FileChunkFunc)(void *user, uint8_t const *data, size_t offset,
+                              size_t size);
+// runs inside file_io_poll. file->data is NULL when the read failed or was
+// streamed through the buffer, the caller's buffer when the file fit in it,
+// and otherwise a new NUL terminated allocation the callback owns.
+typedef void (*FileDoneFunc)(void *user, struct File *file, bool ok);
+
+struct FileReadDesc {
+  char const *path;
+  // optional. a file that fits is read into it whole. a bigger one is
+  // streamed through it, capacity bytes at a time, which needs on_chunk.
+  // NULL allocates the whole file.
+  uint8_t *buffer;
+  size_t capacity;
+  FileChunkFunc on_chunk;
+  // without one the request stays around until file_io_take
+  FileDoneFunc on_done;
+  void *user;
+};
+
+struct FileIoRequest;
+struct FileIoThreads;
+
+struct FileIo {
+  struct FileIoRequest *requests;
+  struct FileIoThreads *threads;
+  uint64_t bytes_read;
+};
+
+// the struct must stay at the same address until file_io_free, which waits
+// for the reads in flight and drops the rest.
+bool file_io_new(struct FileIo *io);
+void file_io_free(struct FileIo *io);
+
+// queues a read, returns 0 if every request slot is in use.
+FileRequest file_io_read(struct FileIo *io, struct FileReadDesc const *desc);
+enum FileRequestStatus file_io_status(struct FileIo const *io,
+                                      FileRequest request);
+// blocks until the request is no longer pending.
+void file_io_wait(struct FileIo *io, FileRequest request);
+// for requests without on_done: once finished, fills file like on_done would
+// and releases the request.
+enum FileRequestStatus file_io_take(struct FileIo *io, FileRequest request,
+                                    struct File *file);
+// calls on_done for every finished request that has one, once a frame.
+void file_io_poll(struct FileIo *io);
 #endif
@@ -0,0 +1,11 @@
+#ifndef PNG_H
+#define PNG_H
+#include <stdbool.h>
+#include <stdint.h>
+
+// writes an 8 bit RGBA image, rows top to bottom. the pixels are stored
+// uncompressed (deflate stored blocks), it's meant for test captures, not
+// assets.
+bool png_write_rgba(char const *path, uint8_t const *pixels, uint32_t width,
+                    uint32_t height);
+#endif
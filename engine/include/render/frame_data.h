@@ -0,0 +1,25 @@
+#ifndef FRAME_DATA_H
+#define FRAME_DATA_H
+
+#include "math/matrix4.h"
+#include "math/vector4.h"
+
+// uniform block binding point shared by every program that reads FrameData.
+#define FRAME_DATA_BINDING 0
+#define FRAME_DATA_BLOCK "FrameData"
+
+// mirrors the std140 FrameData block in the shaders. every member is a vec4
+// or mat4 so the C layout matches std140 without padding.
+struct FrameData {
+  struct Matrix4 view_proj;
+  struct Vector4 ambient_dir;
+  struct Vector4 ambient_color;
+  struct Vector4 light_pos;
+  struct Vector4 light_color;
+  struct Vector4 camera_eye;
+  struct Vector4 fog_color;
+  // x and y are the fog start and end distances
+  struct Vector4 fog_props;
+};
+
+#endif
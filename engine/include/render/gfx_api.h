@@ -14,19 +14,282 @@ struct Shader {
   uint32_t fragment_shader;
 };
 
+enum IndexType { INDEX_TYPE_NONE, INDEX_TYPE_U16, INDEX_TYPE_U32 };
+
 struct Mesh {
   uint32_t vertex_buffer;
   uint32_t vao;
+  // INDEX_TYPE_NONE draws the vertices in order
+  uint32_t index_buffer;
+  enum IndexType index_type;
+  // false for a buffer shared between meshes, e.g. the quad pattern
+  bool owns_index_buffer;
+};
+
+// the 0 1 2, 2 3 0 triangle pattern for quads stored as 4 vertices, shared by
+// every mesh made of such quads. 16 bit while the vertices fit.
+struct QuadIndexBuffer {
+  uint32_t buffer;
+  enum IndexType type;
+  uint32_t quad_count;
+};
+
+#define VERTEX_LAYOUT_MAX_ATTRIBS 8
+
+enum VertexType {
+  VERTEX_TYPE_FLOAT,
+  VERTEX_TYPE_I8,
+  VERTEX_TYPE_U8,
+  VERTEX_TYPE_I16,
+  VERTEX_TYPE_U16,
+  VERTEX_TYPE_I32,
+  VERTEX_TYPE_U32
+};
+
+struct VertexAttrib {
+  uint32_t location;
+  // 1 to 4
+  uint32_t components;
+  enum VertexType type;
+  // bytes from the start of the vertex
+  uint32_t offset;
+  // fixed point types read as floats in [0, 1] or [-1, 1] instead of their
+  // plain value
+  bool normalized;
+  // read as an int or uint vector in the shader, no conversion to float
+  bool integer;
+  // 0 advances every vertex, n once every n instances
+  uint32_t divisor;
+};
+
+// how the bytes of one vertex buffer map to shader inputs.
+struct VertexLayout {
+  uint32_t stride;
+  uint32_t attrib_count;
+  struct VertexAttrib attribs[VERTEX_LAYOUT_MAX_ATTRIBS];
+};
+
+// per instance data for the instanced cube path.
+struct CubeInstance {
+  float x;
+  float y;
+  float z;
+  uint32_t palette_index;
+};
+
+// draws many copies of a base mesh (position, normal layout) with the
+// translation and palette index read from a second vertex buffer. uses the
+// base mesh's indices if it has them.
+struct InstancedMesh {
+  uint32_t vao;
+  uint32_t instance_buffer;
+  enum IndexType index_type;
+  // indices when indexed
+  uint32_t vertex_count;
+  uint32_t instance_count;
+};
+
+// uniform buffer object bound to a fixed uniform block binding point.
+struct UniformBuffer {
+  uint32_t buffer;
+  uint32_t binding;
+  size_t size;
+};
+
+// row length of the 2D texture behind a DataTexture on WebGL2.
+#define DATA_TEXTURE_WIDTH 256
+
+// 32 bit words a shader reads by index with texelFetch. a texture buffer
+// (usamplerBuffer) on GL 3.3, WebGL2 has none so there the words are the rows
+// of a DATA_TEXTURE_WIDTH wide R32UI texture (usampler2D) instead.
+struct DataTexture {
+  uint32_t texture;
+  // the buffer behind the texture, 0 on WebGL2
+  uint32_t buffer;
+  // words the current storage holds
+  uint32_t capacity;
+};
+
+// frames of data a stream buffer keeps in flight before reusing a region.
+#define STREAM_BUFFER_FRAMES 3
+
+struct StreamBufferStats {
+  // bytes written during the last finished frame
+  size_t frame_bytes;
+  // regions reused without waiting because the GPU was already done with
+  // them, each one a sync the driver would have done on a glBufferData
+  uint32_t stalls_avoided;
+  // regions that were still in use and had to be waited on
+  uint32_t stalls;
+  // storage reallocations on the orphaning path (WebGL2)
+  uint32_t orphans;
+};
+
+// vertex data rewritten every frame. the buffer is split into one region per
+// frame in flight, writes map the current region unsynchronized and a fence
+// guards it until the GPU has drawn from it. WebGL2 can't map buffers, there
+// the single region is orphaned at the start of every frame instead.
+struct StreamBuffer {
+  uint32_t buffer;
+  size_t frame_size;
+  // write offset inside the current frame's region
+  size_t head;
+  uint32_t frame;
+  bool region_ready;
+  // GLsync per region, kept opaque so this header doesn't need gl.h
+  void *fences[STREAM_BUFFER_FRAMES];
+  struct StreamBufferStats stats;
+};
+
+// frames a GPU timer query may take to come back before its results are
+// dropped instead of waited on.
+#define GPU_TIMER_FRAMES 4
+#define GPU_TIMER_MAX_PASSES 8
+
+struct GpuTimerFrame {
+  uint32_t queries[GPU_TIMER_MAX_PASSES];
+  char const *names[GPU_TIMER_MAX_PASSES];
+  uint32_t pass_count;
+  bool pending;
+};
+
+// GL_TIME_ELAPSED queries around render passes, one set per frame in a ring
+// so results are read a few frames late without stalling. queries can't nest,
+// only one pass is timed at a time. on WebGL2 this needs
+// EXT_disjoint_timer_query_webgl2, without it every call does nothing.
+struct GpuTimer {
+  bool supported;
+  struct GpuTimerFrame frames[GPU_TIMER_FRAMES];
+  uint32_t frame;
+  bool pass_open;
+  // the most recent frame that came back
+  char const *pass_names[GPU_TIMER_MAX_PASSES];
+  float pass_ms[GPU_TIMER_MAX_PASSES];
+  uint32_t pass_count;
+  // frames whose results were thrown away, still pending when their slot came
+  // around again or invalidated by a disjoint event
+  uint32_t frames_dropped;
 };
 
+// state changing calls routed through the gfx_* cache since the last
+// gfx_stats_reset.
+struct GfxStats {
+  uint32_t calls_issued;
+  uint32_t calls_skipped;
+};
+
+// forgets everything the state cache knows, call after creating a context or
+// after any code changed GL state behind the cache's back.
+void gfx_state_reset(void);
+struct GfxStats gfx_stats_get(void);
+void gfx_stats_reset(void);
+
+// cached binds and enables, these skip the GL call when the state already
+// matches.
+void gfx_use_program(uint32_t program);
+void gfx_bind_vertex_array(uint32_t vao);
+void gfx_bind_array_buffer(uint32_t buffer);
+void gfx_bind_uniform_buffer(uint32_t buffer);
+void gfx_set_depth_test(bool enable);
+void gfx_set_depth_mask(bool enable);
+void gfx_set_blend(bool enable);
+// deletes and drops the object from the cache if it is bound.
+void gfx_delete_buffer(uint32_t buffer);
+void gfx_delete_vertex_array(uint32_t vao);
+
+// float3 position, float3 normal at locations 0 and 1, 24 bytes.
+struct VertexLayout vertex_layout_position_normal(void);
+
+// points the attributes at the buffer bound to GL_ARRAY_BUFFER, for the
+// bound vertex array.
+void vertex_layout_apply(struct VertexLayout const *layout);
+
 struct Mesh mesh_new(void);
 
-void mesh_fill(struct Mesh const *m, float const *data, size_t size);
+// uploads size bytes of vertices and sets up the vertex array for them.
+void mesh_fill(struct Mesh const *m, struct VertexLayout const *layout,
+               void const *data, size_t size);
+
+// uploads count indices into a buffer owned by the mesh.
+void mesh_fill_indices(struct Mesh *m, void const *indices, uint32_t count,
+                       enum IndexType type);
+
+// draws through an index buffer the mesh doesn't own, which must outlive it.
+void mesh_set_index_buffer(struct Mesh *m, uint32_t buffer,
+                           enum IndexType type);
 
 void mesh_bind(struct Mesh const *m);
 
+// binds the mesh and draws count indices, or count vertices for a mesh
+// without indices, as triangles.
+void mesh_draw(struct Mesh const *m, uint32_t count);
+
 void mesh_free(struct Mesh *m);
 
+// the base mesh must outlive the instanced mesh, its vertex and index
+// buffers are shared. vertex_count counts indices for an indexed base.
+struct InstancedMesh instanced_mesh_new(struct Mesh const *base,
+                                        uint32_t vertex_count);
+
+// replaces the instance buffer contents with a single upload.
+void instanced_mesh_fill(struct InstancedMesh *m,
+                         struct CubeInstance const *instances, uint32_t count);
+
+void instanced_mesh_draw(struct InstancedMesh const *m);
+
+void instanced_mesh_free(struct InstancedMesh *m);
+
+struct QuadIndexBuffer quad_index_buffer_new(uint32_t quad_count);
+void quad_index_buffer_free(struct QuadIndexBuffer *qb);
+
+struct DataTexture data_texture_new(void);
+
+// replaces the contents with count words. the storage only grows, on WebGL2
+// a fill that fits is a sub-upload.
+void data_texture_fill(struct DataTexture *dt, uint32_t const *words,
+                       uint32_t count);
+
+void data_texture_bind(struct DataTexture const *dt, uint32_t unit);
+void data_texture_free(struct DataTexture *dt);
+
+struct UniformBuffer uniform_buffer_new(size_t size, uint32_t binding);
+
+// size must match the size the buffer was created with.
+void uniform_buffer_update(struct UniformBuffer const *ub, void const *data,
+                           size_t size);
+
+// rewrites size bytes at offset, the rest of the buffer is kept.
+void uniform_buffer_update_range(struct UniformBuffer const *ub, size_t offset,
+                                 void const *data, size_t size);
+
+void uniform_buffer_free(struct UniformBuffer *ub);
+
+// frame_size is the most data that can be written between two
+// stream_buffer_end_frame calls.
+struct StreamBuffer stream_buffer_new(size_t frame_size);
+
+// copies data into the current frame's region at the next multiple of
+// alignment. offset receives the byte offset into sb->buffer. returns false
+// without writing when the region is full.
+bool stream_buffer_write(struct StreamBuffer *sb, void const *data,
+                         size_t size, size_t alignment, size_t *offset);
+
+// call after the draws that read this frame's data have been issued.
+void stream_buffer_end_frame(struct StreamBuffer *sb);
+
+void stream_buffer_free(struct StreamBuffer *sb);
+
+struct GpuTimer gpu_timer_new(void);
+void gpu_timer_free(struct GpuTimer *timer);
+
+// name must outlive the results, it is stored by pointer.
+void gpu_timer_begin(struct GpuTimer *timer, char const *name);
+void gpu_timer_end(struct GpuTimer *timer);
+
+// call once per frame after the last pass. collects every frame whose
+// queries are done and hands the newest one's passes to the profiler.
+void gpu_timer_end_frame(struct GpuTimer *timer);
+
 bool shader_new(struct Shader *shader, char const *vertex_src,
                 char const *frag_src);
 
@@ -34,12 +297,20 @@ void shader_free(struct Shader *s);
 
 void shader_bind(struct Shader const *s);
 
+// points the named uniform block of the shader at a binding point.
+void shader_bind_uniform_block(struct Shader const *s, char const *block_name,
+                               uint32_t binding);
+
 uint32_t shader_get_uniform(struct Shader const *s, char const *uniform_name);
 
+// matrix and vector uniforms of the bound program are cached by value.
 void shader_set_matrix_uniform(uint32_t uniform_location,
                                struct Matrix4 const *m);
 
 void shader_set_vector_uniform(uint32_t uniform_location,
                                struct Vector4 const *v);
 
+// samplers and plain ints, not cached.
+void shader_set_int_uniform(uint32_t uniform_location, int32_t value);
+
 #endif
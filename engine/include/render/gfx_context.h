@@ -1,30 +1,83 @@
 #ifndef GFX_CONTEXT_H
 #define GFX_CONTEXT_H
 
+#include <platform/file.h>
 #include <render/gfx_api.h>
 #include <stdbool.h>
 
 struct SDL_Window;
+struct GraphicsContext;
+
+// basic vertex and fragment, basic instanced vertex, voxel pull vertex
+#define GRAPHICS_SHADER_SOURCES 4
+
+struct ShaderSource {
+  struct GraphicsContext *graphics;
+  struct File file;
+};
+
+struct GraphicsConfig {
+  uint32_t width;
+  uint32_t height;
+  // hidden window, everything is drawn into an offscreen framebuffer. pair it
+  // with SDL_VIDEODRIVER=offscreen (and Mesa's llvmpipe) on machines without
+  // a display or GPU. ignored on the web build.
+  bool headless;
+};
 
 struct GraphicsContext {
   struct SDL_Window *window;
+  // offscreen target when headless, 0 means the window's framebuffer
+  uint32_t framebuffer;
+  uint32_t color_renderbuffer;
+  uint32_t depth_renderbuffer;
   struct Mesh cube;
+  // packed voxel vertices, materials come from the palette block
   struct Shader basic_lighting;
-  uint32_t basic_lighting_view_proj;
   uint32_t basic_lighting_model;
-  uint32_t basic_lighting_color;
-  uint32_t basic_lighting_ambient_dir;
-  uint32_t basic_lighting_ambient_color;
-  uint32_t basic_lighting_light_pos;
-  uint32_t basic_lighting_light_color;
-  uint32_t basic_lighting_camera_eye;
-  uint32_t basic_lighting_fog_color;
-  uint32_t basic_lighting_fog_props;
+  // cube instances, translation and palette index come from the instance
+  // buffer instead of uniforms.
+  struct Shader basic_instanced;
+  // voxel face words read from a data texture (MESH_FORMAT_FACES), lit like
+  // basic_lighting
+  struct Shader voxel_pull;
+  uint32_t voxel_pull_model;
+  uint32_t voxel_pull_faces;
+  // per frame world state read by every program through the FrameData block
+  struct UniformBuffer frame_data;
+  // GridMaterial entries read through the Palette block (render/palette.h)
+  struct UniformBuffer palette;
   uint32_t width;
   uint32_t height;
+  // a shader reload in flight, compiled once every source has arrived
+  struct ShaderSource shader_sources[GRAPHICS_SHADER_SOURCES];
+  uint32_t shader_reads_pending;
+  bool shader_read_failed;
+  // bumped whenever reloaded programs replace the old ones, uniforms that
+  // were set once have to be set again
+  uint32_t shader_generation;
 };
 
-bool graphics_context_new(struct GraphicsContext *graphics);
+struct GraphicsConfig graphics_config_default(void);
+bool graphics_context_new(struct GraphicsContext *graphics,
+                          struct GraphicsConfig const *config);
+void graphics_context_free(struct GraphicsContext *graphics);
+
+// reads the shader sources again on io's threads while frames keep rendering
+// with the current programs. they are swapped in from file_io_poll once
+// everything compiled, a failed reload keeps the old ones. returns false if
+// a reload is already in flight or nothing could be queued.
+bool graphics_context_reload_shaders(struct GraphicsContext *graphics,
+                                     struct FileIo *io);
+
+// swaps the window, or when headless waits for the GPU to finish the frame so
+// timings include its work.
+void graphics_context_present(struct GraphicsContext const *graphics);
+
+// reads the last frame as RGBA8, top row first. pixels must hold
+// width * height * 4 bytes.
+void graphics_context_read_pixels(struct GraphicsContext const *graphics,
+                                  uint8_t *pixels);
 
 #define CUBE_TRIGANGLE_COUNT 12 * 3
 
@@ -0,0 +1,13 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include "voxel/grid.h"
+
+// uniform block binding point of the Palette block, GRID_MAX_COLORS
+// GridMaterial entries that every voxel and prop program indexes with the
+// palette index its geometry carries.
+#define PALETTE_BINDING 1
+#define PALETTE_BLOCK "Palette"
+#define PALETTE_SIZE (GRID_MAX_COLORS * sizeof(struct GridMaterial))
+
+#endif
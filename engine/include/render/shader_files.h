@@ -5,6 +5,8 @@
 
 #define BASIC_VS_PATH "assets/shaders/basic.webgl.vert"
 #define BASIC_FS_PATH "assets/shaders/basic.webgl.frag"
+#define BASIC_INSTANCED_VS_PATH "assets/shaders/basic_instanced.webgl.vert"
+#define VOXEL_PULL_VS_PATH "assets/shaders/voxel_pull.webgl.vert"
 #define LINE_VS_PATH "assets/shaders/line.webgl.vert"
 #define LINE_FS_PATH "assets/shaders/line.webgl.frag"
 
@@ -12,6 +14,8 @@
 
 #define BASIC_VS_PATH "assets/shaders/basic.gl.vert"
 #define BASIC_FS_PATH "assets/shaders/basic.gl.frag"
+#define BASIC_INSTANCED_VS_PATH "assets/shaders/basic_instanced.gl.vert"
+#define VOXEL_PULL_VS_PATH "assets/shaders/voxel_pull.gl.vert"
 #define LINE_VS_PATH "assets/shaders/line.gl.vert"
 #define LINE_FS_PATH "assets/shaders/line.gl.frag"
 
@@ -0,0 +1,78 @@
+#ifndef VOXEL_RENDERER_H
+#define VOXEL_RENDERER_H
+
+#include "render/gfx_api.h"
+#include "voxel/grid.h"
+#include "voxel/mesh_queue.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct Grid;
+struct JobSystem;
+struct Matrix4;
+
+// bytes of vertex data uploaded per voxel_renderer_update, at least one chunk
+// always goes through. the rest waits for the next frame.
+#define VOXEL_UPLOAD_BUDGET (1u << 20)
+// more quads than any chunk can have, every voxel face can't be exposed at
+// once. keeps the shared indices 16 bit.
+#define VOXEL_MAX_CHUNK_QUADS (GRID_CHUNK_VOLUME * 4)
+
+// texture unit the face words are bound to on the vertex pulling path.
+#define VOXEL_FACES_TEXTURE_UNIT 0
+
+// gpu side geometry of one grid chunk. a zero vao, or texture when pulling,
+// means no geometry yet.
+struct ChunkMesh {
+  struct Mesh mesh;
+  struct DataTexture faces;
+  uint32_t vertex_count;
+};
+
+// draws a grid as one greedy mesh per chunk, remeshing only the chunks the
+// grid has marked dirty. MESH_FORMAT_PACKED chunks are vertex buffers of 8
+// byte MeshVertex, MESH_FORMAT_FACES chunks are a data texture of two 32
+// bit face words (8 bytes) per quad that the voxel_pull shader expands
+// without any vertex attributes. meshing runs on the job system, the GL
+// uploads stay on the thread that owns the context.
+struct VoxelRenderer {
+  enum MeshFormat format;
+  struct ChunkMesh *chunks;
+  uint32_t chunk_count;
+  // every chunk draws its quads through this
+  struct QuadIndexBuffer quad_indices;
+  // vertex pulling draws from this vao, it only holds the quad indices
+  struct Mesh pull_mesh;
+  struct MeshQueue queue;
+  // chunks uploaded by the last call to voxel_renderer_update, their size
+  // and the time spent in the GL calls uploading them
+  uint32_t chunks_remeshed;
+  size_t bytes_uploaded;
+  uint64_t upload_ns;
+  // vertex data or face words of every chunk currently on the GPU
+  size_t vertex_bytes;
+  // chunks with geometry tested against the frustum, and how many of those
+  // were skipped, by the last call to voxel_renderer_draw
+  uint32_t chunks_tested;
+  uint32_t chunks_culled;
+};
+
+// format is MESH_FORMAT_PACKED or MESH_FORMAT_FACES. the renderer must stay
+// at the same address while meshes are in flight.
+struct VoxelRenderer voxel_renderer_new(struct Grid const *grid,
+                                        struct JobSystem *jobs,
+                                        enum MeshFormat format);
+void voxel_renderer_free(struct VoxelRenderer *renderer);
+// queues dirty chunks for meshing, clearing their dirty flags, and uploads
+// finished meshes within VOXEL_UPLOAD_BUDGET. never waits on a worker.
+void voxel_renderer_update(struct VoxelRenderer *renderer, struct Grid *grid);
+// expects the basic lighting shader to be bound, or voxel_pull for
+// MESH_FORMAT_FACES. model_uniform is its model matrix which is set per
+// chunk. chunks outside the view_proj frustum are skipped.
+void voxel_renderer_draw(struct VoxelRenderer *renderer,
+                         struct Grid const *grid,
+                         struct Matrix4 const *view_proj,
+                         uint32_t model_uniform);
+
+#endif
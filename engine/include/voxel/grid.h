@@ -3,9 +3,13 @@
 
 #include "math/vector4.h"
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
-#define GRID_MAX_COLORS 16
+// voxel values index the palette. the API passes them as char, values
+// above 127 are negative there but keep their bits, read them as uint8_t.
+#define GRID_MAX_COLORS 256
 
 #define GRID_EMPTY 0
 #define GRID_BEIGE 1
@@ -19,19 +23,130 @@
 #define GRID_ORANGE 9
 #define GRID_RED 10
 
+// the grid is stored as cubic chunks, chunks that are all air are not
+// allocated.
+#define GRID_CHUNK_SHIFT 4
+#define GRID_CHUNK_SIZE (1 << GRID_CHUNK_SHIFT)
+#define GRID_CHUNK_MASK (GRID_CHUNK_SIZE - 1)
+#define GRID_CHUNK_VOLUME (GRID_CHUNK_SIZE * GRID_CHUNK_SIZE * GRID_CHUNK_SIZE)
+
+// how chunk voxels are stored, picked per grid at creation.
+enum GridStorage {
+  // one char per voxel, fastest access
+  GRID_STORAGE_DENSE,
+  // indices into a per chunk palette packed at 1, 2, 4 or 8 bits per voxel,
+  // the width grows as the chunk sees more distinct values
+  GRID_STORAGE_PACKED
+};
+
+struct GridChunk {
+  uint32_t solid_count;
+  // GRID_STORAGE_DENSE
+  char *voxels;
+  // voxels belong to someone else, e.g. a mapped level file
+  bool borrowed;
+  // GRID_STORAGE_PACKED, the palette has room for 1 << bits entries
+  uint32_t *words;
+  uint8_t bits;
+  uint16_t palette_size;
+  char *palette;
+};
+
+// one palette entry, laid out like the std140 Material struct of the Palette
+// uniform block (render/palette.h) so the palette uploads as it is.
+struct GridMaterial {
+  struct Vector4 color;
+  // light the surface gives off, in multiples of its color
+  float emissive;
+  // 1 is fully diffuse, lower values add a highlight from the point light
+  float roughness;
+  float reserved[2];
+};
+
+struct GridRayHit {
+  uint32_t x;
+  uint32_t y;
+  uint32_t z;
+  // normal of the face the ray entered through, zero if it started inside
+  struct Vector4 normal;
+  // world space distance from the ray origin
+  float distance;
+};
+
 struct Grid {
   struct Vector4 origin;
   uint32_t size_x;
   uint32_t size_y;
   uint32_t size_z;
-  char *data;
-  struct Vector4 color_palette[GRID_MAX_COLORS];
+  uint32_t chunks_x;
+  uint32_t chunks_y;
+  uint32_t chunks_z;
+  enum GridStorage storage;
+  // chunk directory indexed by grid_chunk_index, NULL chunks are all air.
+  struct GridChunk **chunks;
+  // set whenever an edit changes the geometry of a chunk.
+  uint8_t *chunk_dirty;
+  struct GridMaterial palette[GRID_MAX_COLORS];
+  // palette entries [begin, end) changed since the last
+  // grid_palette_clear_dirty, everything for a new grid
+  uint32_t palette_dirty_begin;
+  uint32_t palette_dirty_end;
 };
 
+// dense storage
 struct Grid grid_new(uint32_t x, uint32_t y, uint32_t z, struct Vector4 origin);
+struct Grid grid_new_with_storage(uint32_t x, uint32_t y, uint32_t z,
+                                  struct Vector4 origin,
+                                  enum GridStorage storage);
 void grid_free(struct Grid *grid);
 char grid_get(struct Grid const *grid, uint32_t x, uint32_t y, uint32_t z);
+// marks the chunk holding the voxel dirty, and any neighbouring chunk that
+// holds one of its 26 neighbours, since their faces and ambient occlusion
+// can depend on it. an edit deep inside a chunk remeshes only that chunk.
 void grid_set(struct Grid *grid, uint32_t x, uint32_t y, uint32_t z,
               char value);
 
+// walks the voxels along a world space ray (Amanatides & Woo DDA) and
+// reports the first solid one within max_distance. direction does not need to
+// be normalized.
+bool grid_raycast(struct Grid const *grid, struct Vector4 origin,
+                  struct Vector4 direction, float max_distance,
+                  struct GridRayHit *hit);
+// casts count rays, hit_mask[i] says whether hits[i] is valid. returns the
+// number of rays that hit.
+uint32_t grid_raycast_batch(struct Grid const *grid,
+                            struct Vector4 const *origins,
+                            struct Vector4 const *directions, uint32_t count,
+                            float max_distance, struct GridRayHit *hits,
+                            bool *hit_mask);
+
+uint32_t grid_chunk_count(struct Grid const *grid);
+uint32_t grid_chunk_index(struct Grid const *grid, uint32_t cx, uint32_t cy,
+                          uint32_t cz);
+// inverse of grid_chunk_index.
+void grid_chunk_coords(struct Grid const *grid, uint32_t index, uint32_t *cx,
+                       uint32_t *cy, uint32_t *cz);
+bool grid_chunk_is_dirty(struct Grid const *grid, uint32_t index);
+void grid_chunk_clear_dirty(struct Grid *grid, uint32_t index);
+void grid_mark_all_dirty(struct Grid *grid);
+
+// changes a palette entry. no chunk is marked dirty, geometry only carries
+// the index.
+void grid_set_material(struct Grid *grid, uint8_t index,
+                       struct GridMaterial const *material);
+void grid_palette_clear_dirty(struct Grid *grid);
+
+// copies the GRID_CHUNK_VOLUME voxels of a chunk out in local index order
+// (x fastest, then y, then z), all air for an unallocated chunk.
+void grid_chunk_read(struct Grid const *grid, uint32_t index, char *out);
+// hands a chunk's GRID_CHUNK_VOLUME voxels to a dense grid, replacing what was
+// there. borrowed voxels are never freed by the grid and have to outlive it.
+// solid_count must match the data. only this chunk is marked dirty, not its
+// neighbours. returns false for a packed grid or a failed allocation.
+bool grid_chunk_attach(struct Grid *grid, uint32_t index, char *voxels,
+                       uint32_t solid_count, bool borrowed);
+
+// bytes of voxel storage currently allocated, including the chunk directory.
+size_t grid_memory_usage(struct Grid const *grid);
+
 #endif
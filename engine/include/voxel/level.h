@@ -0,0 +1,58 @@
+#ifndef LEVEL_H
+#define LEVEL_H
+
+#include "voxel/grid.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct FileMap;
+
+#define LEVEL_MAGIC "TJLV"
+#define LEVEL_VERSION 2
+// raw chunk payloads start on this boundary in the file
+#define LEVEL_ALIGNMENT 64
+
+enum LevelEncoding {
+  LEVEL_CHUNK_EMPTY,
+  // GRID_CHUNK_VOLUME voxels as they are, used in place when loading
+  LEVEL_CHUNK_RAW,
+  // lz_compress'd voxels
+  LEVEL_CHUNK_LZ
+};
+
+// file layout: the header, chunk_count entries, then the chunk payloads.
+// every field is little endian.
+struct LevelHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t size[3];
+  uint32_t chunk_count;
+  uint32_t flags;
+  float origin[4];
+  // color rgba, emissive, roughness, two reserved, as in GridMaterial
+  float palette[GRID_MAX_COLORS][8];
+};
+
+struct LevelChunk {
+  uint64_t offset;
+  uint32_t size;
+  uint32_t solid_count;
+  uint32_t encoding;
+  uint32_t reserved;
+};
+
+// with compress, chunks that shrink by a quarter or more are stored
+// compressed, the rest raw.
+bool level_save(struct Grid const *grid, char const *path, bool compress);
+
+// maps the file and builds a dense grid whose raw chunks point straight into
+// the mapping, only compressed chunks are decoded into new allocations. map
+// has to stay open until the grid is freed. every chunk starts out dirty.
+bool level_load(struct Grid *grid, struct FileMap *map, char const *path);
+// level_load for a file that is already in memory, e.g. read with file_io.
+// map stays the caller's either way, path is only used in messages.
+bool level_load_from(struct Grid *grid, struct FileMap const *map,
+                     char const *path);
+
+#endif
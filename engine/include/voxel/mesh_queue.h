@@ -0,0 +1,66 @@
+#ifndef MESH_QUEUE_H
+#define MESH_QUEUE_H
+
+#include "core/jobs.h"
+#include "voxel/mesher.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct Grid;
+struct MeshQueue;
+
+// chunks snapshotted and handed to the job system per dispatch
+#define MESH_QUEUE_DISPATCH_BUDGET 16
+// upper bound on chunks being meshed or waiting to be collected
+#define MESH_QUEUE_MAX_IN_FLIGHT 64
+
+// a finished chunk mesh, owned by the caller of mesh_queue_pop until it is
+// handed back with mesh_queue_release.
+struct MeshResult {
+  struct MeshResult *next;
+  uint32_t chunk_index;
+  struct MeshSnapshot snapshot;
+  struct MeshData data;
+  struct MeshQueue *queue;
+};
+
+// meshes dirty grid chunks on the job system. the owning thread snapshots
+// chunks (the grid is never read off that thread), workers mesh them and push
+// the results onto a lock-free list, and the owning thread collects them in
+// the order they finished. a chunk has at most one mesh in flight, an edit
+// while it is meshing leaves it dirty for the next dispatch.
+struct MeshQueue {
+  struct JobSystem *jobs;
+  enum MeshFormat format;
+  uint32_t chunk_count;
+  uint8_t *in_flight;
+  // pushed by the workers, newest first
+  struct MeshResult *completed;
+  // collected from completed, oldest first
+  struct MeshResult *ready;
+  struct JobCounter counter;
+  // where the next dispatch starts looking, so every dirty chunk gets a turn
+  uint32_t cursor;
+  uint32_t in_flight_count;
+  // chunks dispatched by the last mesh_queue_dispatch
+  uint32_t chunks_dispatched;
+};
+
+// chunks are meshed into format.
+bool mesh_queue_new(struct MeshQueue *queue, struct Grid const *grid,
+                    struct JobSystem *jobs, enum MeshFormat format);
+// waits for the jobs still running and drops every result.
+void mesh_queue_free(struct MeshQueue *queue);
+
+// snapshots up to max_chunks dirty chunks, clears their dirty flags and
+// queues them for meshing. without worker threads they are meshed before this
+// returns. returns the number of chunks dispatched.
+uint32_t mesh_queue_dispatch(struct MeshQueue *queue, struct Grid *grid,
+                             uint32_t max_chunks);
+
+// next finished mesh or NULL. does not block.
+struct MeshResult *mesh_queue_pop(struct MeshQueue *queue);
+void mesh_queue_release(struct MeshQueue *queue, struct MeshResult *result);
+
+#endif
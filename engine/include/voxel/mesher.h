@@ -0,0 +1,145 @@
+#ifndef MESHER_H
+#define MESHER_H
+
+#include "math/vector4.h"
+#include "voxel/grid.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum MeshFormat {
+  // 8 byte MeshVertex, what the voxel renderer draws. 4 vertices per quad,
+  // drawn with the shared 0 1 2, 2 3 0 index pattern (quad_index_buffer_new)
+  MESH_FORMAT_PACKED,
+  // interleaved floats: grid local position (3), normal (3), color (3). the
+  // original 36 byte format as a plain triangle list, kept for tools and
+  // comparisons. ambient occlusion is baked into the color
+  MESH_FORMAT_FLOAT,
+  // two 32 bit words per quad (see the MESH_FACE_WORD_* fields), expanded
+  // into 4 corners by the vertex pulling shader. chunk sized regions only
+  MESH_FORMAT_FACES
+};
+
+#define MESHER_VERTEX_FLOATS 9
+// packed positions are bytes, so a packed mesh can't span more than this
+#define MESHER_PACKED_MAX_SIZE 255
+// face word positions are 4 bits
+#define MESHER_FACES_MAX_SIZE 16
+
+// first MESH_FORMAT_FACES word, low bits first: the voxel the quad starts at
+// (4 bits per axis, region local), its MeshFace (3), width - 1 and height - 1
+// along the face's u = (axis + 1) % 3 and v = (axis + 2) % 3 axes (4 each),
+// the palette index (8) and the flip bit. the second word holds the ambient
+// occlusion of corners 0 to 3, 2 bits each. the shaders decode the same
+// layout.
+#define MESH_FACE_WORD_FACE_SHIFT 12
+#define MESH_FACE_WORD_WIDTH_SHIFT 15
+#define MESH_FACE_WORD_HEIGHT_SHIFT 19
+#define MESH_FACE_WORD_COLOR_SHIFT 23
+// set when the quad is split along its 1 3 diagonal, corner i is then drawn
+// as corner (i + 1) & 3
+#define MESH_FACE_WORD_FLIP_BIT (1u << 31)
+
+// ambient occlusion levels, 0 is a corner closed in by both sides and 3 an
+// open one.
+#define MESH_AO_SHIFT 3
+#define MESH_AO_MAX 3
+
+// face index in the packed vertex: axis * 2, plus one when facing -axis.
+enum MeshFace {
+  MESH_FACE_POS_X,
+  MESH_FACE_NEG_X,
+  MESH_FACE_POS_Y,
+  MESH_FACE_NEG_Y,
+  MESH_FACE_POS_Z,
+  MESH_FACE_NEG_Z
+};
+
+// corner position in voxels from the region's min corner, so the vertex is
+// at origin + region min + (x, y, z) - 0.5 in world space. face_ao holds the
+// MeshFace in its low 3 bits and the corner's ambient occlusion level above
+// them (MESH_AO_SHIFT). color is a palette index.
+struct MeshVertex {
+  uint8_t x;
+  uint8_t y;
+  uint8_t z;
+  uint8_t face_ao;
+  uint8_t color;
+  uint8_t reserved[3];
+};
+
+// CPU side vertex array produced by the mesher.
+struct MeshData {
+  enum MeshFormat format;
+  uint8_t *vertices;
+  // in bytes
+  size_t vertices_size;
+  size_t vertices_capacity;
+  // vertices drawn, 4 per quad for MESH_FORMAT_FACES
+  uint32_t vertex_count;
+};
+
+struct MeshData mesh_data_new(enum MeshFormat format);
+// 0 for MESH_FORMAT_FACES, which stores quads rather than vertices.
+size_t mesh_format_vertex_size(enum MeshFormat format);
+// bytes one quad takes.
+size_t mesh_format_quad_size(enum MeshFormat format);
+uint32_t mesh_data_triangle_count(struct MeshData const *data);
+void mesh_data_free(struct MeshData *data);
+// empties the array but keeps the allocation around for the next build.
+void mesh_data_clear(struct MeshData *data);
+
+// copy of a grid region with a one voxel border, everything the mesher needs
+// to run without touching the grid, e.g. on a worker thread while the grid is
+// being edited.
+struct MeshSnapshot {
+  uint8_t *data;
+  // padded size, the region plus the border
+  int32_t size[3];
+  // grid coordinates of the region
+  int32_t min[3];
+  // GRID_MAX_COLORS colors for MESH_FORMAT_FLOAT, NULL for the other formats
+  // which only carry the index
+  struct Vector4 *palette;
+};
+
+// snapshots the voxels in [min, max) for meshing into format, returns false
+// if allocation failed.
+bool mesher_snapshot_region(struct MeshSnapshot *snapshot,
+                            struct Grid const *grid, enum MeshFormat format,
+                            uint32_t min_x, uint32_t min_y, uint32_t min_z,
+                            uint32_t max_x, uint32_t max_y, uint32_t max_z);
+bool mesher_snapshot_chunk(struct MeshSnapshot *snapshot,
+                           struct Grid const *grid, enum MeshFormat format,
+                           uint32_t chunk_index);
+void mesher_snapshot_free(struct MeshSnapshot *snapshot);
+
+// greedy meshes a snapshot, see mesher_build_region. packed meshes of regions
+// over MESHER_PACKED_MAX_SIZE on a side, face words of regions over
+// MESHER_FACES_MAX_SIZE, and float meshes of snapshots taken for another
+// format are refused.
+void mesher_build_snapshot(struct MeshSnapshot const *snapshot,
+                           struct MeshData *out);
+
+// greedy meshes the voxels in [min, max) and appends triangles to out.
+// faces touching solid voxels (inside or outside the region) are culled and
+// coplanar faces of the same color and corner occlusion are merged into a
+// single quad. every corner gets the classic 3 neighbour ambient occlusion
+// and quads are split along the diagonal that keeps it from looking
+// anisotropic. the border voxels count, so the occlusion of a chunk depends
+// on the voxels around it (see grid_set). float
+// positions are grid local, so draw with a translation to grid->origin,
+// packed ones and face words start at the region's min corner (see
+// MeshVertex).
+void mesher_build_region(struct Grid const *grid, uint32_t min_x,
+                         uint32_t min_y, uint32_t min_z, uint32_t max_x,
+                         uint32_t max_y, uint32_t max_z, struct MeshData *out);
+
+// greedy meshes a single chunk of the grid, see grid_chunk_index.
+void mesher_build_chunk(struct Grid const *grid, uint32_t chunk_index,
+                        struct MeshData *out);
+
+// greedy meshes the whole grid.
+void mesher_build(struct Grid const *grid, struct MeshData *out);
+
+#endif
@@ -1,33 +1,55 @@
 #include "core/debug.h"
 
+#include "core/profiler.h"
+#include "math/matrix4.h"
 #include "platform/file.h"
+#include "render/colors.h"
+#include "render/frame_data.h"
 #include "render/gfx_api.h"
 #include "render/shader_files.h"
 
 #include "gl.h"
 
+#include <math.h>
 #include <stdio.h>
 
-struct Debug debug_new(void) {
-  size_t capacity = 128;
-  struct Line *lines = (struct Line *)calloc(capacity, sizeof(struct Line));
-  if (lines == NULL) {
-    printf("Failed to allocate buffer for lines\n");
-  }
+// lines per frame the stream starts out with, it doubles when a frame draws
+// more than that.
+#define DEBUG_STREAM_LINES 2048
 
-  uint32_t vao = 0;
-  uint32_t vb = 0;
-  glGenVertexArrays(1, (GLuint *)&vao);
-  glGenBuffers(1, (GLuint *)&vb);
+#define DEBUG_VERTEX_SIZE sizeof(struct LineVertex)
 
-  glBindVertexArray(vao);
-  glBindBuffer(GL_ARRAY_BUFFER, vb);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(struct Vector4),
-                        (void *)0);
+static void debug_bind_layout(uint32_t vao, uint32_t buffer) {
+  gfx_bind_vertex_array(vao);
+  gfx_bind_array_buffer(buffer);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, DEBUG_VERTEX_SIZE, (void *)0);
   glEnableVertexAttribArray(0);
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(struct Vector4),
-                        (void *)(sizeof(struct Vector4)));
+  glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, DEBUG_VERTEX_SIZE,
+                        (void *)(3 * sizeof(float)));
   glEnableVertexAttribArray(1);
+}
+
+static struct LineVertex line_vertex(struct Vector4 p, uint32_t color) {
+  return (struct LineVertex){p.x, p.y, p.z, color};
+}
+
+static struct Line line_new(struct Vector4 a, struct Vector4 b,
+                            uint32_t color) {
+  return (struct Line){line_vertex(a, color), line_vertex(b, color)};
+}
+
+struct Debug debug_new(void) {
+  uint32_t vao = 0;
+  glGenVertexArrays(1, (GLuint *)&vao);
+  struct StreamBuffer stream =
+      stream_buffer_new(DEBUG_STREAM_LINES * sizeof(struct Line));
+  debug_bind_layout(vao, stream.buffer);
+
+  uint32_t static_vao = 0;
+  uint32_t static_vb = 0;
+  glGenVertexArrays(1, (GLuint *)&static_vao);
+  glGenBuffers(1, (GLuint *)&static_vb);
+  debug_bind_layout(static_vao, static_vb);
 
   struct File vs, fs;
   if (!file_read_all(&vs, LINE_VS_PATH) || !file_read_all(&fs, LINE_FS_PATH)) {
@@ -40,88 +62,353 @@ struct Debug debug_new(void) {
     exit(1);
   }
 
-  shader_bind(&lines_shader);
-  uint32_t lines_shader_view_proj =
-      shader_get_uniform(&lines_shader, "view_proj");
+  shader_bind_uniform_block(&lines_shader, FRAME_DATA_BLOCK,
+                            FRAME_DATA_BINDING);
 
-  return (struct Debug){.lines = lines,
-                        .lines_capacity = capacity,
-                        .lines_size = 0,
-                        .lines_vao = vao,
-                        .lines_vb = vb,
-                        .lines_shader = lines_shader,
-                        .lines_shader_view_proj = lines_shader_view_proj};
+  // target stays NULL (the per frame lines), a pointer into this struct
+  // would dangle once it is returned by value
+  return (struct Debug){.lines_vao = vao,
+                        .lines_stream = stream,
+                        .static_vao = static_vao,
+                        .static_vb = static_vb,
+                        .lines_shader = lines_shader};
 }
 
 void debug_free(struct Debug *debug) {
-  free(debug->lines);
-  glDeleteBuffers(1, &debug->lines_vb);
-  glDeleteVertexArrays(1, &debug->lines_vao);
+  free(debug->frame.lines);
+  free(debug->persistent.lines);
+  stream_buffer_free(&debug->lines_stream);
+  gfx_delete_vertex_array(debug->lines_vao);
+  gfx_delete_buffer(debug->static_vb);
+  gfx_delete_vertex_array(debug->static_vao);
   shader_free(&debug->lines_shader);
   *debug = (struct Debug){0};
 }
 
-void debug_add_line(struct Debug *debug, struct Vector4 a, struct Vector4 b,
-                    struct Vector4 color) {
-  if (debug->lines_size >= debug->lines_capacity) {
-    size_t new_capacity = debug->lines_capacity * 2;
-    debug->lines = (struct Line *)realloc(debug->lines,
-                                          new_capacity * sizeof(struct Line));
-    if (debug->lines == NULL) {
+uint32_t debug_pack_color(struct Vector4 color) {
+  float c[4] = {color.x, color.y, color.z, 1.f};
+  uint32_t packed = 0;
+  for (int i = 0; i < 4; ++i) {
+    float v = c[i] < 0.f ? 0.f : (c[i] > 1.f ? 1.f : c[i]);
+    packed |= (uint32_t)(v * 255.f + 0.5f) << (8 * i);
+  }
+  return packed;
+}
+
+struct Line *debug_reserve_lines(struct Debug *debug, size_t count) {
+  if (debug->target == NULL) {
+    debug->target = &debug->frame;
+  }
+  struct DebugLines *target = debug->target;
+
+  if (target->lines_size + count > target->lines_capacity) {
+    size_t new_capacity =
+        target->lines_capacity ? target->lines_capacity * 2 : 128;
+    while (new_capacity < target->lines_size + count) {
+      new_capacity *= 2;
+    }
+    struct Line *lines = (struct Line *)realloc(
+        target->lines, new_capacity * sizeof(struct Line));
+    if (lines == NULL) {
       printf("Failed to resize Debug lines\n");
-      return;
+      return NULL;
     }
-    debug->lines_capacity = new_capacity;
+    target->lines = lines;
+    target->lines_capacity = new_capacity;
   }
 
-  debug->lines[debug->lines_size++] =
-      (struct Line){.a = a, .b = b, .color_a = color, .color_b = color};
+  struct Line *lines = target->lines + target->lines_size;
+  target->lines_size += count;
+  return lines;
 }
 
-void debug_update(struct Debug *debug, struct Matrix4 const *view_proj) {
-  if (debug->lines_size == 0)
+void debug_begin_static(struct Debug *debug) {
+  debug->target = &debug->persistent;
+}
+
+void debug_end_static(struct Debug *debug) {
+  debug->target = &debug->frame;
+
+  gfx_bind_array_buffer(debug->static_vb);
+  glBufferData(GL_ARRAY_BUFFER,
+               debug->persistent.lines_size * sizeof(struct Line),
+               debug->persistent.lines, GL_STATIC_DRAW);
+  debug->static_vertex_count = (uint32_t)debug->persistent.lines_size * 2;
+}
+
+void debug_clear_static(struct Debug *debug) {
+  debug->persistent.lines_size = 0;
+  debug->static_vertex_count = 0;
+}
+
+void debug_update(struct Debug *debug) {
+  size_t count = debug->frame.lines_size;
+  if (count == 0 && debug->static_vertex_count == 0)
     return;
 
-  glBindVertexArray(debug->lines_vao);
-  glBufferData(GL_ARRAY_BUFFER, debug->lines_size * sizeof(struct Line),
-               debug->lines, GL_STATIC_DRAW);
   shader_bind(&debug->lines_shader);
-  shader_set_matrix_uniform(debug->lines_shader_view_proj, view_proj);
+  if (debug->static_vertex_count > 0) {
+    gfx_bind_vertex_array(debug->static_vao);
+    glDrawArrays(GL_LINES, 0, debug->static_vertex_count);
+  }
+  if (count == 0)
+    return;
+
+  size_t size = count * sizeof(struct Line);
+  if (size > debug->lines_stream.frame_size) {
+    size_t frame_size = debug->lines_stream.frame_size;
+    while (frame_size < size) {
+      frame_size *= 2;
+    }
+    stream_buffer_free(&debug->lines_stream);
+    debug->lines_stream = stream_buffer_new(frame_size);
+    debug_bind_layout(debug->lines_vao, debug->lines_stream.buffer);
+  }
 
-  glDrawArrays(GL_LINES, 0, debug->lines_size * 2);
+  size_t offset = 0;
+  if (stream_buffer_write(&debug->lines_stream, debug->frame.lines, size,
+                          DEBUG_VERTEX_SIZE, &offset)) {
+    gfx_bind_vertex_array(debug->lines_vao);
+    glDrawArrays(GL_LINES, offset / DEBUG_VERTEX_SIZE, count * 2);
+    stream_buffer_end_frame(&debug->lines_stream);
+  }
 
-  debug->lines_size = 0;
+  debug->frame.lines_size = 0;
+}
+
+void debug_add_line(struct Debug *debug, struct Vector4 a, struct Vector4 b,
+                    struct Vector4 color) {
+  struct Line *line = debug_reserve_lines(debug, 1);
+  if (line == NULL)
+    return;
+  *line = line_new(a, b, debug_pack_color(color));
+}
+
+// the 12 edges of a box given its corners, corner i has bit 0 set for +x,
+// bit 1 for +y and bit 2 for +z.
+static void debug_add_box_corners(struct Debug *debug,
+                                  struct Vector4 const corners[8],
+                                  uint32_t color) {
+  struct Line *line = debug_reserve_lines(debug, 12);
+  if (line == NULL)
+    return;
+
+  for (int i = 0; i < 8; ++i) {
+    for (int bit = 1; bit < 8; bit <<= 1) {
+      if ((i & bit) == 0) {
+        *line++ = line_new(corners[i], corners[i | bit], color);
+      }
+    }
+  }
 }
 
 void debug_add_aabb(struct Debug *debug, struct Vector4 center,
                     struct Vector4 extents, struct Vector4 color) {
-  struct Vector4 a = Vector4_new_point(
-      center.x + extents.x, center.y + extents.y, center.z + extents.z);
-  struct Vector4 b = Vector4_new_point(
-      center.x + extents.x, center.y + extents.y, center.z - extents.z);
-  struct Vector4 c = Vector4_new_point(
-      center.x + extents.x, center.y - extents.y, center.z + extents.z);
-  struct Vector4 d = Vector4_new_point(
-      center.x + extents.x, center.y - extents.y, center.z - extents.z);
-  struct Vector4 e = Vector4_new_point(
-      center.x - extents.x, center.y + extents.y, center.z + extents.z);
-  struct Vector4 f = Vector4_new_point(
-      center.x - extents.x, center.y + extents.y, center.z - extents.z);
-  struct Vector4 g = Vector4_new_point(
-      center.x - extents.x, center.y - extents.y, center.z + extents.z);
-  struct Vector4 h = Vector4_new_point(
-      center.x - extents.x, center.y - extents.y, center.z - extents.z);
-
-  debug_add_line(debug, a, b, color);
-  debug_add_line(debug, a, c, color);
-  debug_add_line(debug, c, d, color);
-  debug_add_line(debug, d, b, color);
-  debug_add_line(debug, a, e, color);
-  debug_add_line(debug, f, b, color);
-  debug_add_line(debug, h, d, color);
-  debug_add_line(debug, e, f, color);
-  debug_add_line(debug, e, g, color);
-  debug_add_line(debug, g, h, color);
-  debug_add_line(debug, h, f, color);
-  debug_add_line(debug, g, c, color);
+  struct Vector4 corners[8];
+  for (int i = 0; i < 8; ++i) {
+    corners[i] = Vector4_new_point(
+        center.x + ((i & 1) ? extents.x : -extents.x),
+        center.y + ((i & 2) ? extents.y : -extents.y),
+        center.z + ((i & 4) ? extents.z : -extents.z));
+  }
+  debug_add_box_corners(debug, corners, debug_pack_color(color));
+}
+
+void debug_add_sphere(struct Debug *debug, struct Vector4 center, float radius,
+                      uint32_t segments, struct Vector4 color) {
+  if (segments < 3)
+    segments = 3;
+  struct Line *line = debug_reserve_lines(debug, 3 * segments);
+  if (line == NULL)
+    return;
+
+  uint32_t packed = debug_pack_color(color);
+  float step = 6.2831853f / segments;
+  for (int axis = 0; axis < 3; ++axis) {
+    struct Vector4 prev = center;
+    for (uint32_t i = 0; i <= segments; ++i) {
+      float s = sinf(i * step) * radius;
+      float c = cosf(i * step) * radius;
+      struct Vector4 p = center;
+      if (axis == 0) {
+        p.y += c;
+        p.z += s;
+      } else if (axis == 1) {
+        p.x += c;
+        p.z += s;
+      } else {
+        p.x += c;
+        p.y += s;
+      }
+      if (i > 0) {
+        *line++ = line_new(prev, p, packed);
+      }
+      prev = p;
+    }
+  }
+}
+
+void debug_add_frustum(struct Debug *debug, struct Matrix4 const *inverse_vp,
+                       struct Vector4 color) {
+  struct Vector4 corners[8];
+  for (int i = 0; i < 8; ++i) {
+    corners[i] = Vector4_new_point((i & 1) ? 1.f : -1.f, (i & 2) ? 1.f : -1.f,
+                                   (i & 4) ? 1.f : -1.f);
+  }
+  Matrix4_project_array(inverse_vp, corners, corners, 8);
+  debug_add_box_corners(debug, corners, debug_pack_color(color));
+}
+
+void debug_add_grid(struct Debug *debug, struct Vector4 center, uint32_t cells,
+                    float spacing, struct Vector4 color) {
+  struct Line *line = debug_reserve_lines(debug, 2 * (cells + 1));
+  if (line == NULL)
+    return;
+
+  uint32_t packed = debug_pack_color(color);
+  float half = cells * spacing * 0.5f;
+  for (uint32_t i = 0; i <= cells; ++i) {
+    float offset = i * spacing - half;
+    *line++ = line_new(
+        Vector4_new_point(center.x + offset, center.y, center.z - half),
+        Vector4_new_point(center.x + offset, center.y, center.z + half),
+        packed);
+    *line++ = line_new(
+        Vector4_new_point(center.x - half, center.y, center.z + offset),
+        Vector4_new_point(center.x + half, center.y, center.z + offset),
+        packed);
+  }
+}
+
+void debug_add_arrow(struct Debug *debug, struct Vector4 from,
+                     struct Vector4 to, struct Vector4 color) {
+  struct Vector4 dir = Vector4_subtract(to, from);
+  dir.w = 0.f;
+  float length = Vector4_magnitude(dir);
+  if (length == 0.f)
+    return;
+  struct Line *line = debug_reserve_lines(debug, 5);
+  if (line == NULL)
+    return;
+
+  // two directions perpendicular to the shaft for the head
+  dir = Vector4_scale(dir, 1.f / length);
+  struct Vector4 up = fabsf(dir.y) < 0.99f ? Vector4_new_vector(0.f, 1.f, 0.f)
+                                          : Vector4_new_vector(1.f, 0.f, 0.f);
+  struct Vector4 side = Vector4_normalized(Vector4_cross(dir, up));
+  struct Vector4 side2 = Vector4_cross(dir, side);
+
+  float head = length * 0.2f;
+  struct Vector4 base = Vector4_subtract(to, Vector4_scale(dir, head));
+  side = Vector4_scale(side, head * 0.5f);
+  side2 = Vector4_scale(side2, head * 0.5f);
+
+  uint32_t packed = debug_pack_color(color);
+  *line++ = line_new(from, to, packed);
+  *line++ = line_new(to, Vector4_add(base, side), packed);
+  *line++ = line_new(to, Vector4_subtract(base, side), packed);
+  *line++ = line_new(to, Vector4_add(base, side2), packed);
+  *line++ = line_new(to, Vector4_subtract(base, side2), packed);
+}
+
+// overlay layout in NDC
+#define PROFILER_OVERLAY_LEFT -0.95f
+#define PROFILER_OVERLAY_WIDTH 0.6f
+#define PROFILER_OVERLAY_BOTTOM -0.95f
+#define PROFILER_GRAPH_HEIGHT 0.3f
+#define PROFILER_GRAPH_MS 50.f
+#define PROFILER_BAR_HEIGHT 0.025f
+#define PROFILER_BAR_COUNT 8
+// a full width bar is one 60 Hz frame
+#define PROFILER_BAR_MS 16.6f
+// just past the near plane so the overlay is rarely hidden by the scene
+#define PROFILER_OVERLAY_DEPTH -0.99f
+#define PROFILER_OVERLAY_LINES                                                 \
+  (PROFILER_HISTORY - 1 + 4 + 2 + PROFILER_BAR_COUNT * 4)
+
+struct OverlayLines {
+  struct Vector4 points[2 * PROFILER_OVERLAY_LINES];
+  uint32_t colors[PROFILER_OVERLAY_LINES];
+  uint32_t count;
+};
+
+static void overlay_line(struct OverlayLines *lines, float x0, float y0,
+                         float x1, float y1, uint32_t color) {
+  uint32_t i = lines->count++;
+  lines->points[2 * i] = Vector4_new_point(x0, y0, PROFILER_OVERLAY_DEPTH);
+  lines->points[2 * i + 1] = Vector4_new_point(x1, y1, PROFILER_OVERLAY_DEPTH);
+  lines->colors[i] = color;
+}
+
+static void overlay_rect(struct OverlayLines *lines, float x0, float y0,
+                         float x1, float y1, uint32_t color) {
+  overlay_line(lines, x0, y0, x1, y0, color);
+  overlay_line(lines, x1, y0, x1, y1, color);
+  overlay_line(lines, x1, y1, x0, y1, color);
+  overlay_line(lines, x0, y1, x0, y0, color);
+}
+
+void debug_add_profiler(struct Debug *debug, struct Matrix4 const *inverse_vp) {
+  struct ProfilerFrame const *frame = profiler_last_frame();
+  if (frame == NULL)
+    return;
+
+  struct OverlayLines lines;
+  lines.count = 0;
+  float left = PROFILER_OVERLAY_LEFT;
+  float right = left + PROFILER_OVERLAY_WIDTH;
+  float bottom = PROFILER_OVERLAY_BOTTOM;
+  float top = bottom + PROFILER_GRAPH_HEIGHT;
+
+  uint32_t frame_color = debug_pack_color(GREEN_BRIGHT);
+  uint32_t slow_color = debug_pack_color(ORANGE);
+  uint32_t dropped_color = debug_pack_color(RED);
+  overlay_rect(&lines, left, bottom, right, top, debug_pack_color(GREEN));
+  float marks[2] = {1000.f / 60.f, 1000.f / 30.f};
+  for (int i = 0; i < 2; ++i) {
+    float y = bottom + marks[i] / PROFILER_GRAPH_MS * PROFILER_GRAPH_HEIGHT;
+    overlay_line(&lines, left, y, right, y, debug_pack_color(GREEN_DARK));
+  }
+
+  float history[PROFILER_HISTORY];
+  profiler_history(history);
+  float step = PROFILER_OVERLAY_WIDTH / (PROFILER_HISTORY - 1);
+  for (uint32_t i = 0; i + 1 < PROFILER_HISTORY; ++i) {
+    float y0 = history[i] < PROFILER_GRAPH_MS ? history[i] : PROFILER_GRAPH_MS;
+    float y1 = history[i + 1] < PROFILER_GRAPH_MS ? history[i + 1]
+                                                  : PROFILER_GRAPH_MS;
+    uint32_t color = frame_color;
+    if (history[i + 1] > marks[1])
+      color = dropped_color;
+    else if (history[i + 1] > marks[0])
+      color = slow_color;
+    overlay_line(&lines, left + i * step,
+                 bottom + y0 / PROFILER_GRAPH_MS * PROFILER_GRAPH_HEIGHT,
+                 left + (i + 1) * step,
+                 bottom + y1 / PROFILER_GRAPH_MS * PROFILER_GRAPH_HEIGHT,
+                 color);
+  }
+
+  struct Vector4 const bar_colors[PROFILER_BAR_COUNT] = {
+      ORANGE, GREEN_BRIGHT, TAN, MAUVE, GREEN_LIGHT, RED, BEIGE, BEIGE_R};
+  float y = top + PROFILER_BAR_HEIGHT;
+  for (uint32_t i = 0; i < frame->zone_count && i < PROFILER_BAR_COUNT; ++i) {
+    float ms = frame->zones[i].total_ns / 1e6f;
+    float width = ms / PROFILER_BAR_MS * PROFILER_OVERLAY_WIDTH;
+    if (width > PROFILER_OVERLAY_WIDTH)
+      width = PROFILER_OVERLAY_WIDTH;
+    overlay_rect(&lines, left, y, left + width, y + PROFILER_BAR_HEIGHT,
+                 debug_pack_color(bar_colors[i]));
+    y += 2.f * PROFILER_BAR_HEIGHT;
+  }
+
+  struct Line *line = debug_reserve_lines(debug, lines.count);
+  if (line == NULL)
+    return;
+  Matrix4_project_array(inverse_vp, lines.points, lines.points,
+                        2 * lines.count);
+  for (uint32_t i = 0; i < lines.count; ++i) {
+    line[i] = line_new(lines.points[2 * i], lines.points[2 * i + 1],
+                       lines.colors[i]);
+  }
 }
@@ -44,6 +44,10 @@ enum Keycode input_translate_sdlkey(uint32_t key) {
     return KEYCODE_A;
   case SDLK_d:
     return KEYCODE_D;
+  case SDLK_p:
+    return KEYCODE_P;
+  case SDLK_r:
+    return KEYCODE_R;
   case SDLK_s:
     return KEYCODE_S;
   case SDLK_w:
@@ -0,0 +1,335 @@
+// sysconf and sched_yield under -std=c99
+#define _POSIX_C_SOURCE 200809L
+#define _DARWIN_C_SOURCE
+
+#include "core/jobs.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if JOBS_THREADS
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+#define JOBS_DEQUE_MASK (JOBS_DEQUE_SIZE - 1)
+// upper bound on the batches a parallel_for is split into
+#define JOBS_MAX_BATCHES 256
+
+// Chase-Lev deque with the memory orders from "Correct and Efficient
+// Work-Stealing for Weak Memory Models" (Le et al. 2013). only the owner
+// pushes and pops at the bottom, anyone steals from the top. it never grows,
+// a full deque makes the caller run the job itself.
+struct JobDeque {
+  int64_t top;
+  // keep the owner's end on its own cache line
+  char pad[56];
+  int64_t bottom;
+  struct Job jobs[JOBS_DEQUE_SIZE];
+};
+
+#if JOBS_THREADS
+struct JobWorker {
+  struct JobSystem *js;
+  uint32_t index;
+  pthread_t thread;
+};
+
+struct JobWorkers {
+  struct JobWorker workers[JOBS_MAX_WORKERS];
+  pthread_mutex_t mutex;
+  pthread_cond_t wake;
+  int32_t sleeping;
+  uint32_t thread_count;
+};
+#endif
+
+// deque index of the current thread. the owning thread is 0.
+static __thread uint32_t t_worker_index;
+
+// slots are read by thieves that may lose the race for them, so every field
+// goes through relaxed atomics to keep those reads well defined.
+static void deque_slot_store(struct Job *slot, struct Job const *job) {
+  __atomic_store_n(&slot->func, job->func, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->data, job->data, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->counter, job->counter, __ATOMIC_RELAXED);
+}
+
+static void deque_slot_load(struct Job const *slot, struct Job *job) {
+  job->func = __atomic_load_n(&slot->func, __ATOMIC_RELAXED);
+  job->data = __atomic_load_n(&slot->data, __ATOMIC_RELAXED);
+  job->counter = __atomic_load_n(&slot->counter, __ATOMIC_RELAXED);
+}
+
+static bool deque_push(struct JobDeque *d, struct Job const *job) {
+  int64_t b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED);
+  int64_t t = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+  if (b - t >= JOBS_DEQUE_SIZE)
+    return false;
+
+  deque_slot_store(&d->jobs[b & JOBS_DEQUE_MASK], job);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+  return true;
+}
+
+static bool deque_pop(struct JobDeque *d, struct Job *job) {
+  int64_t b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED) - 1;
+  __atomic_store_n(&d->bottom, b, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  int64_t t = __atomic_load_n(&d->top, __ATOMIC_RELAXED);
+
+  if (t > b) {
+    // empty
+    __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+    return false;
+  }
+
+  deque_slot_load(&d->jobs[b & JOBS_DEQUE_MASK], job);
+  if (t == b) {
+    // last job, race the thieves for it
+    bool won = __atomic_compare_exchange_n(&d->top, &t, t + 1, false,
+                                           __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+    __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+    return won;
+  }
+  return true;
+}
+
+static bool deque_steal(struct JobDeque *d, struct Job *job) {
+  int64_t t = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  int64_t b = __atomic_load_n(&d->bottom, __ATOMIC_ACQUIRE);
+  if (t >= b)
+    return false;
+
+  // the slot can't be reused until top moves past it, so a failed exchange
+  // just throws away what was read
+  deque_slot_load(&d->jobs[t & JOBS_DEQUE_MASK], job);
+  return __atomic_compare_exchange_n(&d->top, &t, t + 1, false,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+static void jobs_execute(struct JobSystem *js, struct Job const *job) {
+  job->func(job->data);
+  if (job->counter != NULL) {
+    __atomic_fetch_sub(&job->counter->value, 1, __ATOMIC_ACQ_REL);
+  }
+  js->stats[t_worker_index].executed++;
+}
+
+// own deque first, then the others starting next door.
+static bool jobs_take(struct JobSystem *js, struct Job *job) {
+  uint32_t self = t_worker_index;
+  uint32_t deque_count = js->worker_count + 1;
+  bool found = deque_pop(&js->deques[self], job);
+  for (uint32_t i = 1; !found && i < deque_count; ++i) {
+    if (deque_steal(&js->deques[(self + i) % deque_count], job)) {
+      js->stats[self].stolen++;
+      found = true;
+    }
+  }
+  if (found) {
+    __atomic_fetch_sub(&js->pending, 1, __ATOMIC_SEQ_CST);
+  }
+  return found;
+}
+
+#if JOBS_THREADS
+static void *jobs_worker_main(void *arg) {
+  struct JobWorker *worker = (struct JobWorker *)arg;
+  struct JobSystem *js = worker->js;
+  struct JobWorkers *workers = js->workers;
+  t_worker_index = worker->index;
+
+  for (;;) {
+    struct Job job;
+    if (jobs_take(js, &job)) {
+      jobs_execute(js, &job);
+      continue;
+    }
+
+    // sleeping is raised before pending is checked and jobs_run raises
+    // pending before it checks sleeping, so one of the two always sees the
+    // other and a wake up can't be lost
+    pthread_mutex_lock(&workers->mutex);
+    __atomic_fetch_add(&workers->sleeping, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&js->pending, __ATOMIC_SEQ_CST) <= 0 &&
+           !__atomic_load_n(&js->quit, __ATOMIC_SEQ_CST)) {
+      pthread_cond_wait(&workers->wake, &workers->mutex);
+    }
+    __atomic_fetch_sub(&workers->sleeping, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&workers->mutex);
+
+    if (__atomic_load_n(&js->quit, __ATOMIC_SEQ_CST))
+      break;
+  }
+  return NULL;
+}
+#endif
+
+uint32_t jobs_cpu_count(void) {
+#if JOBS_THREADS
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (uint32_t)count : 1;
+#else
+  return 1;
+#endif
+}
+
+bool jobs_new(struct JobSystem *js, uint32_t worker_count) {
+  memset(js, 0, sizeof(*js));
+#if !JOBS_THREADS
+  worker_count = 0;
+#endif
+  if (worker_count > JOBS_MAX_WORKERS)
+    worker_count = JOBS_MAX_WORKERS;
+
+  js->deques =
+      (struct JobDeque *)calloc(worker_count + 1, sizeof(struct JobDeque));
+  if (js->deques == NULL) {
+    printf("Failed to allocate job deques\n");
+    return false;
+  }
+  t_worker_index = 0;
+
+#if JOBS_THREADS
+  js->workers = (struct JobWorkers *)calloc(1, sizeof(struct JobWorkers));
+  if (js->workers == NULL) {
+    printf("Failed to allocate job workers\n");
+    free(js->deques);
+    js->deques = NULL;
+    return false;
+  }
+  pthread_mutex_init(&js->workers->mutex, NULL);
+  pthread_cond_init(&js->workers->wake, NULL);
+
+  // set before any worker starts stealing. if a thread fails to start its
+  // deque just stays empty.
+  js->worker_count = worker_count;
+  for (uint32_t i = 0; i < worker_count; ++i) {
+    struct JobWorker *worker = &js->workers->workers[i];
+    worker->js = js;
+    worker->index = i + 1;
+    if (pthread_create(&worker->thread, NULL, jobs_worker_main, worker) != 0) {
+      printf("Failed to start job worker %u\n", i);
+      break;
+    }
+    js->workers->thread_count++;
+  }
+#endif
+  return true;
+}
+
+void jobs_free(struct JobSystem *js) {
+#if JOBS_THREADS
+  if (js->workers != NULL) {
+    pthread_mutex_lock(&js->workers->mutex);
+    __atomic_store_n(&js->quit, 1, __ATOMIC_SEQ_CST);
+    pthread_cond_broadcast(&js->workers->wake);
+    pthread_mutex_unlock(&js->workers->mutex);
+
+    for (uint32_t i = 0; i < js->workers->thread_count; ++i) {
+      pthread_join(js->workers->workers[i].thread, NULL);
+    }
+    pthread_cond_destroy(&js->workers->wake);
+    pthread_mutex_destroy(&js->workers->mutex);
+    free(js->workers);
+  }
+#endif
+  free(js->deques);
+  memset(js, 0, sizeof(*js));
+}
+
+void jobs_run(struct JobSystem *js, struct Job const *jobs, uint32_t count,
+              struct JobCounter *counter) {
+  if (counter != NULL) {
+    __atomic_fetch_add(&counter->value, (int32_t)count, __ATOMIC_ACQ_REL);
+  }
+
+  struct JobDeque *deque = &js->deques[t_worker_index];
+  for (uint32_t i = 0; i < count; ++i) {
+    struct Job job = jobs[i];
+    job.counter = counter;
+    if (!deque_push(deque, &job)) {
+      jobs_execute(js, &job);
+      continue;
+    }
+    __atomic_fetch_add(&js->pending, 1, __ATOMIC_SEQ_CST);
+  }
+
+#if JOBS_THREADS
+  if (__atomic_load_n(&js->workers->sleeping, __ATOMIC_SEQ_CST) > 0) {
+    pthread_mutex_lock(&js->workers->mutex);
+    if (count > 1) {
+      pthread_cond_broadcast(&js->workers->wake);
+    } else {
+      pthread_cond_signal(&js->workers->wake);
+    }
+    pthread_mutex_unlock(&js->workers->mutex);
+  }
+#endif
+}
+
+void jobs_wait(struct JobSystem *js, struct JobCounter *counter) {
+  while (__atomic_load_n(&counter->value, __ATOMIC_ACQUIRE) > 0) {
+    struct Job job;
+    if (jobs_take(js, &job)) {
+      jobs_execute(js, &job);
+    } else {
+#if JOBS_THREADS
+      // the remaining jobs are running on other threads
+      sched_yield();
+#endif
+    }
+  }
+}
+
+struct JobRange {
+  JobRangeFunc func;
+  void *data;
+  uint32_t begin;
+  uint32_t end;
+};
+
+static void jobs_range_main(void *data) {
+  struct JobRange const *range = (struct JobRange const *)data;
+  range->func(range->data, range->begin, range->end);
+}
+
+void jobs_parallel_for(struct JobSystem *js, uint32_t count,
+                       uint32_t min_batch, JobRangeFunc func, void *data) {
+  if (count == 0)
+    return;
+  if (min_batch == 0)
+    min_batch = 1;
+
+  // a few batches per thread so stealing can even out uneven work
+  uint32_t batches = (js->worker_count + 1) * 4;
+  if (batches > JOBS_MAX_BATCHES)
+    batches = JOBS_MAX_BATCHES;
+  uint32_t batch = (count + batches - 1) / batches;
+  if (batch < min_batch)
+    batch = min_batch;
+  batches = (count + batch - 1) / batch;
+
+  if (batches == 1) {
+    func(data, 0, count);
+    return;
+  }
+
+  struct JobRange ranges[JOBS_MAX_BATCHES];
+  struct Job jobs[JOBS_MAX_BATCHES];
+  for (uint32_t i = 0; i < batches; ++i) {
+    uint32_t begin = i * batch;
+    uint32_t end = begin + batch < count ? begin + batch : count;
+    ranges[i] = (struct JobRange){func, data, begin, end};
+    jobs[i] = (struct Job){jobs_range_main, &ranges[i], NULL};
+  }
+
+  struct JobCounter counter = {0};
+  jobs_run(js, jobs, batches, &counter);
+  jobs_wait(js, &counter);
+}
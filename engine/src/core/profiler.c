@@ -0,0 +1,311 @@
+// clock_gettime under -std=c99
+#define _POSIX_C_SOURCE 200809L
+
+#include "core/profiler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PROFILER_RING_MASK (PROFILER_RING_SIZE - 1)
+#define PROFILER_CAPTURE_MASK (PROFILER_CAPTURE_SIZE - 1)
+
+struct ProfilerOpenZone {
+  char const *name;
+  uint64_t begin;
+};
+
+// single producer ring. the owning thread of the ring publishes head after
+// writing a slot, profiler_frame reads up to head. slots go through relaxed
+// atomics since a thread that laps the reader overwrites what it is reading,
+// those events are thrown away as dropped.
+struct ProfilerRing {
+  uint64_t head;
+  uint64_t tail;
+  struct ProfilerEvent events[PROFILER_RING_SIZE];
+};
+
+struct ProfilerState {
+  struct ProfilerRing rings[PROFILER_MAX_THREADS];
+  uint32_t thread_count;
+  uint64_t frame_begin;
+  struct ProfilerFrame last_frame;
+  float history[PROFILER_HISTORY];
+  uint32_t history_head;
+  struct ProfilerEvent *capture;
+  uint64_t capture_head;
+  struct ProfilerZone gpu_zones[PROFILER_MAX_GPU_ZONES];
+  uint32_t gpu_zone_count;
+};
+
+static struct ProfilerState *g_profiler;
+
+// -1 until the thread records its first zone
+static __thread int32_t t_thread = -1;
+static __thread struct ProfilerOpenZone t_stack[PROFILER_MAX_DEPTH];
+static __thread uint32_t t_depth;
+
+uint64_t profiler_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+bool profiler_init(void) {
+  struct ProfilerState *state =
+      (struct ProfilerState *)calloc(1, sizeof(struct ProfilerState));
+  if (state == NULL) {
+    printf("Failed to allocate profiler\n");
+    return false;
+  }
+  state->capture = (struct ProfilerEvent *)calloc(
+      PROFILER_CAPTURE_SIZE, sizeof(struct ProfilerEvent));
+  if (state->capture == NULL) {
+    printf("Failed to allocate profiler capture\n");
+    free(state);
+    return false;
+  }
+
+  state->thread_count = 1;
+  state->frame_begin = profiler_now();
+  t_thread = 0;
+  t_depth = 0;
+  __atomic_store_n(&g_profiler, state, __ATOMIC_RELEASE);
+  return true;
+}
+
+void profiler_shutdown(void) {
+  struct ProfilerState *state = g_profiler;
+  __atomic_store_n(&g_profiler, NULL, __ATOMIC_RELEASE);
+  if (state != NULL) {
+    free(state->capture);
+    free(state);
+  }
+}
+
+void profiler_begin(char const *name) {
+  if (__atomic_load_n(&g_profiler, __ATOMIC_ACQUIRE) == NULL)
+    return;
+  if (t_depth < PROFILER_MAX_DEPTH) {
+    t_stack[t_depth] = (struct ProfilerOpenZone){name, profiler_now()};
+  }
+  t_depth++;
+}
+
+void profiler_end(void) {
+  struct ProfilerState *state = __atomic_load_n(&g_profiler, __ATOMIC_ACQUIRE);
+  if (state == NULL || t_depth == 0)
+    return;
+  uint64_t end = profiler_now();
+  t_depth--;
+  if (t_depth >= PROFILER_MAX_DEPTH)
+    return;
+
+  if (t_thread < 0) {
+    uint32_t index = __atomic_fetch_add(&state->thread_count, 1,
+                                        __ATOMIC_RELAXED);
+    // past the last ring the thread stays unrecorded
+    t_thread = index < PROFILER_MAX_THREADS ? (int32_t)index
+                                            : PROFILER_MAX_THREADS;
+  }
+  if (t_thread >= PROFILER_MAX_THREADS)
+    return;
+
+  struct ProfilerRing *ring = &state->rings[t_thread];
+  uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+  struct ProfilerEvent *slot = &ring->events[head & PROFILER_RING_MASK];
+  struct ProfilerOpenZone const *zone = &t_stack[t_depth];
+  __atomic_store_n(&slot->name, zone->name, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->begin, zone->begin, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->end, end, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->thread, (uint32_t)t_thread, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->depth, t_depth, __ATOMIC_RELAXED);
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void profiler_gpu_zone(char const *name, uint64_t duration_ns) {
+  struct ProfilerState *state = g_profiler;
+  if (state == NULL || state->gpu_zone_count >= PROFILER_MAX_GPU_ZONES)
+    return;
+  state->gpu_zones[state->gpu_zone_count++] =
+      (struct ProfilerZone){name, duration_ns, 1};
+}
+
+static void profiler_capture(struct ProfilerState *state,
+                             struct ProfilerEvent const *event) {
+  state->capture[state->capture_head++ & PROFILER_CAPTURE_MASK] = *event;
+}
+
+// names are usually the same literal, so pointers are compared first.
+static void profiler_accumulate(struct ProfilerFrame *frame,
+                                struct ProfilerEvent const *event) {
+  for (uint32_t i = 0; i < frame->zone_count; ++i) {
+    struct ProfilerZone *zone = &frame->zones[i];
+    if (zone->name == event->name || strcmp(zone->name, event->name) == 0) {
+      zone->total_ns += event->end - event->begin;
+      zone->calls++;
+      return;
+    }
+  }
+  if (frame->zone_count < PROFILER_MAX_ZONES) {
+    frame->zones[frame->zone_count++] = (struct ProfilerZone){
+        event->name, event->end - event->begin, 1};
+  }
+}
+
+static int profiler_zone_compare(void const *a, void const *b) {
+  uint64_t ta = ((struct ProfilerZone const *)a)->total_ns;
+  uint64_t tb = ((struct ProfilerZone const *)b)->total_ns;
+  return (ta < tb) - (ta > tb);
+}
+
+void profiler_frame(void) {
+  struct ProfilerState *state = g_profiler;
+  if (state == NULL)
+    return;
+
+  uint64_t now = profiler_now();
+  struct ProfilerFrame *frame = &state->last_frame;
+  memset(frame, 0, sizeof(*frame));
+  frame->frame_ms = (float)((now - state->frame_begin) / 1e6);
+
+  uint32_t thread_count =
+      __atomic_load_n(&state->thread_count, __ATOMIC_RELAXED);
+  if (thread_count > PROFILER_MAX_THREADS)
+    thread_count = PROFILER_MAX_THREADS;
+  for (uint32_t t = 0; t < thread_count; ++t) {
+    struct ProfilerRing *ring = &state->rings[t];
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    if (head - ring->tail > PROFILER_RING_SIZE) {
+      frame->dropped += (uint32_t)(head - ring->tail - PROFILER_RING_SIZE);
+      ring->tail = head - PROFILER_RING_SIZE;
+    }
+
+    for (uint64_t i = ring->tail; i < head; ++i) {
+      struct ProfilerEvent const *slot = &ring->events[i & PROFILER_RING_MASK];
+      struct ProfilerEvent event = {
+          __atomic_load_n(&slot->name, __ATOMIC_RELAXED),
+          __atomic_load_n(&slot->begin, __ATOMIC_RELAXED),
+          __atomic_load_n(&slot->end, __ATOMIC_RELAXED),
+          __atomic_load_n(&slot->thread, __ATOMIC_RELAXED),
+          __atomic_load_n(&slot->depth, __ATOMIC_RELAXED)};
+      // the writer came around again while this slot was read
+      if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - i >
+          PROFILER_RING_SIZE) {
+        frame->dropped++;
+        continue;
+      }
+      profiler_accumulate(frame, &event);
+      profiler_capture(state, &event);
+    }
+    ring->tail = head;
+  }
+
+  uint64_t gpu_time = state->frame_begin;
+  for (uint32_t i = 0; i < state->gpu_zone_count; ++i) {
+    struct ProfilerZone const *zone = &state->gpu_zones[i];
+    struct ProfilerEvent event = {zone->name, gpu_time,
+                                  gpu_time + zone->total_ns,
+                                  PROFILER_GPU_THREAD, 0};
+    gpu_time = event.end;
+    profiler_accumulate(frame, &event);
+    profiler_capture(state, &event);
+  }
+  state->gpu_zone_count = 0;
+
+  qsort(frame->zones, frame->zone_count, sizeof(struct ProfilerZone),
+        profiler_zone_compare);
+
+  // the frame itself shows up as a zone in the trace
+  struct ProfilerEvent frame_event = {"frame", state->frame_begin, now, 0, 0};
+  profiler_capture(state, &frame_event);
+  state->frame_begin = now;
+
+  state->history[state->history_head] = frame->frame_ms;
+  state->history_head = (state->history_head + 1) % PROFILER_HISTORY;
+}
+
+struct ProfilerFrame const *profiler_last_frame(void) {
+  return g_profiler != NULL ? &g_profiler->last_frame : NULL;
+}
+
+void profiler_history(float out[PROFILER_HISTORY]) {
+  if (g_profiler == NULL) {
+    memset(out, 0, PROFILER_HISTORY * sizeof(float));
+    return;
+  }
+  for (uint32_t i = 0; i < PROFILER_HISTORY; ++i) {
+    out[i] = g_profiler->history[(g_profiler->history_head + i) %
+                                 PROFILER_HISTORY];
+  }
+}
+
+void profiler_print(uint32_t max_zones) {
+  struct ProfilerFrame const *frame = profiler_last_frame();
+  if (frame == NULL)
+    return;
+  printf("frame %.2f ms", frame->frame_ms);
+  if (frame->dropped > 0)
+    printf(", %u zones dropped", frame->dropped);
+  printf("\n");
+  for (uint32_t i = 0; i < frame->zone_count && i < max_zones; ++i) {
+    struct ProfilerZone const *zone = &frame->zones[i];
+    printf("  %-24s %8.3f ms %6u calls\n", zone->name, zone->total_ns / 1e6,
+           zone->calls);
+  }
+}
+
+// zone names are written as they are, so keep quotes and backslashes out of
+// them.
+bool profiler_write_chrome_trace(char const *path) {
+  struct ProfilerState *state = g_profiler;
+  if (state == NULL)
+    return false;
+
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    printf("Failed to open %s for writing\n", path);
+    return false;
+  }
+
+  uint64_t count = state->capture_head < PROFILER_CAPTURE_SIZE
+                       ? state->capture_head
+                       : PROFILER_CAPTURE_SIZE;
+  uint64_t first = state->capture_head - count;
+  uint64_t origin = count > 0 ? state->capture[first & PROFILER_CAPTURE_MASK].begin
+                              : 0;
+  for (uint64_t i = first; i < state->capture_head; ++i) {
+    uint64_t begin = state->capture[i & PROFILER_CAPTURE_MASK].begin;
+    origin = begin < origin ? begin : origin;
+  }
+
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  uint32_t thread_count =
+      __atomic_load_n(&state->thread_count, __ATOMIC_RELAXED);
+  if (thread_count > PROFILER_MAX_THREADS)
+    thread_count = PROFILER_MAX_THREADS;
+  for (uint32_t t = 0; t < thread_count; ++t) {
+    fprintf(file,
+            "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+            "\"tid\":%u,\"args\":{\"name\":\"%s %u\"}}",
+            t == 0 ? "" : ",\n", t, t == 0 ? "main" : "worker", t);
+  }
+  fprintf(file,
+          ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+          "\"tid\":%u,\"args\":{\"name\":\"gpu\"}}",
+          PROFILER_GPU_THREAD);
+  for (uint64_t i = first; i < state->capture_head; ++i) {
+    struct ProfilerEvent const *event =
+        &state->capture[i & PROFILER_CAPTURE_MASK];
+    // timestamps in microseconds
+    fprintf(file,
+            ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,"
+            "\"ts\":%.3f,\"dur\":%.3f}",
+            event->name, event->thread, (event->begin - origin) / 1e3,
+            (event->end - event->begin) / 1e3);
+  }
+  fprintf(file, "\n]}\n");
+  fclose(file);
+  return true;
+}
@@ -0,0 +1,36 @@
+#include "core/timestep.h"
+
+struct Timestep timestep_new(uint32_t hz, uint64_t frequency, uint64_t now) {
+  if (hz == 0)
+    hz = TIMESTEP_DEFAULT_HZ;
+  uint64_t step_ticks = frequency / hz;
+  if (step_ticks == 0)
+    step_ticks = 1;
+
+  return (struct Timestep){.frequency = frequency,
+                           .step_ticks = step_ticks,
+                           .last = now,
+                           .max_steps = TIMESTEP_MAX_STEPS,
+                           .dt = (float)((double)step_ticks / frequency)};
+}
+
+uint32_t timestep_advance(struct Timestep *timestep, uint64_t now) {
+  // a counter that went backwards counts as no time passing
+  uint64_t elapsed = now > timestep->last ? now - timestep->last : 0;
+  timestep->last = now;
+  timestep->accumulator += elapsed;
+
+  uint64_t steps = timestep->accumulator / timestep->step_ticks;
+  if (steps > timestep->max_steps) {
+    uint64_t dropped = (steps - timestep->max_steps) * timestep->step_ticks;
+    timestep->dropped_ticks += dropped;
+    timestep->accumulator -= dropped;
+    steps = timestep->max_steps;
+  }
+  timestep->accumulator -= steps * timestep->step_ticks;
+  timestep->steps += steps;
+
+  timestep->alpha =
+      (float)((double)timestep->accumulator / timestep->step_ticks);
+  return (uint32_t)steps;
+}
@@ -0,0 +1,222 @@
+#include "core/vertex_cache.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the scoring constants from the paper
+#define VERTEX_CACHE_DECAY_POWER 1.5f
+#define VERTEX_CACHE_LAST_TRI_SCORE 0.75f
+#define VERTEX_CACHE_VALENCE_SCALE 2.0f
+#define VERTEX_CACHE_VALENCE_POWER 0.5f
+// valences up to this use the table, the rest call powf
+#define VERTEX_CACHE_VALENCE_TABLE 32
+
+struct VertexCacheScores {
+  float position[VERTEX_CACHE_SIZE];
+  float valence[VERTEX_CACHE_VALENCE_TABLE];
+};
+
+static void vertex_cache_scores_init(struct VertexCacheScores *scores) {
+  for (int i = 0; i < VERTEX_CACHE_SIZE; ++i) {
+    if (i < 3) {
+      // the last triangle's vertices score the same whatever their order, so
+      // the next triangle doesn't just pick the newest edge
+      scores->position[i] = VERTEX_CACHE_LAST_TRI_SCORE;
+    } else {
+      float scale = 1.f / (VERTEX_CACHE_SIZE - 3);
+      scores->position[i] =
+          powf(1.f - (i - 3) * scale, VERTEX_CACHE_DECAY_POWER);
+    }
+  }
+  scores->valence[0] = 0.f;
+  for (int i = 1; i < VERTEX_CACHE_VALENCE_TABLE; ++i) {
+    scores->valence[i] = VERTEX_CACHE_VALENCE_SCALE *
+                         powf((float)i, -VERTEX_CACHE_VALENCE_POWER);
+  }
+}
+
+// position is -1 when the vertex isn't cached. vertices with few triangles
+// left get a boost so lone triangles are finished off instead of left behind.
+static float vertex_score(struct VertexCacheScores const *scores,
+                          int32_t position, uint32_t remaining) {
+  if (remaining == 0)
+    return -1.f;
+  float score = position >= 0 ? scores->position[position] : 0.f;
+  if (remaining < VERTEX_CACHE_VALENCE_TABLE) {
+    score += scores->valence[remaining];
+  } else {
+    score += VERTEX_CACHE_VALENCE_SCALE *
+             powf((float)remaining, -VERTEX_CACHE_VALENCE_POWER);
+  }
+  return score;
+}
+
+bool vertex_cache_optimize(uint32_t *indices, uint32_t index_count,
+                           uint32_t vertex_count) {
+  uint32_t tri_count = index_count / 3;
+  if (tri_count == 0)
+    return true;
+
+  // per vertex: where its triangles start in adjacency and how many of them
+  // are still to be emitted, kept at the front of its range
+  uint32_t *offsets = (uint32_t *)calloc(vertex_count + 1, sizeof(uint32_t));
+  uint32_t *remaining = (uint32_t *)calloc(vertex_count, sizeof(uint32_t));
+  int32_t *position = (int32_t *)malloc(vertex_count * sizeof(int32_t));
+  float *vscore = (float *)malloc(vertex_count * sizeof(float));
+  uint32_t *adjacency = (uint32_t *)malloc(tri_count * 3 * sizeof(uint32_t));
+  float *tscore = (float *)malloc(tri_count * sizeof(float));
+  bool *emitted = (bool *)calloc(tri_count, sizeof(bool));
+  uint32_t *out = (uint32_t *)malloc(tri_count * 3 * sizeof(uint32_t));
+  bool ok = offsets && remaining && position && vscore && adjacency &&
+            tscore && emitted && out;
+  if (!ok) {
+    printf("Failed to allocate vertex cache optimizer scratch\n");
+    goto exit;
+  }
+
+  struct VertexCacheScores scores;
+  vertex_cache_scores_init(&scores);
+
+  for (uint32_t i = 0; i < tri_count * 3; ++i) {
+    remaining[indices[i]]++;
+  }
+  for (uint32_t v = 0; v < vertex_count; ++v) {
+    offsets[v + 1] = offsets[v] + remaining[v];
+    remaining[v] = 0;
+  }
+  for (uint32_t t = 0; t < tri_count; ++t) {
+    for (int k = 0; k < 3; ++k) {
+      uint32_t v = indices[t * 3 + k];
+      adjacency[offsets[v] + remaining[v]++] = t;
+    }
+  }
+  for (uint32_t v = 0; v < vertex_count; ++v) {
+    position[v] = -1;
+    vscore[v] = vertex_score(&scores, -1, remaining[v]);
+  }
+
+  int64_t best = -1;
+  float best_score = -1.f;
+  for (uint32_t t = 0; t < tri_count; ++t) {
+    uint32_t const *tri = indices + t * 3;
+    tscore[t] = vscore[tri[0]] + vscore[tri[1]] + vscore[tri[2]];
+    if (tscore[t] > best_score) {
+      best_score = tscore[t];
+      best = t;
+    }
+  }
+
+  // three extra slots hold what the newest triangle pushes out
+  uint32_t cache[VERTEX_CACHE_SIZE + 3];
+  uint32_t cache_count = 0;
+  uint32_t cursor = 0;
+  for (uint32_t i = 0; i < tri_count; ++i) {
+    if (best < 0) {
+      // nothing in the cache touches a triangle that is left, start over on
+      // the first one in the original order
+      while (emitted[cursor]) {
+        ++cursor;
+      }
+      best = cursor;
+    }
+
+    uint32_t const *tri = indices + best * 3;
+    memcpy(out + i * 3, tri, 3 * sizeof(uint32_t));
+    emitted[best] = true;
+
+    for (int k = 0; k < 3; ++k) {
+      uint32_t v = tri[k];
+      uint32_t *list = adjacency + offsets[v];
+      for (uint32_t j = 0; j < remaining[v]; ++j) {
+        if (list[j] == (uint32_t)best) {
+          list[j] = list[--remaining[v]];
+          break;
+        }
+      }
+    }
+
+    // the triangle's vertices move to the front, the rest shift back
+    uint32_t next[VERTEX_CACHE_SIZE + 3];
+    uint32_t next_count = 0;
+    for (int k = 0; k < 3; ++k) {
+      next[next_count++] = tri[k];
+    }
+    for (uint32_t j = 0; j < cache_count; ++j) {
+      uint32_t v = cache[j];
+      if (v != tri[0] && v != tri[1] && v != tri[2])
+        next[next_count++] = v;
+    }
+
+    for (uint32_t j = 0; j < next_count; ++j) {
+      uint32_t v = next[j];
+      position[v] = j < VERTEX_CACHE_SIZE ? (int32_t)j : -1;
+      vscore[v] = vertex_score(&scores, position[v], remaining[v]);
+    }
+
+    best = -1;
+    best_score = -1.f;
+    for (uint32_t j = 0; j < next_count; ++j) {
+      uint32_t v = next[j];
+      uint32_t const *list = adjacency + offsets[v];
+      for (uint32_t a = 0; a < remaining[v]; ++a) {
+        uint32_t t = list[a];
+        uint32_t const *other = indices + t * 3;
+        tscore[t] = vscore[other[0]] + vscore[other[1]] + vscore[other[2]];
+        if (tscore[t] > best_score) {
+          best_score = tscore[t];
+          best = t;
+        }
+      }
+    }
+
+    cache_count = next_count < VERTEX_CACHE_SIZE ? next_count
+                                                 : VERTEX_CACHE_SIZE;
+    memcpy(cache, next, cache_count * sizeof(uint32_t));
+  }
+
+  memcpy(indices, out, tri_count * 3 * sizeof(uint32_t));
+
+exit:
+  free(offsets);
+  free(remaining);
+  free(position);
+  free(vscore);
+  free(adjacency);
+  free(tscore);
+  free(emitted);
+  free(out);
+  return ok;
+}
+
+float vertex_cache_acmr(uint32_t const *indices, uint32_t index_count,
+                        uint32_t cache_size) {
+  uint32_t tri_count = index_count / 3;
+  if (tri_count == 0)
+    return 0.f;
+  if (cache_size > VERTEX_CACHE_MAX_SIMULATED)
+    cache_size = VERTEX_CACHE_MAX_SIMULATED;
+
+  // a ring, a hit doesn't move the entry
+  uint32_t fifo[VERTEX_CACHE_MAX_SIMULATED];
+  uint32_t count = 0, head = 0;
+  uint64_t misses = 0;
+  for (uint32_t i = 0; i < tri_count * 3; ++i) {
+    uint32_t v = indices[i];
+    bool hit = false;
+    for (uint32_t j = 0; j < count && !hit; ++j) {
+      hit = fifo[j] == v;
+    }
+    if (hit)
+      continue;
+    ++misses;
+    if (count < cache_size) {
+      fifo[count++] = v;
+    } else {
+      fifo[head] = v;
+      head = (head + 1) % cache_size;
+    }
+  }
+  return (float)misses / tri_count;
+}
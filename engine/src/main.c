@@ -1,18 +1,28 @@
 #include <SDL.h>
+#include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "SDL_events.h"
 #include "core/debug.h"
 #include "core/input.h"
+#include "core/jobs.h"
+#include "core/profiler.h"
+#include "core/timestep.h"
 #include "gl.h"
 #include "math/matrix4.h"
 #include "math/vector4.h"
+#include "platform/file.h"
+#include "platform/png.h"
 #include "render/colors.h"
+#include "render/frame_data.h"
 #include "render/gfx_api.h"
 #include "render/gfx_context.h"
+#include "render/voxel_renderer.h"
 #include "voxel/grid.h"
+#include "voxel/level.h"
 
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
@@ -20,6 +30,19 @@
 
 #define UNREFERENCED_PARAMETER(x) (void)x
 
+#define PROP_COUNT 8
+// radians per second
+#define CAMERA_ORBIT_SPEED 1.5f
+// fraction of the distance per second
+#define CAMERA_ZOOM_SPEED 1.f
+#define CAMERA_MIN_DISTANCE 2.f
+#define CAMERA_MAX_DISTANCE 40.f
+#define PROFILE_TRACE_PATH "profile.json"
+// frames the benchmark may spend meshing the scene before timing starts
+#define BENCH_MAX_WARMUP_FRAMES 10000
+// frames of block edits after the timed frames, to measure chunk uploads
+#define BENCH_EDIT_FRAMES 64
+
 struct World {
   struct Vector4 ambient_dir;
   struct Vector4 ambient_color;
@@ -28,26 +51,220 @@ struct World {
   struct Vector4 fog_color;
   float fog_start;
   float fog_end;
+  // interpolated from the simulation every frame
+  struct Vector4 camera_eye;
+  struct Vector4 camera_target;
+  // set when anything above changes, the view projection is derived from the
+  // camera so it is covered as well
+  bool dirty;
+};
+
+// everything the fixed step advances. rendering blends the last two states so
+// motion stays smooth whatever the frame rate.
+struct SimState {
   struct Vector4 camera_eye;
   struct Vector4 camera_target;
+  struct Vector4 props[PROP_COUNT];
+  float time;
+};
+
+struct Options {
+  uint32_t sim_hz;
+  bool headless;
+  // frames of the fixed camera benchmark scene, 0 runs the game
+  uint32_t bench_frames;
+  // benchmark frames are written to <png_prefix>_<frame>.png every png_every
+  // frames, or only the last one when png_every is 0
+  char const *png_prefix;
+  uint32_t png_every;
+  // level file loaded in place of the built in scene
+  char const *level_path;
+  // the starting grid is written here before the game runs
+  char const *save_level_path;
+  // voxels are drawn from face words in a data texture instead of vertex
+  // buffers
+  bool vertex_pulling;
 };
 
 struct Core {
+  struct Options options;
   struct Debug debug;
   struct GraphicsContext graphics;
+  struct GpuTimer gpu_timer;
   struct Grid grid;
+  // backs the grid's chunks when it came from a level file
+  struct FileMap level_map;
+  struct FileIo io;
+  // graphics.shader_generation the texture units were last set for
+  uint32_t shader_generation;
   struct Input input;
+  struct JobSystem jobs;
+  struct VoxelRenderer voxels;
+  // dynamic cubes that change too often to be worth meshing
+  struct InstancedMesh props;
   struct World world;
+  struct Timestep timestep;
+  struct SimState sim_prev;
+  struct SimState sim;
+  // benchmark runs advance the simulation clock by exactly one step per frame
+  // so every run renders the same images
+  bool fixed_clock;
+  uint64_t clock;
   bool running;
 };
 
 static struct Core core;
 
+// uploads the FrameData block shared by every program, only when the world
+// changed since the last upload.
+static void update_frame_data(struct Matrix4 const *vp) {
+  if (!core.world.dirty)
+    return;
+
+  struct FrameData frame_data = {
+      .view_proj = *vp,
+      .ambient_dir = core.world.ambient_dir,
+      .ambient_color = core.world.ambient_color,
+      .light_pos = core.world.point_light_pos,
+      .light_color = core.world.point_light_color,
+      .camera_eye = core.world.camera_eye,
+      .fog_color = core.world.fog_color,
+      .fog_props =
+          Vector4_new_vector(core.world.fog_start, core.world.fog_end, 0.f)};
+  uniform_buffer_update(&core.graphics.frame_data, &frame_data,
+                        sizeof(frame_data));
+  core.world.dirty = false;
+}
+
+// one fixed step. A and D orbit the camera around its target, W and S move
+// it closer and further.
+static void simulate(struct SimState *state, float dt) {
+  float orbit = 0.f;
+  float zoom = 0.f;
+  if (input_is_key_active(&core.input, KEYCODE_A))
+    orbit -= 1.f;
+  if (input_is_key_active(&core.input, KEYCODE_D))
+    orbit += 1.f;
+  if (input_is_key_active(&core.input, KEYCODE_W))
+    zoom -= 1.f;
+  if (input_is_key_active(&core.input, KEYCODE_S))
+    zoom += 1.f;
+
+  struct Matrix4 rotation = Matrix4_rotation_y(orbit * CAMERA_ORBIT_SPEED * dt);
+  struct Vector4 offset = Matrix4_transform(
+      &rotation, Vector4_subtract(state->camera_eye, state->camera_target));
+  float distance = Vector4_magnitude(offset);
+  float target_distance = distance * (1.f + zoom * CAMERA_ZOOM_SPEED * dt);
+  if (target_distance < CAMERA_MIN_DISTANCE)
+    target_distance = CAMERA_MIN_DISTANCE;
+  if (target_distance > CAMERA_MAX_DISTANCE)
+    target_distance = CAMERA_MAX_DISTANCE;
+  if (distance > 0.f)
+    offset = Vector4_scale(offset, target_distance / distance);
+  state->camera_eye = Vector4_add(state->camera_target, offset);
+
+  // props circle the grid, bobbing up and down
+  state->time += dt;
+  for (int i = 0; i < PROP_COUNT; ++i) {
+    float angle = state->time * 0.5f + i * (6.2831853f / PROP_COUNT);
+    state->props[i] =
+        Vector4_new_point(6.f * cosf(angle), 2.f + sinf(state->time + i),
+                          6.f * sinf(angle));
+  }
+}
+
+// runs the steps the time since the last frame adds up to, then blends the
+// last two states into what gets drawn.
+static void update_simulation(void) {
+  PROFILE_BEGIN("simulate");
+  if (core.fixed_clock) {
+    core.clock += core.timestep.step_ticks;
+  } else {
+    core.clock = SDL_GetPerformanceCounter();
+  }
+  uint32_t steps = timestep_advance(&core.timestep, core.clock);
+  for (uint32_t i = 0; i < steps; ++i) {
+    core.sim_prev = core.sim;
+    simulate(&core.sim, core.timestep.dt);
+  }
+
+  float alpha = core.timestep.alpha;
+  struct Vector4 eye =
+      Vector4_lerp(core.sim_prev.camera_eye, core.sim.camera_eye, alpha);
+  struct Vector4 target =
+      Vector4_lerp(core.sim_prev.camera_target, core.sim.camera_target, alpha);
+  if (memcmp(&eye, &core.world.camera_eye, sizeof(eye)) != 0 ||
+      memcmp(&target, &core.world.camera_target, sizeof(target)) != 0) {
+    core.world.camera_eye = eye;
+    core.world.camera_target = target;
+    core.world.dirty = true;
+  }
+
+  struct CubeInstance instances[PROP_COUNT];
+  for (int i = 0; i < PROP_COUNT; ++i) {
+    struct Vector4 p =
+        Vector4_lerp(core.sim_prev.props[i], core.sim.props[i], alpha);
+    instances[i] = (struct CubeInstance){p.x, p.y, p.z, GRID_ORANGE};
+  }
+  instanced_mesh_fill(&core.props, instances, PROP_COUNT);
+  PROFILE_END();
+}
+
+static enum MeshFormat voxel_format(void) {
+  return core.options.vertex_pulling ? MESH_FORMAT_FACES : MESH_FORMAT_PACKED;
+}
+
+// palette entries edited since the last frame go up as one sub-upload, the
+// whole palette after a new grid. geometry only carries the index, so
+// nothing is remeshed.
+static void update_palette(void) {
+  struct Grid *grid = &core.grid;
+  uint32_t begin = grid->palette_dirty_begin;
+  uint32_t end = grid->palette_dirty_end;
+  if (begin == end)
+    return;
+  uniform_buffer_update_range(&core.graphics.palette,
+                              begin * sizeof(struct GridMaterial),
+                              &grid->palette[begin],
+                              (end - begin) * sizeof(struct GridMaterial));
+  grid_palette_clear_dirty(grid);
+}
+
+// sampler units are program state, set again whenever the programs change.
+static void set_texture_units(void) {
+  shader_bind(&core.graphics.voxel_pull);
+  shader_set_int_uniform(core.graphics.voxel_pull_faces,
+                         VOXEL_FACES_TEXTURE_UNIT);
+  core.shader_generation = core.graphics.shader_generation;
+}
+
+// the streamed level replaces the starting scene once it has been read.
+static void level_loaded(void *user, struct File *file, bool ok) {
+  char const *path = (char const *)user;
+  struct FileMap map = {.data = (uint8_t *)file->data, .length = file->length};
+  struct Grid grid;
+  if (!ok || !level_load_from(&grid, &map, path)) {
+    file_unmap(&map);
+    return;
+  }
+
+  voxel_renderer_free(&core.voxels);
+  grid_free(&core.grid);
+  file_unmap(&core.level_map);
+  core.grid = grid;
+  core.level_map = map;
+  core.voxels = voxel_renderer_new(&core.grid, &core.jobs, voxel_format());
+  printf("Loaded level %s\n", path);
+}
+
 static void mainloop(void) {
+  gfx_stats_reset();
+
   // update input before processing new events
   input_update(&core.input);
 
   // process input from SDL
+  PROFILE_BEGIN("events");
   SDL_Event e;
   while (SDL_PollEvent(&e)) {
     switch (e.type) {
@@ -68,6 +285,25 @@ static void mainloop(void) {
       break;
     };
   }
+  PROFILE_END();
+
+  // finished reads hand over their data here
+  PROFILE_BEGIN("file io");
+  file_io_poll(&core.io);
+  PROFILE_END();
+
+  // R reloads the shaders from disk, the old ones draw until they compile
+  if (core.input.key_state[KEYCODE_R] == KEYSTATE_PRESSED)
+    graphics_context_reload_shaders(&core.graphics, &core.io);
+  if (core.shader_generation != core.graphics.shader_generation)
+    set_texture_units();
+
+  // P prints the last frame's zones and saves a trace of the recent frames
+  if (core.input.key_state[KEYCODE_P] == KEYSTATE_PRESSED) {
+    profiler_print(PROFILER_MAX_ZONES);
+    if (profiler_write_chrome_trace(PROFILE_TRACE_PATH))
+      printf("Wrote %s\n", PROFILE_TRACE_PATH);
+  }
 
   /*
   if (input_is_key_active(&core.input, KEYCODE_W)) {
@@ -80,137 +316,354 @@ static void mainloop(void) {
   }
   */
 
+  update_simulation();
+
   // start rendering the frame
   glClearColor(core.world.fog_color.x, core.world.fog_color.y,
                core.world.fog_color.z, 1.f);
+  gfx_set_depth_mask(true);
+  gpu_timer_begin(&core.gpu_timer, "gpu clear");
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  glDepthMask(GL_TRUE);
-  glEnable(GL_DEPTH_TEST);
+  gpu_timer_end(&core.gpu_timer);
+  gfx_set_depth_test(true);
 
   int width = core.graphics.width;
   int height = core.graphics.height;
 
-  struct Matrix4 p =
-      Matrix4_perspective(1.2f, (float)width / (float)height, 0.1f, 150.f);
+  // everything past fog_end is drawn as the clear color anyway, so pull the
+  // far plane in and let frustum culling drop it
+  struct Matrix4 p = Matrix4_perspective(1.2f, (float)width / (float)height,
+                                         0.1f, core.world.fog_end);
   struct Matrix4 c =
       Matrix4_lookat(core.world.camera_eye, core.world.camera_target,
                      Vector4_new_vector(0.f, 1.f, 0.f));
   struct Matrix4 vp = Matrix4_multiply(&p, &c);
+  struct Matrix4 ivp = Matrix4_invert(&vp);
 
   // test picking
   if (core.input.is_mouse_valid) {
-    struct Vector4 ndc_far =
-        Vector4_new_point(core.input.mouse_pos.x, core.input.mouse_pos.y, 1.f);
-    struct Vector4 ndc_near =
-        Vector4_new_point(core.input.mouse_pos.x, core.input.mouse_pos.y, -1.f);
-    struct Matrix4 ivp = Matrix4_invert(&vp);
-    struct Vector4 world_far = Matrix4_transform(&ivp, ndc_far);
-    world_far = Vector4_scale(world_far, 1.f / world_far.w);
-    struct Vector4 world_near = Matrix4_transform(&ivp, ndc_near);
-    world_near = Vector4_scale(world_near, 1.f / world_near.w);
-    printf("world_near: %f %f %f %f\n", world_near.x, world_near.y,
-           world_near.z, world_near.w);
-    printf("world_far: %f %f %f %f\n", world_far.x, world_far.y, world_far.z,
-           world_far.w);
-    struct Vector4 world_dir = Vector4_subtract(world_far, world_near);
-    printf("world_dir: %f %f %f\n", world_dir.x, world_dir.y, world_dir.z);
-    Vector4_normalize(&world_dir);
-    printf("|world_dir|: %f %f %f\n", world_dir.x, world_dir.y, world_dir.z);
-
-    // struct Vector4 plane_o = Vector4_new_point(0.f, 0.f, 0.f);
-    struct Vector4 plane_n = Vector4_new_vector(0.f, 1.f, 0.f);
-
-    float wdotn = Vector4_dot(world_dir, plane_n);
-    if (wdotn != 0.f) {
-      float t = -Vector4_dot(world_near, plane_n) / wdotn;
-      if (t > 0.f) {
-        struct Vector4 s = Vector4_scale(world_dir, t);
-        struct Vector4 hit = Vector4_add(world_near, s);
-        printf("hit: %f %f %f %f\n", hit.x, hit.y, hit.z, t);
-        struct Vector4 grid = Vector4_subtract(hit, core.grid.origin);
-        uint32_t x = (uint32_t)grid.x;
-        uint32_t y = (uint32_t)grid.y;
-        uint32_t z = (uint32_t)grid.z;
-        if (x < core.grid.size_x && y < core.grid.size_y &&
-            z < core.grid.size_z) {
-          grid_set(&core.grid, x, y, z, GRID_ORANGE);
-        }
-      }
+    // the near and far plane under the mouse, back in world space
+    struct Vector4 ray[2] = {
+        Vector4_new_point(core.input.mouse_pos.x, core.input.mouse_pos.y, -1.f),
+        Vector4_new_point(core.input.mouse_pos.x, core.input.mouse_pos.y, 1.f)};
+    Matrix4_project_array(&ivp, ray, ray, 2);
+    struct Vector4 world_near = ray[0];
+    struct Vector4 world_dir = Vector4_subtract(ray[1], world_near);
+
+    struct GridRayHit hit;
+    if (grid_raycast(&core.grid, world_near, world_dir,
+                     Vector4_magnitude(world_dir), &hit)) {
+      grid_set(&core.grid, hit.x, hit.y, hit.z, GRID_ORANGE);
     }
   }
 
+  // remesh whatever the edits above touched
+  PROFILE_BEGIN("voxel update");
+  voxel_renderer_update(&core.voxels, &core.grid);
+  PROFILE_END();
+
   // render the scene
-  shader_bind(&core.graphics.basic_lighting);
-  shader_set_matrix_uniform(core.graphics.basic_lighting_view_proj, &vp);
-  shader_set_vector_uniform(core.graphics.basic_lighting_ambient_color,
-                            &core.world.ambient_color);
-  shader_set_vector_uniform(core.graphics.basic_lighting_ambient_dir,
-                            &core.world.ambient_dir);
-  shader_set_vector_uniform(core.graphics.basic_lighting_light_pos,
-                            &core.world.point_light_pos);
-  shader_set_vector_uniform(core.graphics.basic_lighting_light_color,
-                            &core.world.point_light_color);
-  shader_set_vector_uniform(core.graphics.basic_lighting_camera_eye,
-                            &core.world.camera_eye);
-  shader_set_vector_uniform(core.graphics.basic_lighting_fog_color,
-                            &core.world.fog_color);
-  struct Vector4 fog_props =
-      Vector4_new_vector(core.world.fog_start, core.world.fog_end, 0.f);
-  shader_set_vector_uniform(core.graphics.basic_lighting_fog_props, &fog_props);
-
-  mesh_bind(&core.graphics.cube);
-
-  for (uint32_t z = 0; z < core.grid.size_z; ++z) {
-    for (uint32_t y = 0; y < core.grid.size_y; ++y) {
-      for (uint32_t x = 0; x < core.grid.size_x; ++x) {
-        char voxel = grid_get(&core.grid, x, y, z);
-        if (voxel != 0) {
-          struct Matrix4 model = Matrix4_translation(core.grid.origin.x + x,
-                                                     core.grid.origin.y + y,
-                                                     core.grid.origin.z + z);
-          shader_set_matrix_uniform(core.graphics.basic_lighting_model, &model);
-          shader_set_vector_uniform(core.graphics.basic_lighting_color,
-                                    &core.grid.color_palette[(int)voxel]);
-          glDrawArrays(GL_TRIANGLES, 0, CUBE_TRIGANGLE_COUNT);
-        }
+  PROFILE_BEGIN("draw");
+  update_frame_data(&vp);
+  update_palette();
+
+  gpu_timer_begin(&core.gpu_timer, "gpu voxels");
+  if (core.voxels.format == MESH_FORMAT_FACES) {
+    shader_bind(&core.graphics.voxel_pull);
+    voxel_renderer_draw(&core.voxels, &core.grid, &vp,
+                        core.graphics.voxel_pull_model);
+  } else {
+    shader_bind(&core.graphics.basic_lighting);
+    voxel_renderer_draw(&core.voxels, &core.grid, &vp,
+                        core.graphics.basic_lighting_model);
+  }
+
+  if (core.props.instance_count > 0) {
+    shader_bind(&core.graphics.basic_instanced);
+    instanced_mesh_draw(&core.props);
+  }
+  gpu_timer_end(&core.gpu_timer);
+
+  // update debug, the overlay depends on timing so benchmark images skip it
+  if (core.options.bench_frames == 0)
+    debug_add_profiler(&core.debug, &ivp);
+  gpu_timer_begin(&core.gpu_timer, "gpu debug lines");
+  debug_update(&core.debug);
+  gpu_timer_end(&core.gpu_timer);
+  gpu_timer_end_frame(&core.gpu_timer);
+  PROFILE_END();
+
+  PROFILE_BEGIN("swap");
+  graphics_context_present(&core.graphics);
+  PROFILE_END();
+  profiler_frame();
+}
+
+// rolling hills, big enough that meshing, culling and fill rate all show up.
+static void fill_bench_scene(struct Grid *grid) {
+  for (uint32_t z = 0; z < grid->size_z; ++z) {
+    for (uint32_t x = 0; x < grid->size_x; ++x) {
+      float h = 0.4f + 0.25f * sinf(x * 0.11f) * cosf(z * 0.07f) +
+                0.1f * sinf((x + z) * 0.31f);
+      uint32_t height = (uint32_t)(h * grid->size_y);
+      for (uint32_t y = 0; y < height && y < grid->size_y; ++y) {
+        char color = GRID_TAN;
+        if (y + 1 == height)
+          color = GRID_GREEN;
+        else if (y + 4 > height)
+          color = GRID_BEIGE;
+        grid_set(grid, x, y, z, color);
       }
     }
   }
+}
 
-  // update debug
-  debug_add_aabb(&core.debug, Vector4_new_point(0.f, 0.f, 0.f),
-                 Vector4_new_vector(2.5f, 2.5f, 2.5f), RED);
-  debug_update(&core.debug, &vp);
+static int compare_double(void const *a, void const *b) {
+  double da = *(double const *)a;
+  double db = *(double const *)b;
+  return (da > db) - (da < db);
+}
+
+static bool write_frame_png(uint32_t frame) {
+  size_t size = (size_t)core.graphics.width * core.graphics.height * 4;
+  uint8_t *pixels = (uint8_t *)malloc(size);
+  if (pixels == NULL) {
+    printf("Failed to allocate %zu bytes for a screenshot\n", size);
+    return false;
+  }
+  graphics_context_read_pixels(&core.graphics, pixels);
+  char path[1024];
+  snprintf(path, sizeof(path), "%s_%04u.png", core.options.png_prefix, frame);
+  bool ok = png_write_rgba(path, pixels, core.graphics.width,
+                           core.graphics.height);
+  free(pixels);
+  return ok;
+}
 
-  SDL_GL_SwapWindow(core.graphics.window);
+// a 3x3x3 block toggled in a different spot every frame, then frames until
+// every edited chunk is back on the GPU. prints what the uploads cost, runs
+// after the timed frames so the images don't change.
+static bool run_edit_benchmark(void) {
+  uint32_t chunks = 0;
+  size_t bytes = 0;
+  uint64_t upload_ns = 0;
+  uint32_t frames = 0;
+  uint32_t seed = 1;
+  for (; frames < BENCH_EDIT_FRAMES ||
+         core.voxels.queue.in_flight_count > 0 ||
+         core.voxels.queue.chunks_dispatched > 0;
+       ++frames) {
+    if (frames < BENCH_EDIT_FRAMES) {
+      seed = seed * 1664525u + 1013904223u;
+      uint32_t x = (seed >> 8) % (core.grid.size_x - 2);
+      uint32_t z = (seed >> 20) % (core.grid.size_z - 2);
+      uint32_t y = core.grid.size_y / 3;
+      char value = frames % 2 ? GRID_EMPTY : GRID_ORANGE;
+      for (uint32_t i = 0; i < 27; ++i) {
+        grid_set(&core.grid, x + i % 3, y + i / 3 % 3, z + i / 9, value);
+      }
+    }
+    mainloop();
+    chunks += core.voxels.chunks_remeshed;
+    bytes += core.voxels.bytes_uploaded;
+    upload_ns += core.voxels.upload_ns;
+    if (frames > BENCH_MAX_WARMUP_FRAMES) {
+      printf("Edited chunks never finished uploading\n");
+      return false;
+    }
+  }
+  printf("edits: %u chunks uploaded over %u frames, %.1f KiB, %.3f ms of "
+         "upload calls, %.1f us per chunk\n",
+         chunks, frames, bytes / 1024.0, upload_ns / 1e6,
+         chunks > 0 ? upload_ns / 1e3 / chunks : 0.0);
+  return true;
+}
+
+// renders the fixed camera scene once everything is meshed and prints frame
+// time statistics. in headless mode a frame ends with glFinish, so the times
+// include the GPU.
+static bool run_benchmark(void) {
+  uint32_t warmup = 0;
+  do {
+    mainloop();
+    ++warmup;
+  } while ((core.voxels.queue.in_flight_count > 0 ||
+            core.voxels.queue.chunks_dispatched > 0) &&
+           warmup < BENCH_MAX_WARMUP_FRAMES);
+
+  uint32_t frame_count = core.options.bench_frames;
+  double *frames = (double *)malloc(frame_count * sizeof(double));
+  if (frames == NULL) {
+    printf("Failed to allocate benchmark frames\n");
+    return false;
+  }
+  float gpu_ms[GPU_TIMER_MAX_PASSES] = {0};
+  uint32_t gpu_frames = 0;
+  double frequency = (double)SDL_GetPerformanceFrequency();
+  bool ok = true;
+  for (uint32_t i = 0; i < frame_count; ++i) {
+    uint64_t start = SDL_GetPerformanceCounter();
+    mainloop();
+    frames[i] = (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency;
+
+    if (core.gpu_timer.pass_count > 0) {
+      for (uint32_t p = 0; p < core.gpu_timer.pass_count; ++p) {
+        gpu_ms[p] += core.gpu_timer.pass_ms[p];
+      }
+      ++gpu_frames;
+    }
+
+    bool last = i + 1 == frame_count;
+    uint32_t every = core.options.png_every;
+    if (core.options.png_prefix != NULL &&
+        (every > 0 ? i % every == 0 : last)) {
+      ok = write_frame_png(i) && ok;
+    }
+  }
+
+  double total = 0.0;
+  for (uint32_t i = 0; i < frame_count; ++i) {
+    total += frames[i];
+  }
+  qsort(frames, frame_count, sizeof(double), compare_double);
+  printf("benchmark %ux%u%s, %u frames after %u warmup frames\n",
+         core.graphics.width, core.graphics.height,
+         core.graphics.framebuffer != 0 ? " headless" : "", frame_count,
+         warmup);
+  printf("frame ms: mean %.3f  p50 %.3f  p95 %.3f  p99 %.3f  max %.3f\n",
+         total / frame_count, frames[frame_count / 2],
+         frames[frame_count * 95 / 100], frames[frame_count * 99 / 100],
+         frames[frame_count - 1]);
+  for (uint32_t p = 0; gpu_frames > 0 && p < core.gpu_timer.pass_count; ++p) {
+    printf("%-16s %.3f ms\n", core.gpu_timer.pass_names[p],
+           gpu_ms[p] / gpu_frames);
+  }
+  printf("chunks drawn %u of %u, %.2f MiB of voxel %s\n",
+         core.voxels.chunks_tested - core.voxels.chunks_culled,
+         core.voxels.chunks_tested,
+         core.voxels.vertex_bytes / (1024.0 * 1024.0),
+         core.voxels.format == MESH_FORMAT_FACES ? "face words" : "vertices");
+  free(frames);
+  return ok && run_edit_benchmark();
+}
+
+static void print_usage(char const *name) {
+  printf("usage: %s [--hz rate] [--headless] [--bench frames] "
+         "[--png prefix] [--png-every frames] [--level file] "
+         "[--save-level file] [--vertex-pulling]\n",
+         name);
+}
+
+static bool parse_options(int argc, char **argv, struct Options *options) {
+  *options = (struct Options){.sim_hz = TIMESTEP_DEFAULT_HZ};
+  for (int i = 1; i < argc; ++i) {
+    bool has_value = i + 1 < argc;
+    if (strcmp(argv[i], "--hz") == 0 && has_value) {
+      options->sim_hz = (uint32_t)atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--headless") == 0) {
+      options->headless = true;
+    } else if (strcmp(argv[i], "--bench") == 0 && has_value) {
+      options->bench_frames = (uint32_t)atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--png") == 0 && has_value) {
+      options->png_prefix = argv[++i];
+    } else if (strcmp(argv[i], "--png-every") == 0 && has_value) {
+      options->png_every = (uint32_t)atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--level") == 0 && has_value) {
+      options->level_path = argv[++i];
+    } else if (strcmp(argv[i], "--save-level") == 0 && has_value) {
+      options->save_level_path = argv[++i];
+    } else if (strcmp(argv[i], "--vertex-pulling") == 0) {
+      options->vertex_pulling = true;
+    } else {
+      print_usage(argv[0]);
+      return false;
+    }
+  }
+  return true;
 }
 
 int main(int argc, char **argv) {
-  UNREFERENCED_PARAMETER(argc);
-  UNREFERENCED_PARAMETER(argv);
   int exit_code = EXIT_SUCCESS;
+  if (!parse_options(argc, argv, &core.options))
+    return EXIT_FAILURE;
+  bool bench = core.options.bench_frames > 0;
+
+  // no display needed, SDL renders through EGL. an SDL_VIDEODRIVER set by
+  // the caller wins.
+  if (core.options.headless)
+    SDL_setenv("SDL_VIDEODRIVER", "offscreen", 0);
 
   if (SDL_Init(SDL_INIT_VIDEO) < 0) {
     printf("Could not initialize SDL! SDL_Error: %s\n", SDL_GetError());
     return EXIT_FAILURE;
   }
 
-  if (!graphics_context_new(&core.graphics)) {
+  if (!profiler_init()) {
+    exit_code = EXIT_FAILURE;
+    goto cleanup;
+  }
+
+  struct GraphicsConfig graphics_config = graphics_config_default();
+  graphics_config.headless = core.options.headless;
+  if (!graphics_context_new(&core.graphics, &graphics_config)) {
     printf("Failed to initialize graphics\n");
     exit_code = EXIT_FAILURE;
     goto cleanup;
   }
 
-  int grid_size = 20;
-  core.grid =
-      grid_new(grid_size, 10, grid_size,
-               Vector4_new_point(-grid_size / 2.f, 0.0, -grid_size / 2.f));
-  for (int i = 0; i < grid_size; ++i) {
-    int counter = i % 2;
-    for (int j = 0; j < grid_size; ++j, ++counter) {
-      grid_set(&core.grid, i, 0, j, counter % 2 + 1);
+  core.gpu_timer = gpu_timer_new();
+
+  if (!file_io_new(&core.io)) {
+    exit_code = EXIT_FAILURE;
+    goto cleanup;
+  }
+
+  // the game starts on the built in scene while the level streams in,
+  // benchmarks need it before the first frame
+  if (core.options.level_path != NULL && bench) {
+    if (!level_load(&core.grid, &core.level_map, core.options.level_path)) {
+      exit_code = EXIT_FAILURE;
+      goto cleanup;
+    }
+  } else if (bench) {
+    core.grid = grid_new(128, 32, 128, Vector4_new_point(-64.f, -8.f, -64.f));
+    fill_bench_scene(&core.grid);
+  } else {
+    int grid_size = 20;
+    core.grid =
+        grid_new(grid_size, 10, grid_size,
+                 Vector4_new_point(-grid_size / 2.f, 0.0, -grid_size / 2.f));
+    for (int i = 0; i < grid_size; ++i) {
+      int counter = i % 2;
+      for (int j = 0; j < grid_size; ++j, ++counter) {
+        grid_set(&core.grid, i, 0, j, counter % 2 + 1);
+      }
     }
   }
+  if (core.options.save_level_path != NULL &&
+      !level_save(&core.grid, core.options.save_level_path, true)) {
+    exit_code = EXIT_FAILURE;
+    goto cleanup;
+  }
+
+  // the main thread works too, so one worker per remaining core
+  int cpu_count = SDL_GetCPUCount();
+  if (!jobs_new(&core.jobs, cpu_count > 1 ? (uint32_t)cpu_count - 1 : 0)) {
+    exit_code = EXIT_FAILURE;
+    goto cleanup;
+  }
+
+  core.voxels = voxel_renderer_new(&core.grid, &core.jobs, voxel_format());
+  core.props = instanced_mesh_new(&core.graphics.cube, CUBE_TRIGANGLE_COUNT);
+  set_texture_units();
+
+  if (core.options.level_path != NULL && !bench) {
+    struct FileReadDesc desc = {.path = core.options.level_path,
+                                .on_done = level_loaded,
+                                .user = (void *)core.options.level_path};
+    if (file_io_read(&core.io, &desc) == 0)
+      printf("Could not queue level %s\n", core.options.level_path);
+  }
 
   core.world.ambient_dir = Vector4_new_vector(-0.2f, -0.8f, 0.2f);
   core.world.ambient_color = Vector4_new_vector(0.2f, 0.2f, 0.2f);
@@ -221,10 +674,35 @@ int main(int argc, char **argv) {
   core.world.fog_end = 30.f;
   core.world.camera_eye = Vector4_new_point(10.f, 10.f, 10.f);
   core.world.camera_target = Vector4_new_point(0.f, 0.f, 0.f);
+  if (bench) {
+    core.world.fog_start = 40.f;
+    core.world.fog_end = 90.f;
+    core.world.camera_eye = Vector4_new_point(30.f, 24.f, 30.f);
+  }
+  core.world.dirty = true;
+
+  core.sim.camera_eye = core.world.camera_eye;
+  core.sim.camera_target = core.world.camera_target;
+  simulate(&core.sim, 0.f);
+  core.sim_prev = core.sim;
+  core.fixed_clock = bench;
+  core.clock = bench ? 0 : SDL_GetPerformanceCounter();
+  core.timestep = timestep_new(core.options.sim_hz,
+                               SDL_GetPerformanceFrequency(), core.clock);
 
   core.debug = debug_new();
+  debug_begin_static(&core.debug);
+  debug_add_aabb(&core.debug, Vector4_new_point(0.f, 0.f, 0.f),
+                 Vector4_new_vector(2.5f, 2.5f, 2.5f), RED);
+  debug_end_static(&core.debug);
   core.input = input_new();
 
+  if (bench) {
+    if (!run_benchmark())
+      exit_code = EXIT_FAILURE;
+    goto cleanup;
+  }
+
 #ifdef __EMSCRIPTEN__
   emscripten_set_main_loop(mainloop, 0, 1);
 #else
@@ -235,7 +713,16 @@ int main(int argc, char **argv) {
 #endif
 
 cleanup:
-  SDL_DestroyWindow(core.graphics.window);
+  // mesh jobs still in flight point into the renderer
+  voxel_renderer_free(&core.voxels);
+  grid_free(&core.grid);
+  file_unmap(&core.level_map);
+  gpu_timer_free(&core.gpu_timer);
+  jobs_free(&core.jobs);
+  // io threads record profiler zones too, join them before it goes away
+  file_io_free(&core.io);
+  profiler_shutdown();
+  graphics_context_free(&core.graphics);
   SDL_Quit();
   return exit_code;
 }
@@ -1,4 +1,5 @@
 #include "math/matrix4.h"
+#include "math/simd.h"
 #include "math/vector4.h"
 
 #include <math.h>
@@ -37,6 +38,42 @@ struct Matrix4 Matrix4_frustum(float left, float right, float bottom, float top,
   return r;
 }
 
+void Matrix4_frustum_planes(struct Matrix4 const *m, struct Vector4 planes[6]) {
+  struct Vector4 r1 = Matrix4_get_row1(m);
+  struct Vector4 r2 = Matrix4_get_row2(m);
+  struct Vector4 r3 = Matrix4_get_row3(m);
+  struct Vector4 r4 = Matrix4_get_row4(m);
+
+  planes[0] = Vector4_add(r4, r1);
+  planes[1] = Vector4_subtract(r4, r1);
+  planes[2] = Vector4_add(r4, r2);
+  planes[3] = Vector4_subtract(r4, r2);
+  planes[4] = Vector4_add(r4, r3);
+  planes[5] = Vector4_subtract(r4, r3);
+
+  for (int i = 0; i < 6; ++i) {
+    struct Vector4 *p = &planes[i];
+    float length = sqrtf(p->x * p->x + p->y * p->y + p->z * p->z);
+    if (length > 0.f) {
+      *p = Vector4_scale(*p, 1.f / length);
+    }
+  }
+}
+
+bool Matrix4_frustum_intersects_aabb(struct Vector4 const planes[6],
+                                     struct Vector4 min, struct Vector4 max) {
+  for (int i = 0; i < 6; ++i) {
+    struct Vector4 const *p = &planes[i];
+    // the corner furthest along the plane normal
+    float x = p->x >= 0.f ? max.x : min.x;
+    float y = p->y >= 0.f ? max.y : min.y;
+    float z = p->z >= 0.f ? max.z : min.z;
+    if (p->x * x + p->y * y + p->z * z + p->w < 0.f)
+      return false;
+  }
+  return true;
+}
+
 struct Vector4 Matrix4_get_column1(struct Matrix4 const *m) {
   return (struct Vector4){m->f11, m->f12, m->f13, m->f14};
 }
@@ -99,7 +136,7 @@ then there's an easily-derivable direct formula, which is
 impl 3 is from here:
 https://stackoverflow.com/questions/1148309/inverting-a-4x4-matrix
 */
-struct Matrix4 Matrix4_invert(struct Matrix4 const *m) {
+struct Matrix4 Matrix4_invert_scalar(struct Matrix4 const *m) {
 
   // Implementation 3
   float inv[16], det;
@@ -242,6 +279,96 @@ struct Matrix4 Matrix4_invert(struct Matrix4 const *m) {
   */
 }
 
+#if MATH_SIMD
+// 2x2 matrices packed as (m00, m01, m10, m11).
+// a * b
+static simd4f mat2_mul(simd4f a, simd4f b) {
+  return simd4f_add(
+      simd4f_mul(a, simd4f_swizzle(b, 0, 3, 0, 3)),
+      simd4f_mul(simd4f_swizzle(a, 1, 0, 3, 2), simd4f_swizzle(b, 2, 1, 2, 1)));
+}
+
+// adj(a) * b
+static simd4f mat2_adj_mul(simd4f a, simd4f b) {
+  return simd4f_sub(
+      simd4f_mul(simd4f_swizzle(a, 3, 3, 0, 0), b),
+      simd4f_mul(simd4f_swizzle(a, 1, 1, 2, 2), simd4f_swizzle(b, 2, 3, 0, 1)));
+}
+
+// a * adj(b)
+static simd4f mat2_mul_adj(simd4f a, simd4f b) {
+  return simd4f_sub(
+      simd4f_mul(a, simd4f_swizzle(b, 3, 0, 3, 0)),
+      simd4f_mul(simd4f_swizzle(a, 1, 0, 3, 2), simd4f_swizzle(b, 2, 1, 2, 1)));
+}
+
+// Block inverse from:
+// https://lxjk.github.io/2017/09/03/Fast-4x4-Matrix-Inverse-with-SSE-SIMD-Explained.html
+// The math is written for rows, but inv(transpose(M)) == transpose(inv(M)) so
+// it works on our columns unchanged.
+struct Matrix4 Matrix4_invert(struct Matrix4 const *m) {
+  simd4f c1 = simd4f_load(m->f + 0);
+  simd4f c2 = simd4f_load(m->f + 4);
+  simd4f c3 = simd4f_load(m->f + 8);
+  simd4f c4 = simd4f_load(m->f + 12);
+
+  // M = | A B |
+  //     | C D |
+  simd4f a = simd4f_shuffle(c1, c2, 0, 1, 0, 1);
+  simd4f b = simd4f_shuffle(c1, c2, 2, 3, 2, 3);
+  simd4f c = simd4f_shuffle(c3, c4, 0, 1, 0, 1);
+  simd4f d = simd4f_shuffle(c3, c4, 2, 3, 2, 3);
+
+  // (|A|, |B|, |C|, |D|)
+  simd4f det_sub = simd4f_sub(
+      simd4f_mul(simd4f_shuffle(c1, c3, 0, 2, 0, 2),
+                 simd4f_shuffle(c2, c4, 1, 3, 1, 3)),
+      simd4f_mul(simd4f_shuffle(c1, c3, 1, 3, 1, 3),
+                 simd4f_shuffle(c2, c4, 0, 2, 0, 2)));
+  simd4f det_a = simd4f_lane(det_sub, 0);
+  simd4f det_b = simd4f_lane(det_sub, 1);
+  simd4f det_c = simd4f_lane(det_sub, 2);
+  simd4f det_d = simd4f_lane(det_sub, 3);
+
+  simd4f d_c = mat2_adj_mul(d, c);
+  simd4f a_b = mat2_adj_mul(a, b);
+  simd4f x = simd4f_sub(simd4f_mul(det_d, a), mat2_mul(b, d_c));
+  simd4f w = simd4f_sub(simd4f_mul(det_a, d), mat2_mul(c, a_b));
+  simd4f y = simd4f_sub(simd4f_mul(det_b, c), mat2_mul_adj(d, a_b));
+  simd4f z = simd4f_sub(simd4f_mul(det_c, b), mat2_mul_adj(a, d_c));
+
+  // |M| = |A||D| + |B||C| - tr(adj(A)B adj(D)C)
+  simd4f tr = simd4f_mul(a_b, simd4f_swizzle(d_c, 0, 2, 1, 3));
+  tr = simd4f_add(tr, simd4f_swizzle(tr, 2, 3, 0, 1));
+  tr = simd4f_add(tr, simd4f_swizzle(tr, 1, 0, 3, 2));
+  simd4f det = simd4f_sub(
+      simd4f_add(simd4f_mul(det_a, det_d), simd4f_mul(det_b, det_c)), tr);
+
+  if (simd4f_first(det) == 0.f) {
+    printf("Unable to invert matrix\n");
+    exit(1);
+  }
+
+  simd4f inv_det = simd4f_div(simd4f_set(1.f, -1.f, -1.f, 1.f), det);
+  x = simd4f_mul(x, inv_det);
+  y = simd4f_mul(y, inv_det);
+  z = simd4f_mul(z, inv_det);
+  w = simd4f_mul(w, inv_det);
+
+  // the adjugate swizzle is folded into the store
+  struct Matrix4 r;
+  simd4f_store(r.f + 0, simd4f_shuffle(x, y, 3, 1, 3, 1));
+  simd4f_store(r.f + 4, simd4f_shuffle(x, y, 2, 0, 2, 0));
+  simd4f_store(r.f + 8, simd4f_shuffle(z, w, 3, 1, 3, 1));
+  simd4f_store(r.f + 12, simd4f_shuffle(z, w, 2, 0, 2, 0));
+  return r;
+}
+#else
+struct Matrix4 Matrix4_invert(struct Matrix4 const *m) {
+  return Matrix4_invert_scalar(m);
+}
+#endif
+
 struct Matrix4 Matrix4_lookat(struct Vector4 eye, struct Vector4 target,
                               struct Vector4 up) {
   struct Vector4 f = Vector4_subtract(target, eye);
@@ -269,8 +396,8 @@ struct Matrix4 Matrix4_lookat(struct Vector4 eye, struct Vector4 target,
   return r;
 }
 
-struct Matrix4 Matrix4_multiply(struct Matrix4 const *a,
-                                struct Matrix4 const *b) {
+struct Matrix4 Matrix4_multiply_scalar(struct Matrix4 const *a,
+                                       struct Matrix4 const *b) {
   struct Matrix4 m;
 
   /* I think this is wrong becuase I goofed the memory ordering
@@ -320,6 +447,34 @@ struct Matrix4 Matrix4_multiply(struct Matrix4 const *a,
   return m;
 }
 
+#if MATH_SIMD
+// columns are contiguous, so each result column is a weighted sum of the
+// columns of a. the additions happen in the same order as the scalar code.
+struct Matrix4 Matrix4_multiply(struct Matrix4 const *a,
+                                struct Matrix4 const *b) {
+  simd4f a1 = simd4f_load(a->f + 0);
+  simd4f a2 = simd4f_load(a->f + 4);
+  simd4f a3 = simd4f_load(a->f + 8);
+  simd4f a4 = simd4f_load(a->f + 12);
+
+  struct Matrix4 m;
+  for (int i = 0; i < 16; i += 4) {
+    simd4f c = simd4f_load(b->f + i);
+    simd4f r = simd4f_mul(a1, simd4f_lane(c, 0));
+    r = simd4f_add(r, simd4f_mul(a2, simd4f_lane(c, 1)));
+    r = simd4f_add(r, simd4f_mul(a3, simd4f_lane(c, 2)));
+    r = simd4f_add(r, simd4f_mul(a4, simd4f_lane(c, 3)));
+    simd4f_store(m.f + i, r);
+  }
+  return m;
+}
+#else
+struct Matrix4 Matrix4_multiply(struct Matrix4 const *a,
+                                struct Matrix4 const *b) {
+  return Matrix4_multiply_scalar(a, b);
+}
+#endif
+
 struct Matrix4 Matrix4_orthographic(float left, float right, float bottom,
                                     float top) {
   return Matrix4_orthographic_nf(left, right, bottom, top, -1.f, 1.f);
@@ -354,6 +509,103 @@ struct Matrix4 Matrix4_perspective(float fovy, float aspect_ratio, float near,
   return r;
 }
 
+// shared by the array transforms and projections. divide is a constant at
+// every call site so the branch folds away once this is inlined.
+static inline void matrix4_array(struct Matrix4 const *m,
+                                 struct Vector4 const *in, struct Vector4 *out,
+                                 size_t count, bool divide) {
+#if MATH_SIMD
+  // the columns stay in registers for the whole array
+  simd4f c1 = simd4f_load(m->f + 0);
+  simd4f c2 = simd4f_load(m->f + 4);
+  simd4f c3 = simd4f_load(m->f + 8);
+  simd4f c4 = simd4f_load(m->f + 12);
+  for (size_t i = 0; i < count; ++i) {
+    simd4f v = simd4f_load(&in[i].x);
+    simd4f r = simd4f_mul(c1, simd4f_lane(v, 0));
+    r = simd4f_add(r, simd4f_mul(c2, simd4f_lane(v, 1)));
+    r = simd4f_add(r, simd4f_mul(c3, simd4f_lane(v, 2)));
+    r = simd4f_add(r, simd4f_mul(c4, simd4f_lane(v, 3)));
+    if (divide) {
+      r = simd4f_mul(r, simd4f_div(simd4f_splat(1.f), simd4f_lane(r, 3)));
+    }
+    simd4f_store(&out[i].x, r);
+  }
+#else
+  for (size_t i = 0; i < count; ++i) {
+    struct Vector4 r = Matrix4_transform_scalar(m, in[i]);
+    out[i] = divide ? Vector4_scale_scalar(r, 1.f / r.w) : r;
+  }
+#endif
+}
+
+void Matrix4_project_array(struct Matrix4 const *m, struct Vector4 const *in,
+                           struct Vector4 *out, size_t count) {
+  matrix4_array(m, in, out, count, true);
+}
+
+static inline void matrix4_points_soa(struct Matrix4 const *m, float const *x,
+                                      float const *y, float const *z,
+                                      float *out_x, float *out_y, float *out_z,
+                                      size_t count, bool divide) {
+  size_t i = 0;
+#if MATH_SIMD
+  simd4f m11 = simd4f_splat(m->f11), m21 = simd4f_splat(m->f21),
+         m31 = simd4f_splat(m->f31), m41 = simd4f_splat(m->f41);
+  simd4f m12 = simd4f_splat(m->f12), m22 = simd4f_splat(m->f22),
+         m32 = simd4f_splat(m->f32), m42 = simd4f_splat(m->f42);
+  simd4f m13 = simd4f_splat(m->f13), m23 = simd4f_splat(m->f23),
+         m33 = simd4f_splat(m->f33), m43 = simd4f_splat(m->f43);
+  simd4f m14 = simd4f_splat(m->f14), m24 = simd4f_splat(m->f24),
+         m34 = simd4f_splat(m->f34), m44 = simd4f_splat(m->f44);
+  for (; i + 4 <= count; i += 4) {
+    simd4f px = simd4f_load(x + i);
+    simd4f py = simd4f_load(y + i);
+    simd4f pz = simd4f_load(z + i);
+    simd4f rx = simd4f_add(simd4f_add(simd4f_mul(m11, px), simd4f_mul(m21, py)),
+                           simd4f_add(simd4f_mul(m31, pz), m41));
+    simd4f ry = simd4f_add(simd4f_add(simd4f_mul(m12, px), simd4f_mul(m22, py)),
+                           simd4f_add(simd4f_mul(m32, pz), m42));
+    simd4f rz = simd4f_add(simd4f_add(simd4f_mul(m13, px), simd4f_mul(m23, py)),
+                           simd4f_add(simd4f_mul(m33, pz), m43));
+    if (divide) {
+      simd4f rw =
+          simd4f_add(simd4f_add(simd4f_mul(m14, px), simd4f_mul(m24, py)),
+                     simd4f_add(simd4f_mul(m34, pz), m44));
+      simd4f inv_w = simd4f_div(simd4f_splat(1.f), rw);
+      rx = simd4f_mul(rx, inv_w);
+      ry = simd4f_mul(ry, inv_w);
+      rz = simd4f_mul(rz, inv_w);
+    }
+    simd4f_store(out_x + i, rx);
+    simd4f_store(out_y + i, ry);
+    simd4f_store(out_z + i, rz);
+  }
+#endif
+  for (; i < count; ++i) {
+    float px = x[i], py = y[i], pz = z[i];
+    float rx = (m->f11 * px + m->f21 * py) + (m->f31 * pz + m->f41);
+    float ry = (m->f12 * px + m->f22 * py) + (m->f32 * pz + m->f42);
+    float rz = (m->f13 * px + m->f23 * py) + (m->f33 * pz + m->f43);
+    if (divide) {
+      float inv_w =
+          1.f / ((m->f14 * px + m->f24 * py) + (m->f34 * pz + m->f44));
+      rx *= inv_w;
+      ry *= inv_w;
+      rz *= inv_w;
+    }
+    out_x[i] = rx;
+    out_y[i] = ry;
+    out_z[i] = rz;
+  }
+}
+
+void Matrix4_project_points_soa(struct Matrix4 const *m, float const *x,
+                                float const *y, float const *z, float *out_x,
+                                float *out_y, float *out_z, size_t count) {
+  matrix4_points_soa(m, x, y, z, out_x, out_y, out_z, count, true);
+}
+
 struct Matrix4 Matrix4_rotation_x(float angle) {
   struct Matrix4 r = Matrix4_identity();
 
@@ -453,7 +705,8 @@ struct Matrix4 Matrix4_scale(float x, float y, float z) {
   return m;
 }
 
-struct Vector4 Matrix4_transform(struct Matrix4 const *m, struct Vector4 v) {
+struct Vector4 Matrix4_transform_scalar(struct Matrix4 const *m,
+                                        struct Vector4 v) {
   struct Vector4 r;
 
   r.x = m->f11 * v.x + m->f21 * v.y + m->f31 * v.z + m->f41 * v.w;
@@ -464,6 +717,35 @@ struct Vector4 Matrix4_transform(struct Matrix4 const *m, struct Vector4 v) {
   return r;
 }
 
+#if MATH_SIMD
+struct Vector4 Matrix4_transform(struct Matrix4 const *m, struct Vector4 v) {
+  simd4f r = simd4f_mul(simd4f_load(m->f + 0), simd4f_splat(v.x));
+  r = simd4f_add(r, simd4f_mul(simd4f_load(m->f + 4), simd4f_splat(v.y)));
+  r = simd4f_add(r, simd4f_mul(simd4f_load(m->f + 8), simd4f_splat(v.z)));
+  r = simd4f_add(r, simd4f_mul(simd4f_load(m->f + 12), simd4f_splat(v.w)));
+
+  struct Vector4 result;
+  simd4f_store(&result.x, r);
+  return result;
+}
+#else
+struct Vector4 Matrix4_transform(struct Matrix4 const *m, struct Vector4 v) {
+  return Matrix4_transform_scalar(m, v);
+}
+#endif
+
+void Matrix4_transform_array(struct Matrix4 const *m, struct Vector4 const *in,
+                             struct Vector4 *out, size_t count) {
+  matrix4_array(m, in, out, count, false);
+}
+
+void Matrix4_transform_points_soa(struct Matrix4 const *m, float const *x,
+                                  float const *y, float const *z,
+                                  float *out_x, float *out_y, float *out_z,
+                                  size_t count) {
+  matrix4_points_soa(m, x, y, z, out_x, out_y, out_z, count, false);
+}
+
 struct Matrix4 Matrix4_translation(float x, float y, float z) {
   struct Matrix4 m = Matrix4_identity();
 
@@ -1,4 +1,5 @@
 #include "math/vector4.h"
+#include "math/simd.h"
 
 #include <math.h>
 
@@ -77,22 +78,70 @@ struct Vector4 Vector4_cross(struct Vector4 a, struct Vector4 b) {
                           a.x * b.y - a.y * b.x, 0.0f};
 }
 
-struct Vector4 Vector4_lerp(struct Vector4 a, struct Vector4 b, float t) {
+struct Vector4 Vector4_lerp_scalar(struct Vector4 a, struct Vector4 b,
+                                  float t) {
   // a + (b - a) * t
   // potentially switch this for precise lerp later.
-  struct Vector4 difference = Vector4_subtract(b, a);
-  struct Vector4 scaled = Vector4_scale(difference, t);
-  return Vector4_add(a, scaled);
+  struct Vector4 difference = Vector4_subtract_scalar(b, a);
+  struct Vector4 scaled = Vector4_scale_scalar(difference, t);
+  return Vector4_add_scalar(a, scaled);
 }
 
-struct Vector4 Vector4_add(struct Vector4 a, struct Vector4 b) {
+struct Vector4 Vector4_add_scalar(struct Vector4 a, struct Vector4 b) {
   return (struct Vector4){a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w};
 }
 
-struct Vector4 Vector4_subtract(struct Vector4 a, struct Vector4 b) {
+struct Vector4 Vector4_subtract_scalar(struct Vector4 a, struct Vector4 b) {
   return (struct Vector4){a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w};
 }
 
-struct Vector4 Vector4_scale(struct Vector4 v, float s) {
+struct Vector4 Vector4_scale_scalar(struct Vector4 v, float s) {
   return (struct Vector4){v.x * s, v.y * s, v.z * s, v.w * s};
 }
+
+#if MATH_SIMD
+static simd4f vector4_load(struct Vector4 const *v) {
+  return simd4f_load(&v->x);
+}
+
+static struct Vector4 vector4_store(simd4f a) {
+  struct Vector4 v;
+  simd4f_store(&v.x, a);
+  return v;
+}
+
+struct Vector4 Vector4_lerp(struct Vector4 a, struct Vector4 b, float t) {
+  simd4f va = vector4_load(&a);
+  simd4f difference = simd4f_sub(vector4_load(&b), va);
+  return vector4_store(
+      simd4f_add(va, simd4f_mul(difference, simd4f_splat(t))));
+}
+
+struct Vector4 Vector4_add(struct Vector4 a, struct Vector4 b) {
+  return vector4_store(simd4f_add(vector4_load(&a), vector4_load(&b)));
+}
+
+struct Vector4 Vector4_subtract(struct Vector4 a, struct Vector4 b) {
+  return vector4_store(simd4f_sub(vector4_load(&a), vector4_load(&b)));
+}
+
+struct Vector4 Vector4_scale(struct Vector4 v, float s) {
+  return vector4_store(simd4f_mul(vector4_load(&v), simd4f_splat(s)));
+}
+#else
+struct Vector4 Vector4_lerp(struct Vector4 a, struct Vector4 b, float t) {
+  return Vector4_lerp_scalar(a, b, t);
+}
+
+struct Vector4 Vector4_add(struct Vector4 a, struct Vector4 b) {
+  return Vector4_add_scalar(a, b);
+}
+
+struct Vector4 Vector4_subtract(struct Vector4 a, struct Vector4 b) {
+  return Vector4_subtract_scalar(a, b);
+}
+
+struct Vector4 Vector4_scale(struct Vector4 v, float s) {
+  return Vector4_scale_scalar(v, s);
+}
+#endif
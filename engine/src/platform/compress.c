@@ -0,0 +1,162 @@
+#include "platform/compress.h"
+
+#include <string.h>
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+#define LZ_HASH_BITS 12
+// the format ends with at least this many literals, and no match starts
+// within LZ_MATCH_LIMIT bytes of the end
+#define LZ_LAST_LITERALS 5
+#define LZ_MATCH_LIMIT 12
+
+static uint32_t lz_read32(uint8_t const *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static uint32_t lz_hash(uint32_t sequence) {
+  return (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+// a length nibble of 15 continues in bytes of 255 and a final remainder.
+static uint8_t *lz_write_length(uint8_t *op, uint8_t const *end,
+                                size_t length) {
+  for (; length >= 255; length -= 255) {
+    if (op >= end)
+      return NULL;
+    *op++ = 255;
+  }
+  if (op >= end)
+    return NULL;
+  *op++ = (uint8_t)length;
+  return op;
+}
+
+static uint8_t *lz_write_sequence(uint8_t *op, uint8_t const *end,
+                                  uint8_t const *literals, size_t literal_count,
+                                  size_t offset, size_t match_length) {
+  if (op >= end)
+    return NULL;
+  uint8_t *token = op++;
+  *token = (uint8_t)((literal_count < 15 ? literal_count : 15) << 4);
+  if (literal_count >= 15 &&
+      (op = lz_write_length(op, end, literal_count - 15)) == NULL)
+    return NULL;
+  if ((size_t)(end - op) < literal_count)
+    return NULL;
+  memcpy(op, literals, literal_count);
+  op += literal_count;
+
+  // the last sequence is literals only
+  if (match_length == 0)
+    return op;
+
+  if (end - op < 2)
+    return NULL;
+  *op++ = (uint8_t)offset;
+  *op++ = (uint8_t)(offset >> 8);
+  size_t extra = match_length - LZ_MIN_MATCH;
+  *token |= (uint8_t)(extra < 15 ? extra : 15);
+  if (extra >= 15 && (op = lz_write_length(op, end, extra - 15)) == NULL)
+    return NULL;
+  return op;
+}
+
+size_t lz_compress_bound(size_t size) { return size + size / 255 + 16; }
+
+size_t lz_compress(uint8_t const *src, size_t size, uint8_t *dst,
+                   size_t capacity) {
+  // positions plus one, zero means empty
+  uint32_t table[1 << LZ_HASH_BITS];
+  memset(table, 0, sizeof(table));
+
+  uint8_t *op = dst;
+  uint8_t const *end = dst + capacity;
+  size_t anchor = 0;
+  size_t ip = 0;
+  while (size >= LZ_MATCH_LIMIT && ip < size - LZ_MATCH_LIMIT) {
+    uint32_t sequence = lz_read32(src + ip);
+    uint32_t hash = lz_hash(sequence);
+    size_t candidate = table[hash];
+    table[hash] = (uint32_t)(ip + 1);
+    if (candidate == 0 || ip - (candidate - 1) > LZ_MAX_OFFSET ||
+        lz_read32(src + candidate - 1) != sequence) {
+      ++ip;
+      continue;
+    }
+
+    size_t ref = candidate - 1;
+    size_t length = LZ_MIN_MATCH;
+    while (ip + length < size - LZ_LAST_LITERALS &&
+           src[ref + length] == src[ip + length]) {
+      ++length;
+    }
+    op = lz_write_sequence(op, end, src + anchor, ip - anchor, ip - ref,
+                           length);
+    if (op == NULL)
+      return 0;
+    ip += length;
+    anchor = ip;
+  }
+
+  op = lz_write_sequence(op, end, src + anchor, size - anchor, 0, 0);
+  return op != NULL ? (size_t)(op - dst) : 0;
+}
+
+// false when the stream ends in the middle of a length.
+static bool lz_read_length(uint8_t const **ip, uint8_t const *end,
+                           size_t *length) {
+  uint8_t byte;
+  do {
+    if (*ip >= end)
+      return false;
+    byte = *(*ip)++;
+    *length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+bool lz_decompress(uint8_t const *src, size_t size, uint8_t *dst,
+                   size_t dst_size) {
+  uint8_t const *ip = src;
+  uint8_t const *end = src + size;
+  uint8_t *op = dst;
+  uint8_t *op_end = dst + dst_size;
+
+  while (ip < end) {
+    uint8_t token = *ip++;
+    size_t literal_count = token >> 4;
+    if (literal_count == 15 && !lz_read_length(&ip, end, &literal_count))
+      return false;
+    if ((size_t)(end - ip) < literal_count ||
+        (size_t)(op_end - op) < literal_count)
+      return false;
+    memcpy(op, ip, literal_count);
+    ip += literal_count;
+    op += literal_count;
+    if (ip == end)
+      break;
+
+    if (end - ip < 2)
+      return false;
+    size_t offset = ip[0] | ((size_t)ip[1] << 8);
+    ip += 2;
+    size_t length = token & 15;
+    if (length == 15 && !lz_read_length(&ip, end, &length))
+      return false;
+    length += LZ_MIN_MATCH;
+    if (offset == 0 || offset > (size_t)(op - dst) ||
+        (size_t)(op_end - op) < length)
+      return false;
+
+    // byte by byte, the match may overlap what it is writing
+    uint8_t const *match = op - offset;
+    for (size_t i = 0; i < length; ++i) {
+      op[i] = match[i];
+    }
+    op += length;
+  }
+  return op == op_end;
+}
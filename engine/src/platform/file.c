@@ -1,30 +1,68 @@
+// mmap, pread and friends under -std=c99
+#define _POSIX_C_SOURCE 200809L
+#define _DARWIN_C_SOURCE
+
 #include "platform/file.h"
 
+#include "core/profiler.h"
+
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if FILE_IO_THREADS
+#include <pthread.h>
+#endif
+
+#if !defined(__EMSCRIPTEN__) && !defined(_WIN32)
+#define FILE_MMAP 1
+#include <sys/mman.h>
+#else
+#define FILE_MMAP 0
+#endif
+
+// running from bin/ the assets are one directory up, so a path that doesn't
+// open is retried with a ../ prefix.
+static bool file_parent_path(char *out, size_t size, char const *path) {
+  int length = snprintf(out, size, "../%s", path);
+  return length > 0 && (size_t)length < size;
+}
+
+static FILE *file_open(char const *path) {
+  FILE *fp = fopen(path, "rb");
+  char parent[FILE_IO_MAX_PATH + 3];
+  if (fp == NULL && file_parent_path(parent, sizeof(parent), path))
+    fp = fopen(parent, "rb");
+  return fp;
+}
+
+static int file_open_fd(char const *path) {
+  int fd = open(path, O_RDONLY);
+  char parent[FILE_IO_MAX_PATH + 3];
+  if (fd < 0 && file_parent_path(parent, sizeof(parent), path))
+    fd = open(parent, O_RDONLY);
+  return fd;
+}
 
 bool file_read_all(struct File *file, char const *path) {
   bool result = false;
+  char *data = NULL;
 
-  FILE *fp = fopen(path, "rb");
+  FILE *fp = file_open(path);
   if (fp == NULL) {
     printf("Could not find file: %s\n", path);
-
-    char buffer[1024] = "../";
-    strcat(buffer, path);
-    fp = fopen(buffer, "rb");
-    if (fp == NULL) {
-      printf("Could not find file:%s\n", buffer);
-      goto exit;
-    }
+    goto exit;
   }
 
   fseek(fp, 0L, SEEK_END);
   size_t length = ftell(fp);
   rewind(fp);
 
-  char *data = (char *)malloc(length + 1);
+  data = (char *)malloc(length + 1);
   if (data == NULL) {
     printf("Could not allocate memory for file: %s\n", path);
     goto exit;
@@ -46,7 +84,8 @@ bool file_read_all(struct File *file, char const *path) {
   result = true;
 
 exit:
-  fclose(fp);
+  if (fp != NULL)
+    fclose(fp);
   if (!result) {
     free(data);
   }
@@ -55,3 +94,372 @@ exit:
 }
 
 void file_free(struct File *file) { free(file->data); }
+
+bool file_map(struct FileMap *map, char const *path) {
+  *map = (struct FileMap){0};
+#if FILE_MMAP
+  int fd = file_open_fd(path);
+  if (fd < 0) {
+    printf("Could not open file: %s\n", path);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    printf("Could not map empty or unreadable file: %s\n", path);
+    close(fd);
+    return false;
+  }
+
+  size_t length = (size_t)st.st_size;
+  void *data =
+      mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  // the mapping holds its own reference to the file
+  close(fd);
+  if (data == MAP_FAILED) {
+    printf("Could not map file: %s\n", path);
+    return false;
+  }
+  *map = (struct FileMap){
+      .data = (uint8_t *)data, .length = length, .mapped = true};
+  return true;
+#else
+  struct File file;
+  if (!file_read_all(&file, path))
+    return false;
+  *map = (struct FileMap){.data = (uint8_t *)file.data, .length = file.length};
+  return true;
+#endif
+}
+
+void file_unmap(struct FileMap *map) {
+#if FILE_MMAP
+  if (map->mapped) {
+    munmap(map->data, map->length);
+    *map = (struct FileMap){0};
+    return;
+  }
+#endif
+  free(map->data);
+  *map = (struct FileMap){0};
+}
+
+enum FileIoState { FILE_IO_FREE, FILE_IO_QUEUED, FILE_IO_DONE, FILE_IO_FAILED };
+
+struct FileIoRequest {
+  struct FileReadDesc desc;
+  char path[FILE_IO_MAX_PATH];
+  uint8_t *data;
+  size_t length;
+  // data was allocated by the read and not handed over yet
+  bool owned;
+  uint32_t generation;
+  // enum FileIoState, written by the io thread once the read is over
+  int32_t state;
+};
+
+#if FILE_IO_THREADS
+struct FileIoThreads {
+  pthread_t threads[FILE_IO_THREADS];
+  uint32_t thread_count;
+  pthread_mutex_t mutex;
+  // queue has work or quit is set
+  pthread_cond_t wake;
+  // a read finished
+  pthread_cond_t done;
+  // indices of queued requests, oldest at head
+  uint32_t queue[FILE_IO_MAX_REQUESTS];
+  uint32_t head;
+  uint32_t count;
+  bool quit;
+  struct FileIo *io;
+};
+#endif
+
+static bool file_io_execute(struct FileIo *io, struct FileIoRequest *req) {
+  PROFILE_BEGIN("file read");
+  struct FileReadDesc const *desc = &req->desc;
+  bool ok = false;
+  uint8_t *data = NULL;
+  size_t length = 0;
+
+  int fd = file_open_fd(req->path);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    printf("Could not open file: %s\n", req->path);
+    goto exit;
+  }
+  length = (size_t)st.st_size;
+
+  // streaming reuses the caller's buffer for every piece
+  bool streaming = desc->buffer != NULL && length > desc->capacity;
+  size_t piece_size = FILE_IO_CHUNK_SIZE;
+  if (streaming) {
+    if (desc->on_chunk == NULL || desc->capacity == 0) {
+      printf("File %s does not fit its buffer\n", req->path);
+      goto exit;
+    }
+    if (desc->capacity < piece_size)
+      piece_size = desc->capacity;
+    data = desc->buffer;
+  } else if (desc->buffer != NULL) {
+    data = desc->buffer;
+  } else {
+    data = (uint8_t *)malloc(length + 1);
+    if (data == NULL) {
+      printf("Could not allocate memory for file: %s\n", req->path);
+      goto exit;
+    }
+    data[length] = 0;
+    req->owned = true;
+  }
+
+  size_t offset = 0;
+  while (offset < length) {
+    size_t size = length - offset < piece_size ? length - offset : piece_size;
+    uint8_t *piece = streaming ? data : data + offset;
+    ssize_t got = pread(fd, piece, size, (off_t)offset);
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got <= 0) {
+      printf("Failed to read all of file: %s\n", req->path);
+      goto exit;
+    }
+    if (desc->on_chunk != NULL)
+      desc->on_chunk(desc->user, piece, offset, (size_t)got);
+    offset += (size_t)got;
+  }
+  __atomic_fetch_add(&io->bytes_read, length, __ATOMIC_RELAXED);
+  req->data = streaming ? NULL : data;
+  req->length = length;
+  ok = true;
+
+exit:
+  if (fd >= 0)
+    close(fd);
+  if (!ok && req->owned) {
+    free(data);
+    req->owned = false;
+  }
+  PROFILE_END();
+  return ok;
+}
+
+static void file_io_finish(struct FileIoRequest *req, bool ok) {
+  __atomic_store_n(&req->state, ok ? FILE_IO_DONE : FILE_IO_FAILED,
+                   __ATOMIC_RELEASE);
+}
+
+#if FILE_IO_THREADS
+static void *file_io_thread_main(void *arg) {
+  struct FileIoThreads *threads = (struct FileIoThreads *)arg;
+  struct FileIo *io = threads->io;
+
+  pthread_mutex_lock(&threads->mutex);
+  for (;;) {
+    while (threads->count == 0 && !threads->quit) {
+      pthread_cond_wait(&threads->wake, &threads->mutex);
+    }
+    if (threads->quit)
+      break;
+    uint32_t index = threads->queue[threads->head];
+    threads->head = (threads->head + 1) % FILE_IO_MAX_REQUESTS;
+    threads->count--;
+    pthread_mutex_unlock(&threads->mutex);
+
+    struct FileIoRequest *req = &io->requests[index];
+    bool ok = file_io_execute(io, req);
+
+    pthread_mutex_lock(&threads->mutex);
+    file_io_finish(req, ok);
+    pthread_cond_broadcast(&threads->done);
+  }
+  pthread_mutex_unlock(&threads->mutex);
+  return NULL;
+}
+#else
+// no threads, queued reads run on the caller
+static void file_io_run_queued(struct FileIo *io) {
+  for (uint32_t i = 0; i < FILE_IO_MAX_REQUESTS; ++i) {
+    struct FileIoRequest *req = &io->requests[i];
+    if (req->state == FILE_IO_QUEUED)
+      file_io_finish(req, file_io_execute(io, req));
+  }
+}
+#endif
+
+bool file_io_new(struct FileIo *io) {
+  *io = (struct FileIo){0};
+  io->requests = (struct FileIoRequest *)calloc(FILE_IO_MAX_REQUESTS,
+                                                sizeof(struct FileIoRequest));
+  if (io->requests == NULL) {
+    printf("Failed to allocate file requests\n");
+    return false;
+  }
+
+#if FILE_IO_THREADS
+  struct FileIoThreads *threads =
+      (struct FileIoThreads *)calloc(1, sizeof(struct FileIoThreads));
+  if (threads == NULL) {
+    printf("Failed to allocate file io threads\n");
+    free(io->requests);
+    io->requests = NULL;
+    return false;
+  }
+  io->threads = threads;
+  threads->io = io;
+  pthread_mutex_init(&threads->mutex, NULL);
+  pthread_cond_init(&threads->wake, NULL);
+  pthread_cond_init(&threads->done, NULL);
+  for (uint32_t i = 0; i < FILE_IO_THREADS; ++i) {
+    if (pthread_create(&threads->threads[i], NULL, file_io_thread_main,
+                       threads) != 0) {
+      printf("Failed to start file io thread %u\n", i);
+      break;
+    }
+    threads->thread_count++;
+  }
+  if (threads->thread_count == 0) {
+    file_io_free(io);
+    return false;
+  }
+#endif
+  return true;
+}
+
+void file_io_free(struct FileIo *io) {
+#if FILE_IO_THREADS
+  struct FileIoThreads *threads = io->threads;
+  if (threads != NULL) {
+    pthread_mutex_lock(&threads->mutex);
+    threads->quit = true;
+    pthread_cond_broadcast(&threads->wake);
+    pthread_mutex_unlock(&threads->mutex);
+    for (uint32_t i = 0; i < threads->thread_count; ++i) {
+      pthread_join(threads->threads[i], NULL);
+    }
+    pthread_cond_destroy(&threads->done);
+    pthread_cond_destroy(&threads->wake);
+    pthread_mutex_destroy(&threads->mutex);
+    free(threads);
+  }
+#endif
+  for (uint32_t i = 0; io->requests != NULL && i < FILE_IO_MAX_REQUESTS; ++i) {
+    if (io->requests[i].owned)
+      free(io->requests[i].data);
+  }
+  free(io->requests);
+  *io = (struct FileIo){0};
+}
+
+static struct FileIoRequest *file_io_lookup(struct FileIo const *io,
+                                            FileRequest request) {
+  struct FileIoRequest *req = &io->requests[request % FILE_IO_MAX_REQUESTS];
+  if (request == 0 || req->generation != request / FILE_IO_MAX_REQUESTS ||
+      __atomic_load_n(&req->state, __ATOMIC_ACQUIRE) == FILE_IO_FREE)
+    return NULL;
+  return req;
+}
+
+FileRequest file_io_read(struct FileIo *io, struct FileReadDesc const *desc) {
+  if (strlen(desc->path) >= FILE_IO_MAX_PATH) {
+    printf("File path too long: %s\n", desc->path);
+    return 0;
+  }
+  uint32_t index = 0;
+  while (index < FILE_IO_MAX_REQUESTS &&
+         __atomic_load_n(&io->requests[index].state, __ATOMIC_ACQUIRE) !=
+             FILE_IO_FREE) {
+    ++index;
+  }
+  if (index == FILE_IO_MAX_REQUESTS)
+    return 0;
+
+  struct FileIoRequest *req = &io->requests[index];
+  // generations start at 1 so no request is 0
+  uint32_t generation =
+      req->generation % (UINT32_MAX / FILE_IO_MAX_REQUESTS) + 1;
+  *req = (struct FileIoRequest){.desc = *desc,
+                                .generation = generation,
+                                .state = FILE_IO_QUEUED};
+  strcpy(req->path, desc->path);
+  req->desc.path = req->path;
+
+#if FILE_IO_THREADS
+  struct FileIoThreads *threads = io->threads;
+  pthread_mutex_lock(&threads->mutex);
+  threads->queue[(threads->head + threads->count) % FILE_IO_MAX_REQUESTS] =
+      index;
+  threads->count++;
+  pthread_cond_signal(&threads->wake);
+  pthread_mutex_unlock(&threads->mutex);
+#endif
+  return generation * FILE_IO_MAX_REQUESTS + index;
+}
+
+enum FileRequestStatus file_io_status(struct FileIo const *io,
+                                      FileRequest request) {
+  struct FileIoRequest const *req = file_io_lookup(io, request);
+  if (req == NULL)
+    return FILE_REQUEST_INVALID;
+  switch (__atomic_load_n(&req->state, __ATOMIC_ACQUIRE)) {
+  case FILE_IO_DONE:
+    return FILE_REQUEST_DONE;
+  case FILE_IO_FAILED:
+    return FILE_REQUEST_FAILED;
+  default:
+    return FILE_REQUEST_PENDING;
+  }
+}
+
+void file_io_wait(struct FileIo *io, FileRequest request) {
+  struct FileIoRequest *req = file_io_lookup(io, request);
+  if (req == NULL)
+    return;
+#if FILE_IO_THREADS
+  struct FileIoThreads *threads = io->threads;
+  pthread_mutex_lock(&threads->mutex);
+  while (__atomic_load_n(&req->state, __ATOMIC_ACQUIRE) == FILE_IO_QUEUED) {
+    pthread_cond_wait(&threads->done, &threads->mutex);
+  }
+  pthread_mutex_unlock(&threads->mutex);
+#else
+  if (req->state == FILE_IO_QUEUED)
+    file_io_finish(req, file_io_execute(io, req));
+#endif
+}
+
+// hands the result over and frees the slot for the next read.
+static enum FileRequestStatus file_io_release(struct FileIoRequest *req,
+                                              struct File *file) {
+  bool ok = req->state == FILE_IO_DONE;
+  *file = (struct File){.data = (char *)req->data, .length = req->length};
+  *req = (struct FileIoRequest){.generation = req->generation};
+  return ok ? FILE_REQUEST_DONE : FILE_REQUEST_FAILED;
+}
+
+enum FileRequestStatus file_io_take(struct FileIo *io, FileRequest request,
+                                    struct File *file) {
+  enum FileRequestStatus status = file_io_status(io, request);
+  if (status == FILE_REQUEST_DONE || status == FILE_REQUEST_FAILED)
+    file_io_release(file_io_lookup(io, request), file);
+  return status;
+}
+
+void file_io_poll(struct FileIo *io) {
+#if !FILE_IO_THREADS
+  file_io_run_queued(io);
+#endif
+  for (uint32_t i = 0; i < FILE_IO_MAX_REQUESTS; ++i) {
+    struct FileIoRequest *req = &io->requests[i];
+    int32_t state = __atomic_load_n(&req->state, __ATOMIC_ACQUIRE);
+    if (req->desc.on_done == NULL ||
+        (state != FILE_IO_DONE && state != FILE_IO_FAILED))
+      continue;
+    // released first so the callback can queue the next read in this slot
+    FileDoneFunc on_done = req->desc.on_done;
+    void *user = req->desc.user;
+    struct File file;
+    bool ok = file_io_release(req, &file) == FILE_REQUEST_DONE;
+    on_done(user, &file, ok);
+  }
+}
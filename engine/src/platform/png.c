@@ -0,0 +1,136 @@
+#include "platform/png.h"
+
+#include <stdio.h>
+
+// largest deflate stored block
+#define PNG_BLOCK_SIZE 65535
+
+struct PngWriter {
+  FILE *fp;
+  uint32_t crc;
+  // zlib checksum of the uncompressed image data
+  uint32_t adler_a;
+  uint32_t adler_b;
+  // bytes left in the current stored block
+  uint32_t block_left;
+  uint64_t raw_left;
+};
+
+static uint32_t g_crc_table[256];
+
+static void png_crc_init(void) {
+  if (g_crc_table[1] != 0)
+    return;
+  for (uint32_t n = 0; n < 256; ++n) {
+    uint32_t c = n;
+    for (int k = 0; k < 8; ++k) {
+      c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+    }
+    g_crc_table[n] = c;
+  }
+}
+
+static void png_bytes(struct PngWriter *w, uint8_t const *data, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    w->crc = g_crc_table[(w->crc ^ data[i]) & 0xFF] ^ (w->crc >> 8);
+  }
+  fwrite(data, 1, size, w->fp);
+}
+
+static void png_u32(struct PngWriter *w, uint32_t v) {
+  uint8_t bytes[4] = {(uint8_t)(v >> 24), (uint8_t)(v >> 16), (uint8_t)(v >> 8),
+                      (uint8_t)v};
+  png_bytes(w, bytes, 4);
+}
+
+// the length isn't part of the crc, the type is.
+static void png_chunk_begin(struct PngWriter *w, char const type[4],
+                            uint32_t length) {
+  uint8_t bytes[4] = {(uint8_t)(length >> 24), (uint8_t)(length >> 16),
+                      (uint8_t)(length >> 8), (uint8_t)length};
+  fwrite(bytes, 1, 4, w->fp);
+  w->crc = 0xFFFFFFFFu;
+  png_bytes(w, (uint8_t const *)type, 4);
+}
+
+static void png_chunk_end(struct PngWriter *w) {
+  png_u32(w, w->crc ^ 0xFFFFFFFFu);
+}
+
+// image data goes out in stored blocks, each with a 5 byte header.
+static void png_raw(struct PngWriter *w, uint8_t const *data, size_t size) {
+  while (size > 0) {
+    if (w->block_left == 0) {
+      uint32_t block = w->raw_left < PNG_BLOCK_SIZE ? (uint32_t)w->raw_left
+                                                    : PNG_BLOCK_SIZE;
+      uint8_t header[5] = {w->raw_left == block ? 1 : 0, (uint8_t)block,
+                           (uint8_t)(block >> 8), (uint8_t)~block,
+                           (uint8_t)(~block >> 8)};
+      png_bytes(w, header, 5);
+      w->block_left = block;
+    }
+    size_t count = size < w->block_left ? size : w->block_left;
+    for (size_t i = 0; i < count; ++i) {
+      w->adler_a = (w->adler_a + data[i]) % 65521;
+      w->adler_b = (w->adler_b + w->adler_a) % 65521;
+    }
+    png_bytes(w, data, count);
+    w->block_left -= (uint32_t)count;
+    w->raw_left -= count;
+    data += count;
+    size -= count;
+  }
+}
+
+bool png_write_rgba(char const *path, uint8_t const *pixels, uint32_t width,
+                    uint32_t height) {
+  uint64_t row_size = 1 + (uint64_t)width * 4;
+  uint64_t raw_size = row_size * height;
+  uint64_t blocks = (raw_size + PNG_BLOCK_SIZE - 1) / PNG_BLOCK_SIZE;
+  // zlib header, stored blocks, adler32
+  uint64_t idat_size = 2 + blocks * 5 + raw_size + 4;
+  if (width == 0 || height == 0 || idat_size > 0x7FFFFFFFu) {
+    printf("Can't write a %ux%u png\n", width, height);
+    return false;
+  }
+
+  FILE *fp = fopen(path, "wb");
+  if (fp == NULL) {
+    printf("Could not open %s for writing\n", path);
+    return false;
+  }
+  png_crc_init();
+  struct PngWriter w = {.fp = fp, .adler_a = 1, .raw_left = raw_size};
+
+  uint8_t const signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  fwrite(signature, 1, 8, fp);
+
+  png_chunk_begin(&w, "IHDR", 13);
+  png_u32(&w, width);
+  png_u32(&w, height);
+  // 8 bits per channel, RGBA, deflate, adaptive filtering, no interlace
+  uint8_t const format[5] = {8, 6, 0, 0, 0};
+  png_bytes(&w, format, 5);
+  png_chunk_end(&w);
+
+  png_chunk_begin(&w, "IDAT", (uint32_t)idat_size);
+  uint8_t const zlib_header[2] = {0x78, 0x01};
+  png_bytes(&w, zlib_header, 2);
+  for (uint32_t y = 0; y < height; ++y) {
+    uint8_t const filter = 0;
+    png_raw(&w, &filter, 1);
+    png_raw(&w, pixels + (size_t)y * width * 4, (size_t)width * 4);
+  }
+  png_u32(&w, (w.adler_b << 16) | w.adler_a);
+  png_chunk_end(&w);
+
+  png_chunk_begin(&w, "IEND", 0);
+  png_chunk_end(&w);
+
+  bool ok = ferror(fp) == 0;
+  if (fclose(fp) != 0 || !ok) {
+    printf("Failed to write %s\n", path);
+    return false;
+  }
+  return true;
+}
@@ -1,8 +1,245 @@
 #include "render/gfx_api.h"
 
+#include "core/profiler.h"
 #include "gl.h"
 
 #include <stdio.h>
+#include <string.h>
+
+#define UNIFORM_CACHE_SIZE 64
+
+// WebGL2 has neither buffer mapping nor blocking fence waits.
+#ifdef __EMSCRIPTEN__
+#define STREAM_BUFFER_ORPHAN 1
+#else
+#define STREAM_BUFFER_ORPHAN 0
+#endif
+
+// WebGL2 has no texture buffers, data textures are plain 2D textures there.
+#ifdef __EMSCRIPTEN__
+#define DATA_TEXTURE_2D 1
+#else
+#define DATA_TEXTURE_2D 0
+#endif
+
+// WebGL2 timer queries come from an extension with its own enums, and results
+// are read as 32 bit, enough for a pass under four seconds.
+#ifdef __EMSCRIPTEN__
+#define GPU_TIMER_TIME_ELAPSED 0x88BF
+#define GPU_TIMER_DISJOINT 0x8FBB
+#else
+#define GPU_TIMER_TIME_ELAPSED GL_TIME_ELAPSED
+#endif
+
+struct UniformCacheEntry {
+  uint32_t program;
+  uint32_t location;
+  uint32_t count;
+  float value[16];
+};
+
+// mirror of the GL state we change, so binds that would not change anything
+// never reach the driver (or cross the JS boundary on WebGL).
+struct StateCache {
+  bool valid;
+  uint32_t program;
+  uint32_t vao;
+  uint32_t array_buffer;
+  uint32_t uniform_buffer;
+  bool depth_test;
+  bool depth_mask;
+  bool blend;
+  struct UniformCacheEntry uniforms[UNIFORM_CACHE_SIZE];
+  uint32_t uniforms_size;
+  uint32_t uniforms_next;
+  struct GfxStats stats;
+};
+
+static struct StateCache g_state;
+
+void gfx_state_reset(void) {
+  struct GfxStats stats = g_state.stats;
+  memset(&g_state, 0, sizeof(g_state));
+  g_state.stats = stats;
+  // GL defaults for a fresh context
+  g_state.depth_mask = true;
+  g_state.valid = true;
+}
+
+struct GfxStats gfx_stats_get(void) { return g_state.stats; }
+
+void gfx_stats_reset(void) { g_state.stats = (struct GfxStats){0}; }
+
+// returns true when the call needs to be issued and counts it either way.
+static bool gfx_state_changed(bool changed) {
+  if (changed || !g_state.valid) {
+    g_state.stats.calls_issued++;
+    return true;
+  }
+  g_state.stats.calls_skipped++;
+  return false;
+}
+
+void gfx_use_program(uint32_t program) {
+  if (gfx_state_changed(g_state.program != program)) {
+    glUseProgram(program);
+    g_state.program = program;
+  }
+}
+
+void gfx_bind_vertex_array(uint32_t vao) {
+  if (gfx_state_changed(g_state.vao != vao)) {
+    glBindVertexArray(vao);
+    g_state.vao = vao;
+  }
+}
+
+void gfx_bind_array_buffer(uint32_t buffer) {
+  if (gfx_state_changed(g_state.array_buffer != buffer)) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    g_state.array_buffer = buffer;
+  }
+}
+
+void gfx_bind_uniform_buffer(uint32_t buffer) {
+  if (gfx_state_changed(g_state.uniform_buffer != buffer)) {
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    g_state.uniform_buffer = buffer;
+  }
+}
+
+static void gfx_set_capability(GLenum capability, bool *current, bool enable) {
+  if (gfx_state_changed(*current != enable)) {
+    if (enable)
+      glEnable(capability);
+    else
+      glDisable(capability);
+    *current = enable;
+  }
+}
+
+void gfx_set_depth_test(bool enable) {
+  gfx_set_capability(GL_DEPTH_TEST, &g_state.depth_test, enable);
+}
+
+void gfx_set_blend(bool enable) {
+  gfx_set_capability(GL_BLEND, &g_state.blend, enable);
+}
+
+void gfx_set_depth_mask(bool enable) {
+  if (gfx_state_changed(g_state.depth_mask != enable)) {
+    glDepthMask(enable ? GL_TRUE : GL_FALSE);
+    g_state.depth_mask = enable;
+  }
+}
+
+// uniform values live in the program, so they are keyed by the program that
+// is currently bound. returns true if the value needs uploading.
+static bool gfx_uniform_changed(uint32_t location, float const *value,
+                                uint32_t count) {
+  for (uint32_t i = 0; i < g_state.uniforms_size; ++i) {
+    struct UniformCacheEntry *entry = &g_state.uniforms[i];
+    if (entry->program != g_state.program || entry->location != location)
+      continue;
+    bool same = entry->count == count &&
+                memcmp(entry->value, value, count * sizeof(float)) == 0;
+    if (!gfx_state_changed(!same))
+      return false;
+    entry->count = count;
+    memcpy(entry->value, value, count * sizeof(float));
+    return true;
+  }
+
+  g_state.stats.calls_issued++;
+  struct UniformCacheEntry *entry = &g_state.uniforms[g_state.uniforms_next];
+  g_state.uniforms_next = (g_state.uniforms_next + 1) % UNIFORM_CACHE_SIZE;
+  if (g_state.uniforms_size < UNIFORM_CACHE_SIZE)
+    g_state.uniforms_size++;
+  *entry = (struct UniformCacheEntry){
+      .program = g_state.program, .location = location, .count = count};
+  memcpy(entry->value, value, count * sizeof(float));
+  return true;
+}
+
+// deleted objects are unbound by GL, keep the cache in step.
+static void gfx_state_forget_program(uint32_t program) {
+  if (g_state.program == program)
+    g_state.program = 0;
+  for (uint32_t i = 0; i < g_state.uniforms_size; ++i) {
+    if (g_state.uniforms[i].program == program)
+      g_state.uniforms[i].location = (uint32_t)-1;
+  }
+}
+
+static void gfx_state_forget_buffer(uint32_t buffer) {
+  if (g_state.array_buffer == buffer)
+    g_state.array_buffer = 0;
+  if (g_state.uniform_buffer == buffer)
+    g_state.uniform_buffer = 0;
+}
+
+static void gfx_state_forget_vertex_array(uint32_t vao) {
+  if (g_state.vao == vao)
+    g_state.vao = 0;
+}
+
+void gfx_delete_buffer(uint32_t buffer) {
+  gfx_state_forget_buffer(buffer);
+  glDeleteBuffers(1, &buffer);
+}
+
+void gfx_delete_vertex_array(uint32_t vao) {
+  gfx_state_forget_vertex_array(vao);
+  glDeleteVertexArrays(1, &vao);
+}
+
+struct VertexLayout vertex_layout_position_normal(void) {
+  return (struct VertexLayout){
+      .stride = 6 * sizeof(float),
+      .attrib_count = 2,
+      .attribs = {{.location = 0, .components = 3, .type = VERTEX_TYPE_FLOAT},
+                  {.location = 1,
+                   .components = 3,
+                   .type = VERTEX_TYPE_FLOAT,
+                   .offset = 3 * sizeof(float)}}};
+}
+
+static GLenum vertex_type_gl(enum VertexType type) {
+  switch (type) {
+  case VERTEX_TYPE_I8:
+    return GL_BYTE;
+  case VERTEX_TYPE_U8:
+    return GL_UNSIGNED_BYTE;
+  case VERTEX_TYPE_I16:
+    return GL_SHORT;
+  case VERTEX_TYPE_U16:
+    return GL_UNSIGNED_SHORT;
+  case VERTEX_TYPE_I32:
+    return GL_INT;
+  case VERTEX_TYPE_U32:
+    return GL_UNSIGNED_INT;
+  default:
+    return GL_FLOAT;
+  }
+}
+
+void vertex_layout_apply(struct VertexLayout const *layout) {
+  for (uint32_t i = 0; i < layout->attrib_count; ++i) {
+    struct VertexAttrib const *a = &layout->attribs[i];
+    GLenum type = vertex_type_gl(a->type);
+    void const *offset = (void const *)(uintptr_t)a->offset;
+    if (a->integer) {
+      glVertexAttribIPointer(a->location, a->components, type, layout->stride,
+                             offset);
+    } else {
+      glVertexAttribPointer(a->location, a->components, type,
+                            a->normalized ? GL_TRUE : GL_FALSE,
+                            layout->stride, offset);
+    }
+    glEnableVertexAttribArray(a->location);
+    glVertexAttribDivisor(a->location, a->divisor);
+  }
+}
 
 struct Mesh mesh_new(void) {
   uint32_t vao = 0;
@@ -13,27 +250,495 @@ struct Mesh mesh_new(void) {
   return (struct Mesh){.vertex_buffer = vertex_buffer, .vao = vao};
 }
 
-void mesh_fill(struct Mesh const *m, float const *data, size_t size) {
-  glBindVertexArray(m->vao);
-  glBindBuffer(GL_ARRAY_BUFFER, m->vertex_buffer);
+void mesh_fill(struct Mesh const *m, struct VertexLayout const *layout,
+               void const *data, size_t size) {
+  gfx_bind_vertex_array(m->vao);
+  gfx_bind_array_buffer(m->vertex_buffer);
   glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+  vertex_layout_apply(layout);
+}
+
+static GLenum index_type_gl(enum IndexType type) {
+  return type == INDEX_TYPE_U32 ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+}
+
+static size_t index_type_size(enum IndexType type) {
+  return type == INDEX_TYPE_U32 ? sizeof(uint32_t) : sizeof(uint16_t);
+}
 
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)0);
-  glEnableVertexAttribArray(0);
+void mesh_fill_indices(struct Mesh *m, void const *indices, uint32_t count,
+                       enum IndexType type) {
+  if (!m->owns_index_buffer) {
+    m->index_buffer = 0;
+    glGenBuffers(1, (GLuint *)&m->index_buffer);
+    m->owns_index_buffer = true;
+  }
+  // the element buffer binding is part of the vertex array
+  gfx_bind_vertex_array(m->vao);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m->index_buffer);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, count * index_type_size(type),
+               indices, GL_STATIC_DRAW);
+  m->index_type = type;
+}
 
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float),
-                        (void *)(3 * sizeof(float)));
-  glEnableVertexAttribArray(1);
+void mesh_set_index_buffer(struct Mesh *m, uint32_t buffer,
+                           enum IndexType type) {
+  if (m->owns_index_buffer)
+    gfx_delete_buffer(m->index_buffer);
+  gfx_bind_vertex_array(m->vao);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+  m->index_buffer = buffer;
+  m->index_type = type;
+  m->owns_index_buffer = false;
 }
 
-void mesh_bind(struct Mesh const *m) { glBindVertexArray(m->vao); }
+void mesh_bind(struct Mesh const *m) { gfx_bind_vertex_array(m->vao); }
+
+void mesh_draw(struct Mesh const *m, uint32_t count) {
+  gfx_bind_vertex_array(m->vao);
+  if (m->index_type == INDEX_TYPE_NONE) {
+    glDrawArrays(GL_TRIANGLES, 0, count);
+  } else {
+    glDrawElements(GL_TRIANGLES, count, index_type_gl(m->index_type),
+                   (void *)0);
+  }
+}
 
 void mesh_free(struct Mesh *m) {
-  glDeleteBuffers(1, &m->vertex_buffer);
-  glDeleteVertexArrays(1, &m->vao);
+  if (m->owns_index_buffer)
+    gfx_delete_buffer(m->index_buffer);
+  gfx_delete_buffer(m->vertex_buffer);
+  gfx_delete_vertex_array(m->vao);
   *m = (struct Mesh){0};
 }
 
+struct InstancedMesh instanced_mesh_new(struct Mesh const *base,
+                                        uint32_t vertex_count) {
+  uint32_t vao = 0;
+  glGenVertexArrays(1, (GLuint *)&vao);
+  uint32_t instance_buffer = 0;
+  glGenBuffers(1, (GLuint *)&instance_buffer);
+
+  gfx_bind_vertex_array(vao);
+  if (base->index_type != INDEX_TYPE_NONE)
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, base->index_buffer);
+  gfx_bind_array_buffer(base->vertex_buffer);
+  struct VertexLayout base_layout = vertex_layout_position_normal();
+  vertex_layout_apply(&base_layout);
+
+  struct VertexLayout const instance_layout = {
+      .stride = sizeof(struct CubeInstance),
+      .attrib_count = 2,
+      .attribs = {{.location = 2,
+                   .components = 3,
+                   .type = VERTEX_TYPE_FLOAT,
+                   .divisor = 1},
+                  {.location = 3,
+                   .components = 1,
+                   .type = VERTEX_TYPE_U32,
+                   .offset = 3 * sizeof(float),
+                   .integer = true,
+                   .divisor = 1}}};
+  gfx_bind_array_buffer(instance_buffer);
+  vertex_layout_apply(&instance_layout);
+
+  return (struct InstancedMesh){.vao = vao,
+                                .instance_buffer = instance_buffer,
+                                .index_type = base->index_type,
+                                .vertex_count = vertex_count,
+                                .instance_count = 0};
+}
+
+void instanced_mesh_fill(struct InstancedMesh *m,
+                         struct CubeInstance const *instances, uint32_t count) {
+  gfx_bind_array_buffer(m->instance_buffer);
+  glBufferData(GL_ARRAY_BUFFER, count * sizeof(struct CubeInstance), instances,
+               GL_DYNAMIC_DRAW);
+  m->instance_count = count;
+}
+
+void instanced_mesh_draw(struct InstancedMesh const *m) {
+  if (m->instance_count == 0)
+    return;
+
+  gfx_bind_vertex_array(m->vao);
+  if (m->index_type == INDEX_TYPE_NONE) {
+    glDrawArraysInstanced(GL_TRIANGLES, 0, m->vertex_count,
+                          m->instance_count);
+  } else {
+    glDrawElementsInstanced(GL_TRIANGLES, m->vertex_count,
+                            index_type_gl(m->index_type), (void *)0,
+                            m->instance_count);
+  }
+}
+
+void instanced_mesh_free(struct InstancedMesh *m) {
+  gfx_delete_buffer(m->instance_buffer);
+  gfx_delete_vertex_array(m->vao);
+  *m = (struct InstancedMesh){0};
+}
+
+struct QuadIndexBuffer quad_index_buffer_new(uint32_t quad_count) {
+  static const uint32_t pattern[6] = {0, 1, 2, 2, 3, 0};
+  enum IndexType type =
+      quad_count * 4 <= 65536 ? INDEX_TYPE_U16 : INDEX_TYPE_U32;
+  size_t count = (size_t)quad_count * 6;
+  void *indices = malloc(count * index_type_size(type));
+  if (indices == NULL) {
+    printf("Failed to allocate quad indices\n");
+    return (struct QuadIndexBuffer){0};
+  }
+  for (size_t i = 0; i < count; ++i) {
+    uint32_t index = (uint32_t)(i / 6) * 4 + pattern[i % 6];
+    if (type == INDEX_TYPE_U16) {
+      ((uint16_t *)indices)[i] = (uint16_t)index;
+    } else {
+      ((uint32_t *)indices)[i] = index;
+    }
+  }
+
+  // element buffers can only be filled through a vertex array, any one will
+  // do, the buffer itself isn't tied to it
+  uint32_t vao = 0;
+  glGenVertexArrays(1, (GLuint *)&vao);
+  gfx_bind_vertex_array(vao);
+  uint32_t buffer = 0;
+  glGenBuffers(1, (GLuint *)&buffer);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, count * index_type_size(type), indices,
+               GL_STATIC_DRAW);
+  gfx_delete_vertex_array(vao);
+  free(indices);
+  return (struct QuadIndexBuffer){
+      .buffer = buffer, .type = type, .quad_count = quad_count};
+}
+
+void quad_index_buffer_free(struct QuadIndexBuffer *qb) {
+  gfx_delete_buffer(qb->buffer);
+  *qb = (struct QuadIndexBuffer){0};
+}
+
+struct DataTexture data_texture_new(void) {
+  struct DataTexture dt = {0};
+  glGenTextures(1, (GLuint *)&dt.texture);
+#if DATA_TEXTURE_2D
+  // integer textures can't be filtered, and aren't complete until told so
+  glBindTexture(GL_TEXTURE_2D, dt.texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+#else
+  glGenBuffers(1, (GLuint *)&dt.buffer);
+  glBindBuffer(GL_TEXTURE_BUFFER, dt.buffer);
+  glBindTexture(GL_TEXTURE_BUFFER, dt.texture);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, dt.buffer);
+#endif
+  return dt;
+}
+
+void data_texture_fill(struct DataTexture *dt, uint32_t const *words,
+                       uint32_t count) {
+#if DATA_TEXTURE_2D
+  glBindTexture(GL_TEXTURE_2D, dt->texture);
+  uint32_t rows = (count + DATA_TEXTURE_WIDTH - 1) / DATA_TEXTURE_WIDTH;
+  if (count > dt->capacity) {
+    // double the rows so a chunk that keeps growing reallocates rarely
+    uint32_t capacity_rows = dt->capacity / DATA_TEXTURE_WIDTH;
+    if (capacity_rows < 1)
+      capacity_rows = 1;
+    while (capacity_rows < rows) {
+      capacity_rows *= 2;
+    }
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, DATA_TEXTURE_WIDTH, capacity_rows,
+                 0, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+    dt->capacity = capacity_rows * DATA_TEXTURE_WIDTH;
+  }
+  // whole rows, then what is left of the last one
+  uint32_t full_rows = count / DATA_TEXTURE_WIDTH;
+  uint32_t rest = count % DATA_TEXTURE_WIDTH;
+  if (full_rows > 0) {
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, DATA_TEXTURE_WIDTH, full_rows,
+                    GL_RED_INTEGER, GL_UNSIGNED_INT, words);
+  }
+  if (rest > 0) {
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, full_rows, rest, 1, GL_RED_INTEGER,
+                    GL_UNSIGNED_INT, words + full_rows * DATA_TEXTURE_WIDTH);
+  }
+#else
+  // a new store each time, like mesh_fill, so draws still reading the old
+  // words never stall the upload
+  glBindBuffer(GL_TEXTURE_BUFFER, dt->buffer);
+  glBufferData(GL_TEXTURE_BUFFER, (size_t)count * sizeof(uint32_t), words,
+               GL_STATIC_DRAW);
+  dt->capacity = count;
+#endif
+}
+
+void data_texture_bind(struct DataTexture const *dt, uint32_t unit) {
+  glActiveTexture(GL_TEXTURE0 + unit);
+#if DATA_TEXTURE_2D
+  glBindTexture(GL_TEXTURE_2D, dt->texture);
+#else
+  glBindTexture(GL_TEXTURE_BUFFER, dt->texture);
+#endif
+}
+
+void data_texture_free(struct DataTexture *dt) {
+  glDeleteTextures(1, (GLuint *)&dt->texture);
+  if (dt->buffer != 0)
+    gfx_delete_buffer(dt->buffer);
+  *dt = (struct DataTexture){0};
+}
+
+struct UniformBuffer uniform_buffer_new(size_t size, uint32_t binding) {
+  uint32_t buffer = 0;
+  glGenBuffers(1, (GLuint *)&buffer);
+  gfx_bind_uniform_buffer(buffer);
+  glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+  // also binds the generic uniform buffer target
+  glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+
+  return (struct UniformBuffer){
+      .buffer = buffer, .binding = binding, .size = size};
+}
+
+void uniform_buffer_update(struct UniformBuffer const *ub, void const *data,
+                           size_t size) {
+  gfx_bind_uniform_buffer(ub->buffer);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+}
+
+void uniform_buffer_update_range(struct UniformBuffer const *ub, size_t offset,
+                                 void const *data, size_t size) {
+  gfx_bind_uniform_buffer(ub->buffer);
+  glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+}
+
+void uniform_buffer_free(struct UniformBuffer *ub) {
+  gfx_delete_buffer(ub->buffer);
+  *ub = (struct UniformBuffer){0};
+}
+
+struct StreamBuffer stream_buffer_new(size_t frame_size) {
+  uint32_t buffer = 0;
+  glGenBuffers(1, (GLuint *)&buffer);
+  gfx_bind_array_buffer(buffer);
+  size_t regions = STREAM_BUFFER_ORPHAN ? 1 : STREAM_BUFFER_FRAMES;
+  glBufferData(GL_ARRAY_BUFFER, frame_size * regions, NULL, GL_STREAM_DRAW);
+
+  return (struct StreamBuffer){.buffer = buffer, .frame_size = frame_size};
+}
+
+// makes the current region safe to write, the first time it is touched each
+// frame.
+static void stream_buffer_acquire(struct StreamBuffer *sb) {
+#if STREAM_BUFFER_ORPHAN
+  glBufferData(GL_ARRAY_BUFFER, sb->frame_size, NULL, GL_STREAM_DRAW);
+  sb->stats.orphans++;
+#else
+  GLsync fence = (GLsync)sb->fences[sb->frame];
+  if (fence != NULL) {
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+      sb->stats.stalls_avoided++;
+    } else {
+      sb->stats.stalls++;
+      do {
+        status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                  1000000000);
+      } while (status == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(fence);
+    sb->fences[sb->frame] = NULL;
+  }
+#endif
+  sb->region_ready = true;
+}
+
+bool stream_buffer_write(struct StreamBuffer *sb, void const *data,
+                         size_t size, size_t alignment, size_t *offset) {
+  size_t start = (sb->head + alignment - 1) / alignment * alignment;
+  if (start + size > sb->frame_size)
+    return false;
+
+  gfx_bind_array_buffer(sb->buffer);
+  if (!sb->region_ready) {
+    stream_buffer_acquire(sb);
+  }
+
+#if STREAM_BUFFER_ORPHAN
+  size_t base = start;
+  glBufferSubData(GL_ARRAY_BUFFER, base, size, data);
+#else
+  size_t base = sb->frame * sb->frame_size + start;
+  // the fence already guarantees the GPU is done with this range
+  void *dst = glMapBufferRange(GL_ARRAY_BUFFER, base, size,
+                               GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+                                   GL_MAP_UNSYNCHRONIZED_BIT);
+  if (dst != NULL) {
+    memcpy(dst, data, size);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+  } else {
+    glBufferSubData(GL_ARRAY_BUFFER, base, size, data);
+  }
+#endif
+
+  sb->head = start + size;
+  *offset = base;
+  return true;
+}
+
+void stream_buffer_end_frame(struct StreamBuffer *sb) {
+  sb->stats.frame_bytes = sb->head;
+  if (!sb->region_ready)
+    return;
+
+#if !STREAM_BUFFER_ORPHAN
+  sb->fences[sb->frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  sb->frame = (sb->frame + 1) % STREAM_BUFFER_FRAMES;
+#endif
+  sb->head = 0;
+  sb->region_ready = false;
+}
+
+void stream_buffer_free(struct StreamBuffer *sb) {
+#if !STREAM_BUFFER_ORPHAN
+  for (int i = 0; i < STREAM_BUFFER_FRAMES; ++i) {
+    if (sb->fences[i] != NULL) {
+      glDeleteSync((GLsync)sb->fences[i]);
+    }
+  }
+#endif
+  gfx_delete_buffer(sb->buffer);
+  *sb = (struct StreamBuffer){0};
+}
+
+struct GpuTimer gpu_timer_new(void) {
+  struct GpuTimer timer = {0};
+#ifdef __EMSCRIPTEN__
+  EMSCRIPTEN_WEBGL_CONTEXT_HANDLE context =
+      emscripten_webgl_get_current_context();
+  timer.supported = context != 0 &&
+                    emscripten_webgl_enable_extension(
+                        context, "EXT_disjoint_timer_query_webgl2");
+#else
+  // core since GL 3.3, Mesa's llvmpipe included
+  timer.supported = true;
+#endif
+  if (!timer.supported) {
+    printf("GPU timer queries not available, GPU timing disabled\n");
+    return timer;
+  }
+
+  for (int i = 0; i < GPU_TIMER_FRAMES; ++i) {
+    glGenQueries(GPU_TIMER_MAX_PASSES, (GLuint *)timer.frames[i].queries);
+  }
+  return timer;
+}
+
+void gpu_timer_free(struct GpuTimer *timer) {
+  if (timer->supported) {
+    for (int i = 0; i < GPU_TIMER_FRAMES; ++i) {
+      glDeleteQueries(GPU_TIMER_MAX_PASSES, (GLuint *)timer->frames[i].queries);
+    }
+  }
+  *timer = (struct GpuTimer){0};
+}
+
+void gpu_timer_begin(struct GpuTimer *timer, char const *name) {
+  struct GpuTimerFrame *frame = &timer->frames[timer->frame];
+  if (!timer->supported || timer->pass_open ||
+      frame->pass_count >= GPU_TIMER_MAX_PASSES)
+    return;
+
+  frame->names[frame->pass_count] = name;
+  glBeginQuery(GPU_TIMER_TIME_ELAPSED, frame->queries[frame->pass_count]);
+  timer->pass_open = true;
+}
+
+void gpu_timer_end(struct GpuTimer *timer) {
+  if (!timer->pass_open)
+    return;
+  glEndQuery(GPU_TIMER_TIME_ELAPSED);
+  timer->frames[timer->frame].pass_count++;
+  timer->pass_open = false;
+}
+
+// false while the GPU hasn't got to the frame yet. queries finish in order,
+// so the last one being available means they all are.
+static bool gpu_timer_resolve(struct GpuTimer *timer,
+                              struct GpuTimerFrame *frame) {
+  GLuint available = 0;
+  glGetQueryObjectuiv(frame->queries[frame->pass_count - 1],
+                      GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available)
+    return false;
+
+#ifdef __EMSCRIPTEN__
+  // a disjoint event (power state change, context switch) makes every query
+  // in flight meaningless
+  GLint disjoint = 0;
+  glGetIntegerv(GPU_TIMER_DISJOINT, &disjoint);
+  if (disjoint) {
+    timer->frames_dropped++;
+    return true;
+  }
+#endif
+
+  for (uint32_t i = 0; i < frame->pass_count; ++i) {
+#ifdef __EMSCRIPTEN__
+    GLuint ns = 0;
+    glGetQueryObjectuiv(frame->queries[i], GL_QUERY_RESULT, &ns);
+#else
+    GLuint64 ns = 0;
+    glGetQueryObjectui64v(frame->queries[i], GL_QUERY_RESULT, &ns);
+#endif
+    timer->pass_names[i] = frame->names[i];
+    timer->pass_ms[i] = (float)(ns / 1e6);
+  }
+  timer->pass_count = frame->pass_count;
+  return true;
+}
+
+void gpu_timer_end_frame(struct GpuTimer *timer) {
+  if (!timer->supported)
+    return;
+  gpu_timer_end(timer);
+
+  struct GpuTimerFrame *current = &timer->frames[timer->frame];
+  current->pending = current->pass_count > 0;
+  timer->frame = (timer->frame + 1) % GPU_TIMER_FRAMES;
+
+  // oldest first, stop at the first frame the GPU hasn't finished
+  bool resolved = false;
+  for (uint32_t i = 0; i < GPU_TIMER_FRAMES; ++i) {
+    struct GpuTimerFrame *frame =
+        &timer->frames[(timer->frame + i) % GPU_TIMER_FRAMES];
+    if (!frame->pending)
+      continue;
+    if (!gpu_timer_resolve(timer, frame))
+      break;
+    frame->pending = false;
+    frame->pass_count = 0;
+    resolved = true;
+  }
+
+  struct GpuTimerFrame *next = &timer->frames[timer->frame];
+  if (next->pending) {
+    // the GPU is more than GPU_TIMER_FRAMES behind, reusing the queries
+    // throws their results away rather than waiting on them
+    next->pending = false;
+    timer->frames_dropped++;
+  }
+  next->pass_count = 0;
+
+  if (resolved) {
+    for (uint32_t i = 0; i < timer->pass_count; ++i) {
+      profiler_gpu_zone(timer->pass_names[i],
+                        (uint64_t)(timer->pass_ms[i] * 1e6));
+    }
+  }
+}
+
 // TODO: handle gracefully cleaning up after a failed shader, for now just count
 // on exiting the program.
 bool shader_new(struct Shader *shader, char const *vertex_src,
@@ -86,11 +791,22 @@ void shader_free(struct Shader *s) {
   glDetachShader(s->program, s->fragment_shader);
   glDeleteShader(s->vertex_shader);
   glDeleteShader(s->fragment_shader);
+  gfx_state_forget_program(s->program);
   glDeleteProgram(s->program);
   *s = (struct Shader){0};
 }
 
-void shader_bind(struct Shader const *s) { glUseProgram(s->program); }
+void shader_bind(struct Shader const *s) { gfx_use_program(s->program); }
+
+void shader_bind_uniform_block(struct Shader const *s, char const *block_name,
+                               uint32_t binding) {
+  uint32_t index = glGetUniformBlockIndex(s->program, block_name);
+  if (index == GL_INVALID_INDEX) {
+    printf("Shader has no uniform block: %s\n", block_name);
+    return;
+  }
+  glUniformBlockBinding(s->program, index, binding);
+}
 
 uint32_t shader_get_uniform(struct Shader const *s, char const *uniform_name) {
   return glGetUniformLocation(s->program, uniform_name);
@@ -98,10 +814,18 @@ uint32_t shader_get_uniform(struct Shader const *s, char const *uniform_name) {
 
 void shader_set_matrix_uniform(uint32_t uniform_location,
                                struct Matrix4 const *m) {
+  if (!gfx_uniform_changed(uniform_location, (float const *)m, 16))
+    return;
   glUniformMatrix4fv(uniform_location, 1, GL_FALSE, (GLfloat const *)m);
 }
 
 void shader_set_vector_uniform(uint32_t uniform_location,
                                struct Vector4 const *v) {
+  if (!gfx_uniform_changed(uniform_location, (float const *)v, 4))
+    return;
   glUniform4fv(uniform_location, 1, (GLfloat const *)v);
 }
+
+void shader_set_int_uniform(uint32_t uniform_location, int32_t value) {
+  glUniform1i(uniform_location, value);
+}
@@ -1,59 +1,215 @@
 #include "render/gfx_context.h"
 #include "gl.h"
 #include "platform/file.h"
+#include "render/frame_data.h"
 #include "render/gfx_api.h"
+#include "render/palette.h"
 #include "render/shader_files.h"
 
 #include <SDL.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define SCREEN_WIDTH 640
 #define SCREEN_HEIGHT 480
 
+// 4 corners per face, two triangles each through g_cube_indices.
 static const float g_cube_data[] = {
-    -0.5f, -0.5f, -0.5f, 0.0f,  0.0f,  -1.0f, 0.5f,  -0.5f, -0.5f,
-    0.0f,  0.0f,  -1.0f, 0.5f,  0.5f,  -0.5f, 0.0f,  0.0f,  -1.0f,
-    0.5f,  0.5f,  -0.5f, 0.0f,  0.0f,  -1.0f, -0.5f, 0.5f,  -0.5f,
-    0.0f,  0.0f,  -1.0f, -0.5f, -0.5f, -0.5f, 0.0f,  0.0f,  -1.0f,
-
-    -0.5f, -0.5f, 0.5f,  0.0f,  0.0f,  1.0f,  0.5f,  -0.5f, 0.5f,
-    0.0f,  0.0f,  1.0f,  0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,
-    0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  -0.5f, 0.5f,  0.5f,
-    0.0f,  0.0f,  1.0f,  -0.5f, -0.5f, 0.5f,  0.0f,  0.0f,  1.0f,
-
-    -0.5f, 0.5f,  0.5f,  -1.0f, 0.0f,  0.0f,  -0.5f, 0.5f,  -0.5f,
-    -1.0f, 0.0f,  0.0f,  -0.5f, -0.5f, -0.5f, -1.0f, 0.0f,  0.0f,
-    -0.5f, -0.5f, -0.5f, -1.0f, 0.0f,  0.0f,  -0.5f, -0.5f, 0.5f,
-    -1.0f, 0.0f,  0.0f,  -0.5f, 0.5f,  0.5f,  -1.0f, 0.0f,  0.0f,
-
-    0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  0.5f,  0.5f,  -0.5f,
-    1.0f,  0.0f,  0.0f,  0.5f,  -0.5f, -0.5f, 1.0f,  0.0f,  0.0f,
-    0.5f,  -0.5f, -0.5f, 1.0f,  0.0f,  0.0f,  0.5f,  -0.5f, 0.5f,
-    1.0f,  0.0f,  0.0f,  0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,
-
-    -0.5f, -0.5f, -0.5f, 0.0f,  -1.0f, 0.0f,  0.5f,  -0.5f, -0.5f,
-    0.0f,  -1.0f, 0.0f,  0.5f,  -0.5f, 0.5f,  0.0f,  -1.0f, 0.0f,
-    0.5f,  -0.5f, 0.5f,  0.0f,  -1.0f, 0.0f,  -0.5f, -0.5f, 0.5f,
-    0.0f,  -1.0f, 0.0f,  -0.5f, -0.5f, -0.5f, 0.0f,  -1.0f, 0.0f,
-
-    -0.5f, 0.5f,  -0.5f, 0.0f,  1.0f,  0.0f,  0.5f,  0.5f,  -0.5f,
-    0.0f,  1.0f,  0.0f,  0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,
-    0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  -0.5f, 0.5f,  0.5f,
-    0.0f,  1.0f,  0.0f,  -0.5f, 0.5f,  -0.5f, 0.0f,  1.0f,  0.0f};
-
-bool graphics_context_new(struct GraphicsContext *graphics) {
-  SDL_Window *window = NULL;
-  window = SDL_CreateWindow("TechJam 2024", SDL_WINDOWPOS_UNDEFINED,
-                            SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH,
-                            SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
-  if (NULL == window) {
-    printf("Could not initialize SDL Window! SDL_Error: %s\n", SDL_GetError());
+    -0.5f, -0.5f, -0.5f, 0.0f, 0.0f, -1.0f,
+    0.5f, -0.5f, -0.5f, 0.0f, 0.0f, -1.0f,
+    0.5f, 0.5f, -0.5f, 0.0f, 0.0f, -1.0f,
+    -0.5f, 0.5f, -0.5f, 0.0f, 0.0f, -1.0f,
+
+    -0.5f, -0.5f, 0.5f, 0.0f, 0.0f, 1.0f,
+    0.5f, -0.5f, 0.5f, 0.0f, 0.0f, 1.0f,
+    0.5f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f,
+    -0.5f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f,
+
+    -0.5f, 0.5f, 0.5f, -1.0f, 0.0f, 0.0f,
+    -0.5f, 0.5f, -0.5f, -1.0f, 0.0f, 0.0f,
+    -0.5f, -0.5f, -0.5f, -1.0f, 0.0f, 0.0f,
+    -0.5f, -0.5f, 0.5f, -1.0f, 0.0f, 0.0f,
+
+    0.5f, 0.5f, 0.5f, 1.0f, 0.0f, 0.0f,
+    0.5f, 0.5f, -0.5f, 1.0f, 0.0f, 0.0f,
+    0.5f, -0.5f, -0.5f, 1.0f, 0.0f, 0.0f,
+    0.5f, -0.5f, 0.5f, 1.0f, 0.0f, 0.0f,
+
+    -0.5f, -0.5f, -0.5f, 0.0f, -1.0f, 0.0f,
+    0.5f, -0.5f, -0.5f, 0.0f, -1.0f, 0.0f,
+    0.5f, -0.5f, 0.5f, 0.0f, -1.0f, 0.0f,
+    -0.5f, -0.5f, 0.5f, 0.0f, -1.0f, 0.0f,
+
+    -0.5f, 0.5f, -0.5f, 0.0f, 1.0f, 0.0f,
+    0.5f, 0.5f, -0.5f, 0.0f, 1.0f, 0.0f,
+    0.5f, 0.5f, 0.5f, 0.0f, 1.0f, 0.0f,
+    -0.5f, 0.5f, 0.5f, 0.0f, 1.0f, 0.0f};
+
+static const uint16_t g_cube_indices[CUBE_TRIGANGLE_COUNT] = {
+    0, 1, 2, 2, 3, 0,
+    4, 5, 6, 6, 7, 4,
+    8, 9, 10, 10, 11, 8,
+    12, 13, 14, 14, 15, 12,
+    16, 17, 18, 18, 19, 16,
+    20, 21, 22, 22, 23, 20};
+
+enum ShaderSourceIndex {
+  SHADER_BASIC_VS,
+  SHADER_BASIC_FS,
+  SHADER_INSTANCED_VS,
+  SHADER_VOXEL_PULL_VS
+};
+
+static char const *const g_shader_paths[GRAPHICS_SHADER_SOURCES] = {
+    BASIC_VS_PATH, BASIC_FS_PATH, BASIC_INSTANCED_VS_PATH, VOXEL_PULL_VS_PATH};
+
+static bool compile_shader(struct Shader *shader, char const *vs_src,
+                           char const *fs_src) {
+  if (!shader_new(shader, vs_src, fs_src)) {
+    printf("Could not compile shaders\n");
+    return false;
+  }
+  shader_bind_uniform_block(shader, FRAME_DATA_BLOCK, FRAME_DATA_BINDING);
+  shader_bind_uniform_block(shader, PALETTE_BLOCK, PALETTE_BINDING);
+  return true;
+}
+
+static bool load_shader(struct Shader *shader, char const *vs_path,
+                        char const *fs_path) {
+  struct File vs = {0}, fs = {0};
+  bool ok = file_read_all(&vs, vs_path) && file_read_all(&fs, fs_path);
+  if (!ok)
+    printf("Could not find shader files\n");
+  ok = ok && compile_shader(shader, vs.data, fs.data);
+
+  file_free(&vs);
+  file_free(&fs);
+  return ok;
+}
+
+static void set_shaders(struct GraphicsContext *graphics,
+                        struct Shader basic_lighting,
+                        struct Shader basic_instanced,
+                        struct Shader voxel_pull) {
+  graphics->basic_lighting = basic_lighting;
+  graphics->basic_lighting_model = shader_get_uniform(&basic_lighting, "model");
+  graphics->basic_instanced = basic_instanced;
+  graphics->voxel_pull = voxel_pull;
+  graphics->voxel_pull_model = shader_get_uniform(&voxel_pull, "model");
+  graphics->voxel_pull_faces = shader_get_uniform(&voxel_pull, "faces");
+}
+
+static void free_shader_sources(struct GraphicsContext *graphics) {
+  for (int i = 0; i < GRAPHICS_SHADER_SOURCES; ++i) {
+    file_free(&graphics->shader_sources[i].file);
+    graphics->shader_sources[i].file = (struct File){0};
+  }
+}
+
+static void shader_source_loaded(void *user, struct File *file, bool ok) {
+  struct ShaderSource *source = (struct ShaderSource *)user;
+  struct GraphicsContext *graphics = source->graphics;
+  source->file = *file;
+  if (!ok)
+    graphics->shader_read_failed = true;
+  if (--graphics->shader_reads_pending > 0)
+    return;
+
+  struct ShaderSource const *sources = graphics->shader_sources;
+  struct Shader basic_lighting, basic_instanced, voxel_pull;
+  bool compiled = !graphics->shader_read_failed &&
+                  compile_shader(&basic_lighting,
+                                 sources[SHADER_BASIC_VS].file.data,
+                                 sources[SHADER_BASIC_FS].file.data);
+  if (compiled && !compile_shader(&basic_instanced,
+                                  sources[SHADER_INSTANCED_VS].file.data,
+                                  sources[SHADER_BASIC_FS].file.data)) {
+    shader_free(&basic_lighting);
+    compiled = false;
+  }
+  if (compiled && !compile_shader(&voxel_pull,
+                                  sources[SHADER_VOXEL_PULL_VS].file.data,
+                                  sources[SHADER_BASIC_FS].file.data)) {
+    shader_free(&basic_lighting);
+    shader_free(&basic_instanced);
+    compiled = false;
+  }
+  free_shader_sources(graphics);
+
+  if (!compiled) {
+    printf("Shader reload failed, keeping the old programs\n");
+    return;
+  }
+  shader_free(&graphics->basic_lighting);
+  shader_free(&graphics->basic_instanced);
+  shader_free(&graphics->voxel_pull);
+  set_shaders(graphics, basic_lighting, basic_instanced, voxel_pull);
+  graphics->shader_generation++;
+  printf("Reloaded shaders\n");
+}
+
+bool graphics_context_reload_shaders(struct GraphicsContext *graphics,
+                                     struct FileIo *io) {
+  if (graphics->shader_reads_pending > 0)
+    return false;
+  graphics->shader_read_failed = false;
+  for (int i = 0; i < GRAPHICS_SHADER_SOURCES; ++i) {
+    struct ShaderSource *source = &graphics->shader_sources[i];
+    *source = (struct ShaderSource){.graphics = graphics};
+    struct FileReadDesc desc = {.path = g_shader_paths[i],
+                                .on_done = shader_source_loaded,
+                                .user = source};
+    if (file_io_read(io, &desc) != 0) {
+      graphics->shader_reads_pending++;
+    } else {
+      // whatever was queued still arrives, but won't be compiled
+      graphics->shader_read_failed = true;
+    }
+  }
+  return graphics->shader_reads_pending > 0;
+}
+
+// color and depth renderbuffers the size of the window, left bound for every
+// draw that follows.
+static bool create_offscreen_target(struct GraphicsContext *graphics) {
+  glGenRenderbuffers(1, (GLuint *)&graphics->color_renderbuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, graphics->color_renderbuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, graphics->width,
+                        graphics->height);
+  glGenRenderbuffers(1, (GLuint *)&graphics->depth_renderbuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, graphics->depth_renderbuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, graphics->width,
+                        graphics->height);
+
+  glGenFramebuffers(1, (GLuint *)&graphics->framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, graphics->framebuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, graphics->color_renderbuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                            GL_RENDERBUFFER, graphics->depth_renderbuffer);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    printf("Offscreen framebuffer is incomplete\n");
     return false;
   }
-  uint32_t width = SCREEN_WIDTH;
-  uint32_t height = SCREEN_HEIGHT;
+  glViewport(0, 0, graphics->width, graphics->height);
+  return true;
+}
+
+struct GraphicsConfig graphics_config_default(void) {
+  return (struct GraphicsConfig){
+      .width = SCREEN_WIDTH, .height = SCREEN_HEIGHT, .headless = false};
+}
+
+bool graphics_context_new(struct GraphicsContext *graphics,
+                          struct GraphicsConfig const *config) {
+  memset(graphics, 0, sizeof(*graphics));
+  bool headless = config->headless;
+#ifdef __EMSCRIPTEN__
+  headless = false;
+#endif
 
-  // Request an OpenGL 3.3 context (should be core)
+  // Request an OpenGL 3.3 context (should be core). set before the window
+  // exists, some backends pick the pixel format when the window is created
   SDL_GL_SetAttribute(SDL_GL_ACCELERATED_VISUAL, 1);
   SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
   SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
@@ -62,6 +218,20 @@ bool graphics_context_new(struct GraphicsContext *graphics) {
   SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
   SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
 
+  uint32_t flags = headless ? SDL_WINDOW_HIDDEN | SDL_WINDOW_OPENGL
+                            : SDL_WINDOW_SHOWN;
+  SDL_Window *window = NULL;
+  window = SDL_CreateWindow("TechJam 2024", SDL_WINDOWPOS_UNDEFINED,
+                            SDL_WINDOWPOS_UNDEFINED, config->width,
+                            config->height, flags);
+  if (NULL == window) {
+    printf("Could not initialize SDL Window! SDL_Error: %s\n", SDL_GetError());
+    return false;
+  }
+  graphics->window = window;
+  graphics->width = config->width;
+  graphics->height = config->height;
+
 #ifdef __EMSCRIPTEN__
   EmscriptenWebGLContextAttributes attrs;
   emscripten_webgl_init_context_attributes(
@@ -78,7 +248,10 @@ bool graphics_context_new(struct GraphicsContext *graphics) {
   emscripten_webgl_make_context_current(webgl_context);
 #endif
 
-  SDL_GL_CreateContext(window);
+  if (SDL_GL_CreateContext(window) == NULL) {
+    printf("Could not create a GL context! SDL_Error: %s\n", SDL_GetError());
+    return false;
+  }
 
 #ifndef __EMSCRIPTEN__
   if (!gladLoadGLLoader((GLADloadproc)SDL_GL_GetProcAddress)) {
@@ -87,67 +260,77 @@ bool graphics_context_new(struct GraphicsContext *graphics) {
   }
 #endif
 
+  gfx_state_reset();
+
+  if (headless && !create_offscreen_target(graphics))
+    return false;
+
   glClearColor(0.2f, 0.3f, 0.3f, 1.f);
   glClear(GL_COLOR_BUFFER_BIT);
 
   // float vertices[] = {-0.5f, -0.5f, 0.0f, 0.5f, -0.5f, 0.0f, 0.0f, 0.5f,
   // 0.0f};
   struct Mesh cube = mesh_new();
-  mesh_fill(&cube, g_cube_data, sizeof(g_cube_data));
+  struct VertexLayout cube_layout = vertex_layout_position_normal();
+  mesh_fill(&cube, &cube_layout, g_cube_data, sizeof(g_cube_data));
+  mesh_fill_indices(&cube, g_cube_indices, CUBE_TRIGANGLE_COUNT,
+                    INDEX_TYPE_U16);
 
-  struct File vs, fs;
-  if (!file_read_all(&vs, BASIC_VS_PATH) ||
-      !file_read_all(&fs, BASIC_FS_PATH)) {
-    printf("Could not find shader files\n");
-    return false;
-  }
   struct Shader basic_lighting;
-  if (!shader_new(&basic_lighting, vs.data, fs.data)) {
-    printf("Could not compile shaders\n");
+  if (!load_shader(&basic_lighting, BASIC_VS_PATH, BASIC_FS_PATH))
+    return false;
+  struct Shader basic_instanced;
+  if (!load_shader(&basic_instanced, BASIC_INSTANCED_VS_PATH, BASIC_FS_PATH))
+    return false;
+  struct Shader voxel_pull;
+  if (!load_shader(&voxel_pull, VOXEL_PULL_VS_PATH, BASIC_FS_PATH))
     return false;
+  set_shaders(graphics, basic_lighting, basic_instanced, voxel_pull);
+  graphics->frame_data =
+      uniform_buffer_new(sizeof(struct FrameData), FRAME_DATA_BINDING);
+  graphics->palette = uniform_buffer_new(PALETTE_SIZE, PALETTE_BINDING);
+  graphics->cube = cube;
+  graphics_context_present(graphics);
+  return true;
+}
+
+void graphics_context_free(struct GraphicsContext *graphics) {
+  // sources of a reload that never finished
+  free_shader_sources(graphics);
+  if (graphics->framebuffer != 0) {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, (GLuint *)&graphics->framebuffer);
+    glDeleteRenderbuffers(1, (GLuint *)&graphics->color_renderbuffer);
+    glDeleteRenderbuffers(1, (GLuint *)&graphics->depth_renderbuffer);
   }
+  if (graphics->window != NULL)
+    SDL_DestroyWindow(graphics->window);
+  memset(graphics, 0, sizeof(*graphics));
+}
 
-  file_free(&vs);
-  file_free(&fs);
+void graphics_context_present(struct GraphicsContext const *graphics) {
+  if (graphics->framebuffer != 0) {
+    glFinish();
+  } else {
+    SDL_GL_SwapWindow(graphics->window);
+  }
+}
 
-  shader_bind(&basic_lighting);
-
-  uint32_t basic_lighting_view_proj =
-      shader_get_uniform(&basic_lighting, "view_proj");
-  uint32_t basic_lighting_model = shader_get_uniform(&basic_lighting, "model");
-  uint32_t basic_lighting_color = shader_get_uniform(&basic_lighting, "color");
-  uint32_t basic_lighting_ambient_dir =
-      shader_get_uniform(&basic_lighting, "ambient_dir");
-  uint32_t basic_lighting_ambient_color =
-      shader_get_uniform(&basic_lighting, "ambient_color");
-  uint32_t basic_lighting_light_pos =
-      shader_get_uniform(&basic_lighting, "light_pos");
-  uint32_t basic_lighting_light_color =
-      shader_get_uniform(&basic_lighting, "light_color");
-  uint32_t basic_lighting_camera_eye =
-      shader_get_uniform(&basic_lighting, "camera_eye");
-  uint32_t basic_lighting_fog_color =
-      shader_get_uniform(&basic_lighting, "fog_color");
-  uint32_t basic_lighting_fog_props =
-      shader_get_uniform(&basic_lighting, "fog_props");
-
-  SDL_GL_SwapWindow(window);
-
-  *graphics = (struct GraphicsContext){
-      .window = window,
-      .width = width,
-      .height = height,
-      .basic_lighting = basic_lighting,
-      .basic_lighting_color = basic_lighting_color,
-      .basic_lighting_ambient_dir = basic_lighting_ambient_dir,
-      .basic_lighting_ambient_color = basic_lighting_ambient_color,
-      .basic_lighting_light_pos = basic_lighting_light_pos,
-      .basic_lighting_light_color = basic_lighting_light_color,
-      .basic_lighting_camera_eye = basic_lighting_camera_eye,
-      .basic_lighting_fog_color = basic_lighting_fog_color,
-      .basic_lighting_fog_props = basic_lighting_fog_props,
-      .basic_lighting_view_proj = basic_lighting_view_proj,
-      .basic_lighting_model = basic_lighting_model,
-      .cube = cube};
-  return true;
+void graphics_context_read_pixels(struct GraphicsContext const *graphics,
+                                  uint8_t *pixels) {
+  size_t row_size = (size_t)graphics->width * 4;
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, graphics->width, graphics->height, GL_RGBA,
+               GL_UNSIGNED_BYTE, pixels);
+
+  // GL returns the bottom row first
+  for (uint32_t y = 0; y < graphics->height / 2; ++y) {
+    uint8_t *top = pixels + y * row_size;
+    uint8_t *bottom = pixels + (graphics->height - 1 - y) * row_size;
+    for (size_t i = 0; i < row_size; ++i) {
+      uint8_t t = top[i];
+      top[i] = bottom[i];
+      bottom[i] = t;
+    }
+  }
 }
@@ -0,0 +1,169 @@
+#include "render/voxel_renderer.h"
+
+#include "core/profiler.h"
+#include "gl.h"
+#include "math/matrix4.h"
+#include "voxel/grid.h"
+#include "voxel/mesher.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// MeshVertex as two uvec4 inputs: position and face_ao, then color and the
+// reserved bytes.
+static struct VertexLayout const g_voxel_layout = {
+    .stride = sizeof(struct MeshVertex),
+    .attrib_count = 2,
+    .attribs = {{.location = 0,
+                 .components = 4,
+                 .type = VERTEX_TYPE_U8,
+                 .integer = true},
+                {.location = 1,
+                 .components = 4,
+                 .type = VERTEX_TYPE_U8,
+                 .offset = offsetof(struct MeshVertex, color),
+                 .integer = true}}};
+
+struct VoxelRenderer voxel_renderer_new(struct Grid const *grid,
+                                        struct JobSystem *jobs,
+                                        enum MeshFormat format) {
+  struct VoxelRenderer renderer = {.format = format};
+  uint32_t chunk_count = grid_chunk_count(grid);
+  renderer.chunks =
+      (struct ChunkMesh *)calloc(chunk_count, sizeof(struct ChunkMesh));
+  if (renderer.chunks == NULL) {
+    printf("Failed to allocate chunk meshes\n");
+    return renderer;
+  }
+  if (!mesh_queue_new(&renderer.queue, grid, jobs, format)) {
+    free(renderer.chunks);
+    renderer.chunks = NULL;
+    return renderer;
+  }
+  renderer.chunk_count = chunk_count;
+  renderer.quad_indices = quad_index_buffer_new(VOXEL_MAX_CHUNK_QUADS);
+  if (format == MESH_FORMAT_FACES) {
+    // its vertex buffer stays empty, the shader reads the faces instead
+    renderer.pull_mesh = mesh_new();
+    mesh_set_index_buffer(&renderer.pull_mesh, renderer.quad_indices.buffer,
+                          renderer.quad_indices.type);
+  }
+  return renderer;
+}
+
+void voxel_renderer_free(struct VoxelRenderer *renderer) {
+  mesh_queue_free(&renderer->queue);
+  for (uint32_t i = 0; i < renderer->chunk_count; ++i) {
+    if (renderer->chunks[i].mesh.vao != 0)
+      mesh_free(&renderer->chunks[i].mesh);
+    if (renderer->chunks[i].faces.texture != 0)
+      data_texture_free(&renderer->chunks[i].faces);
+  }
+  free(renderer->chunks);
+  if (renderer->pull_mesh.vao != 0)
+    mesh_free(&renderer->pull_mesh);
+  if (renderer->quad_indices.buffer != 0)
+    quad_index_buffer_free(&renderer->quad_indices);
+  *renderer = (struct VoxelRenderer){0};
+}
+
+static void voxel_renderer_upload(struct VoxelRenderer *renderer,
+                                  struct MeshResult const *result) {
+  struct ChunkMesh *chunk = &renderer->chunks[result->chunk_index];
+  renderer->chunks_remeshed++;
+  renderer->vertex_bytes -=
+      chunk->vertex_count / 4 * mesh_format_quad_size(renderer->format);
+
+  if (result->data.vertex_count == 0) {
+    // keep the buffers around, the chunk is likely to be edited again
+    chunk->vertex_count = 0;
+    return;
+  }
+
+  uint64_t start = profiler_now();
+  size_t size = result->data.vertices_size;
+  if (renderer->format == MESH_FORMAT_FACES) {
+    if (chunk->faces.texture == 0)
+      chunk->faces = data_texture_new();
+    data_texture_fill(&chunk->faces, (uint32_t const *)result->data.vertices,
+                      (uint32_t)(size / sizeof(uint32_t)));
+  } else {
+    if (chunk->mesh.vao == 0) {
+      chunk->mesh = mesh_new();
+      mesh_set_index_buffer(&chunk->mesh, renderer->quad_indices.buffer,
+                            renderer->quad_indices.type);
+    }
+    mesh_fill(&chunk->mesh, &g_voxel_layout, result->data.vertices, size);
+  }
+  renderer->upload_ns += profiler_now() - start;
+  chunk->vertex_count = result->data.vertex_count;
+  renderer->bytes_uploaded += size;
+  renderer->vertex_bytes += size;
+}
+
+void voxel_renderer_update(struct VoxelRenderer *renderer, struct Grid *grid) {
+  renderer->chunks_remeshed = 0;
+  renderer->bytes_uploaded = 0;
+  renderer->upload_ns = 0;
+  if (renderer->chunk_count == 0)
+    return;
+
+  mesh_queue_dispatch(&renderer->queue, grid, MESH_QUEUE_DISPATCH_BUDGET);
+
+  // whatever doesn't fit stays queued, an edit to the chunk in the meantime
+  // just means a newer mesh follows this one
+  while (renderer->bytes_uploaded < VOXEL_UPLOAD_BUDGET) {
+    struct MeshResult *result = mesh_queue_pop(&renderer->queue);
+    if (result == NULL)
+      break;
+    voxel_renderer_upload(renderer, result);
+    mesh_queue_release(&renderer->queue, result);
+  }
+}
+
+void voxel_renderer_draw(struct VoxelRenderer *renderer,
+                         struct Grid const *grid,
+                         struct Matrix4 const *view_proj,
+                         uint32_t model_uniform) {
+  struct Vector4 planes[6];
+  Matrix4_frustum_planes(view_proj, planes);
+
+  renderer->chunks_tested = 0;
+  renderer->chunks_culled = 0;
+  for (uint32_t i = 0; i < renderer->chunk_count; ++i) {
+    struct ChunkMesh const *chunk = &renderer->chunks[i];
+    if (chunk->vertex_count == 0)
+      continue;
+
+    // voxels are centered on integer coordinates
+    uint32_t cx, cy, cz;
+    grid_chunk_coords(grid, i, &cx, &cy, &cz);
+    struct Vector4 min = Vector4_new_point(
+        grid->origin.x + (float)(cx << GRID_CHUNK_SHIFT) - 0.5f,
+        grid->origin.y + (float)(cy << GRID_CHUNK_SHIFT) - 0.5f,
+        grid->origin.z + (float)(cz << GRID_CHUNK_SHIFT) - 0.5f);
+    struct Vector4 max =
+        Vector4_new_point(min.x + GRID_CHUNK_SIZE, min.y + GRID_CHUNK_SIZE,
+                          min.z + GRID_CHUNK_SIZE);
+
+    renderer->chunks_tested++;
+    if (!Matrix4_frustum_intersects_aabb(planes, min, max)) {
+      renderer->chunks_culled++;
+      continue;
+    }
+
+    // packed positions start at the chunk's min corner
+    struct Matrix4 model = Matrix4_translation(min.x, min.y, min.z);
+    shader_set_matrix_uniform(model_uniform, &model);
+    uint32_t quads = chunk->vertex_count / 4;
+    if (quads > renderer->quad_indices.quad_count)
+      quads = renderer->quad_indices.quad_count;
+    if (renderer->format == MESH_FORMAT_FACES) {
+      data_texture_bind(&chunk->faces, VOXEL_FACES_TEXTURE_UNIT);
+      mesh_draw(&renderer->pull_mesh, quads * 6);
+    } else {
+      mesh_draw(&chunk->mesh, quads * 6);
+    }
+  }
+}
@@ -1,33 +1,499 @@
 #include "voxel/grid.h"
 #include "render/colors.h"
+
+#include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 struct Grid grid_new(uint32_t x, uint32_t y, uint32_t z,
                      struct Vector4 origin) {
-  struct Grid result =
-      (struct Grid){.origin = origin, .size_x = x, .size_y = y, .size_z = z};
-  result.data = (char *)calloc(x * y * z, sizeof(char));
-  result.color_palette[GRID_BEIGE] = BEIGE;
-  result.color_palette[GRID_BEIGE_R] = BEIGE_R;
-  result.color_palette[GRID_TAN] = TAN;
-  result.color_palette[GRID_MAUVE] = MAUVE;
-  result.color_palette[GRID_GREEN_BRIGHT] = GREEN_BRIGHT;
-  result.color_palette[GRID_GREEN_LIGHT] = GREEN_LIGHT;
-  result.color_palette[GRID_GREEN] = GREEN;
-  result.color_palette[GRID_GREEN_DARK] = GREEN_DARK;
-  result.color_palette[GRID_ORANGE] = ORANGE;
-  result.color_palette[GRID_RED] = RED;
+  return grid_new_with_storage(x, y, z, origin, GRID_STORAGE_DENSE);
+}
+
+struct Grid grid_new_with_storage(uint32_t x, uint32_t y, uint32_t z,
+                                  struct Vector4 origin,
+                                  enum GridStorage storage) {
+  struct Grid result = (struct Grid){.origin = origin,
+                                     .size_x = x,
+                                     .size_y = y,
+                                     .size_z = z,
+                                     .storage = storage};
+  result.chunks_x = (x + GRID_CHUNK_MASK) >> GRID_CHUNK_SHIFT;
+  result.chunks_y = (y + GRID_CHUNK_MASK) >> GRID_CHUNK_SHIFT;
+  result.chunks_z = (z + GRID_CHUNK_MASK) >> GRID_CHUNK_SHIFT;
+
+  uint32_t chunk_count = grid_chunk_count(&result);
+  result.chunks =
+      (struct GridChunk **)calloc(chunk_count, sizeof(struct GridChunk *));
+  result.chunk_dirty = (uint8_t *)calloc(chunk_count, sizeof(uint8_t));
+  if (result.chunks == NULL || result.chunk_dirty == NULL) {
+    printf("Failed to allocate grid chunk directory\n");
+  }
+
+  for (uint32_t i = 0; i < GRID_MAX_COLORS; ++i) {
+    result.palette[i].roughness = 1.f;
+  }
+  result.palette[GRID_BEIGE].color = BEIGE;
+  result.palette[GRID_BEIGE_R].color = BEIGE_R;
+  result.palette[GRID_TAN].color = TAN;
+  result.palette[GRID_MAUVE].color = MAUVE;
+  result.palette[GRID_GREEN_BRIGHT].color = GREEN_BRIGHT;
+  result.palette[GRID_GREEN_LIGHT].color = GREEN_LIGHT;
+  result.palette[GRID_GREEN].color = GREEN;
+  result.palette[GRID_GREEN_DARK].color = GREEN_DARK;
+  result.palette[GRID_ORANGE].color = ORANGE;
+  result.palette[GRID_RED].color = RED;
+  result.palette_dirty_end = GRID_MAX_COLORS;
 
   return result;
 }
 
-void grid_free(struct Grid *grid) { free(grid->data); }
+static struct GridChunk *grid_chunk_new(enum GridStorage storage) {
+  struct GridChunk *chunk =
+      (struct GridChunk *)calloc(1, sizeof(struct GridChunk));
+  if (chunk == NULL)
+    goto fail;
+
+  if (storage == GRID_STORAGE_DENSE) {
+    chunk->voxels = (char *)calloc(GRID_CHUNK_VOLUME, sizeof(char));
+    if (chunk->voxels == NULL)
+      goto fail;
+  } else {
+    // new chunks are all air, which is palette entry 0
+    chunk->bits = 1;
+    chunk->palette = (char *)malloc(1u << chunk->bits);
+    chunk->words = (uint32_t *)calloc(GRID_CHUNK_VOLUME / 32, sizeof(uint32_t));
+    if (chunk->palette == NULL || chunk->words == NULL)
+      goto fail;
+    chunk->palette_size = 1;
+    chunk->palette[0] = GRID_EMPTY;
+  }
+  return chunk;
+
+fail:
+  printf("Failed to allocate grid chunk\n");
+  if (chunk != NULL) {
+    free(chunk->voxels);
+    free(chunk->palette);
+    free(chunk->words);
+  }
+  free(chunk);
+  return NULL;
+}
+
+static void grid_chunk_free(struct GridChunk *chunk) {
+  if (chunk == NULL)
+    return;
+  if (!chunk->borrowed)
+    free(chunk->voxels);
+  free(chunk->words);
+  free(chunk->palette);
+  free(chunk);
+}
+
+static size_t grid_chunk_memory_usage(struct GridChunk const *chunk) {
+  size_t bytes = sizeof(struct GridChunk);
+  if (chunk->voxels != NULL)
+    bytes += GRID_CHUNK_VOLUME;
+  if (chunk->words != NULL)
+    bytes += GRID_CHUNK_VOLUME / 8 * chunk->bits + (1u << chunk->bits);
+  return bytes;
+}
+
+// bits is always a power of two so an index never straddles two words.
+static uint32_t grid_packed_get(struct GridChunk const *chunk,
+                                uint32_t index) {
+  uint32_t bit = index * chunk->bits;
+  uint32_t mask = (1u << chunk->bits) - 1;
+  return (chunk->words[bit >> 5] >> (bit & 31)) & mask;
+}
+
+static void grid_packed_set(struct GridChunk *chunk, uint32_t index,
+                            uint32_t value) {
+  uint32_t bit = index * chunk->bits;
+  uint32_t mask = ((1u << chunk->bits) - 1) << (bit & 31);
+  uint32_t *word = &chunk->words[bit >> 5];
+  *word = (*word & ~mask) | (value << (bit & 31));
+}
+
+// doubles the index width and the palette with it, the palette only ever
+// grows so this happens at most three times per chunk.
+static bool grid_packed_widen(struct GridChunk *chunk) {
+  struct GridChunk wider = *chunk;
+  wider.bits = chunk->bits * 2;
+  char *palette = (char *)realloc(chunk->palette, 1u << wider.bits);
+  if (palette == NULL) {
+    printf("Failed to widen grid chunk\n");
+    return false;
+  }
+  chunk->palette = palette;
+  wider.words = (uint32_t *)calloc(GRID_CHUNK_VOLUME / 32 * wider.bits,
+                                   sizeof(uint32_t));
+  if (wider.words == NULL) {
+    printf("Failed to widen grid chunk\n");
+    return false;
+  }
+
+  for (uint32_t i = 0; i < GRID_CHUNK_VOLUME; ++i) {
+    grid_packed_set(&wider, i, grid_packed_get(chunk, i));
+  }
+  free(chunk->words);
+  chunk->words = wider.words;
+  chunk->bits = wider.bits;
+  return true;
+}
+
+static bool grid_packed_palette_index(struct GridChunk *chunk, char value,
+                                      uint32_t *index) {
+  for (uint32_t i = 0; i < chunk->palette_size; ++i) {
+    if (chunk->palette[i] == value) {
+      *index = i;
+      return true;
+    }
+  }
+
+  if (chunk->palette_size >= GRID_MAX_COLORS) {
+    printf("Grid chunk palette is full\n");
+    return false;
+  }
+  if (chunk->palette_size >= (1u << chunk->bits) && !grid_packed_widen(chunk))
+    return false;
+
+  *index = chunk->palette_size;
+  chunk->palette[chunk->palette_size++] = value;
+  return true;
+}
+
+static char grid_chunk_get(struct GridChunk const *chunk, uint32_t index) {
+  if (chunk->voxels != NULL)
+    return chunk->voxels[index];
+  return chunk->palette[grid_packed_get(chunk, index)];
+}
+
+void grid_free(struct Grid *grid) {
+  uint32_t chunk_count = grid_chunk_count(grid);
+  for (uint32_t i = 0; i < chunk_count && grid->chunks; ++i) {
+    grid_chunk_free(grid->chunks[i]);
+  }
+  free(grid->chunks);
+  free(grid->chunk_dirty);
+  grid->chunks = NULL;
+  grid->chunk_dirty = NULL;
+}
+
+static uint32_t grid_chunk_index_of(struct Grid const *grid, uint32_t x,
+                                    uint32_t y, uint32_t z) {
+  return grid_chunk_index(grid, x >> GRID_CHUNK_SHIFT, y >> GRID_CHUNK_SHIFT,
+                          z >> GRID_CHUNK_SHIFT);
+}
+
+static uint32_t grid_local_index(uint32_t x, uint32_t y, uint32_t z) {
+  return ((z & GRID_CHUNK_MASK) << (2 * GRID_CHUNK_SHIFT)) |
+         ((y & GRID_CHUNK_MASK) << GRID_CHUNK_SHIFT) | (x & GRID_CHUNK_MASK);
+}
 
 char grid_get(struct Grid const *grid, uint32_t x, uint32_t y, uint32_t z) {
-  return grid->data[grid->size_x * grid->size_y * z + grid->size_x * y + x];
+  struct GridChunk const *chunk = grid->chunks[grid_chunk_index_of(grid, x, y, z)];
+  if (chunk == NULL)
+    return GRID_EMPTY;
+  return grid_chunk_get(chunk, grid_local_index(x, y, z));
+}
+
+// a voxel is read by the meshes of every chunk holding one of its 26
+// neighbours: through a shared face, or through the ambient occlusion of a
+// face along an edge or corner. only voxels on the chunk's boundary reach
+// past it, up to 8 chunks for a corner voxel.
+static void grid_mark_dirty(struct Grid *grid, uint32_t x, uint32_t y,
+                            uint32_t z) {
+  uint32_t p[3] = {x, y, z};
+  uint32_t chunks[3] = {grid->chunks_x, grid->chunks_y, grid->chunks_z};
+  uint32_t lo[3], hi[3];
+  for (int i = 0; i < 3; ++i) {
+    uint32_t c = p[i] >> GRID_CHUNK_SHIFT;
+    uint32_t local = p[i] & GRID_CHUNK_MASK;
+    lo[i] = local == 0 && c > 0 ? c - 1 : c;
+    hi[i] = local == GRID_CHUNK_MASK && c + 1 < chunks[i] ? c + 1 : c;
+  }
+  for (uint32_t cz = lo[2]; cz <= hi[2]; ++cz) {
+    for (uint32_t cy = lo[1]; cy <= hi[1]; ++cy) {
+      for (uint32_t cx = lo[0]; cx <= hi[0]; ++cx) {
+        grid->chunk_dirty[grid_chunk_index(grid, cx, cy, cz)] = 1;
+      }
+    }
+  }
 }
 
 void grid_set(struct Grid *grid, uint32_t x, uint32_t y, uint32_t z,
               char value) {
-  grid->data[grid->size_x * grid->size_y * z + grid->size_x * y + x] = value;
+  uint32_t index = grid_chunk_index_of(grid, x, y, z);
+  struct GridChunk *chunk = grid->chunks[index];
+  if (chunk == NULL) {
+    if (value == GRID_EMPTY)
+      return;
+    chunk = grid_chunk_new(grid->storage);
+    if (chunk == NULL)
+      return;
+    grid->chunks[index] = chunk;
+  }
+
+  uint32_t local = grid_local_index(x, y, z);
+  char previous = grid_chunk_get(chunk, local);
+  if (previous == value)
+    return;
+
+  if (chunk->voxels != NULL) {
+    chunk->voxels[local] = value;
+  } else {
+    uint32_t palette_index = 0;
+    if (!grid_packed_palette_index(chunk, value, &palette_index))
+      return;
+    grid_packed_set(chunk, local, palette_index);
+  }
+
+  if (previous == GRID_EMPTY)
+    chunk->solid_count++;
+  else if (value == GRID_EMPTY)
+    chunk->solid_count--;
+
+  grid_mark_dirty(grid, x, y, z);
+
+  // hand all air chunks back so large empty regions stay cheap
+  if (chunk->solid_count == 0) {
+    grid_chunk_free(chunk);
+    grid->chunks[index] = NULL;
+  }
+}
+
+// advances the dda into the next cell, returns the axis that was crossed.
+static int grid_ray_step(int32_t cell[3], int32_t const step[3],
+                         float t_max[3], float const t_delta[3], float *t) {
+  int axis = t_max[0] < t_max[1] ? (t_max[0] < t_max[2] ? 0 : 2)
+                                 : (t_max[1] < t_max[2] ? 1 : 2);
+  *t = t_max[axis];
+  t_max[axis] += t_delta[axis];
+  cell[axis] += step[axis];
+  return axis;
+}
+
+bool grid_raycast(struct Grid const *grid, struct Vector4 origin,
+                  struct Vector4 direction, float max_distance,
+                  struct GridRayHit *hit) {
+  float length = sqrtf(direction.x * direction.x + direction.y * direction.y +
+                       direction.z * direction.z);
+  if (length == 0.f)
+    return false;
+
+  // voxels are centered on integer coordinates, shift by half a voxel so
+  // cell i covers [i, i + 1) in grid space
+  float p[3] = {origin.x - grid->origin.x + 0.5f,
+                origin.y - grid->origin.y + 0.5f,
+                origin.z - grid->origin.z + 0.5f};
+  float d[3] = {direction.x / length, direction.y / length,
+                direction.z / length};
+  float size[3] = {(float)grid->size_x, (float)grid->size_y,
+                   (float)grid->size_z};
+
+  // clip the ray against the grid bounds
+  float t_enter = 0.f;
+  float t_exit = max_distance;
+  int enter_axis = -1;
+  for (int i = 0; i < 3; ++i) {
+    if (d[i] == 0.f) {
+      if (p[i] < 0.f || p[i] >= size[i])
+        return false;
+      continue;
+    }
+    float t0 = (0.f - p[i]) / d[i];
+    float t1 = (size[i] - p[i]) / d[i];
+    if (t0 > t1) {
+      float t = t0;
+      t0 = t1;
+      t1 = t;
+    }
+    if (t0 > t_enter) {
+      t_enter = t0;
+      enter_axis = i;
+    }
+    if (t1 < t_exit)
+      t_exit = t1;
+  }
+  if (t_enter > t_exit)
+    return false;
+
+  int32_t cell[3];
+  int32_t step[3];
+  float t_max[3];
+  float t_delta[3];
+  int32_t limit[3] = {(int32_t)grid->size_x, (int32_t)grid->size_y,
+                      (int32_t)grid->size_z};
+  for (int i = 0; i < 3; ++i) {
+    float start = p[i] + d[i] * t_enter;
+    cell[i] = (int32_t)floorf(start);
+    // the entry point can land exactly on the far boundary
+    if (cell[i] >= limit[i])
+      cell[i] = limit[i] - 1;
+    if (cell[i] < 0)
+      cell[i] = 0;
+
+    if (d[i] > 0.f) {
+      step[i] = 1;
+      t_delta[i] = 1.f / d[i];
+      t_max[i] = t_enter + (cell[i] + 1 - start) * t_delta[i];
+    } else if (d[i] < 0.f) {
+      step[i] = -1;
+      t_delta[i] = -1.f / d[i];
+      t_max[i] = t_enter + (start - cell[i]) * t_delta[i];
+    } else {
+      step[i] = 0;
+      t_delta[i] = INFINITY;
+      t_max[i] = INFINITY;
+    }
+  }
+
+  float t = t_enter;
+  int axis = enter_axis;
+  while (t <= t_exit) {
+    struct GridChunk const *chunk = grid->chunks[grid_chunk_index_of(
+        grid, cell[0], cell[1], cell[2])];
+
+    if (chunk == NULL) {
+      // walk out of the empty chunk without touching voxel memory
+      int32_t chunk_cell[3] = {cell[0] >> GRID_CHUNK_SHIFT,
+                               cell[1] >> GRID_CHUNK_SHIFT,
+                               cell[2] >> GRID_CHUNK_SHIFT};
+      do {
+        axis = grid_ray_step(cell, step, t_max, t_delta, &t);
+        if (cell[axis] < 0 || cell[axis] >= limit[axis] || t > t_exit)
+          return false;
+      } while ((cell[axis] >> GRID_CHUNK_SHIFT) == chunk_cell[axis]);
+      continue;
+    }
+
+    if (grid_chunk_get(chunk, grid_local_index(cell[0], cell[1], cell[2])) !=
+        GRID_EMPTY) {
+      float normal[3] = {0.f, 0.f, 0.f};
+      if (axis >= 0)
+        normal[axis] = (float)-step[axis];
+      *hit = (struct GridRayHit){
+          .x = cell[0],
+          .y = cell[1],
+          .z = cell[2],
+          .normal = Vector4_new_vector(normal[0], normal[1], normal[2]),
+          .distance = t};
+      return true;
+    }
+
+    axis = grid_ray_step(cell, step, t_max, t_delta, &t);
+    if (cell[axis] < 0 || cell[axis] >= limit[axis])
+      return false;
+  }
+  return false;
+}
+
+uint32_t grid_raycast_batch(struct Grid const *grid,
+                            struct Vector4 const *origins,
+                            struct Vector4 const *directions, uint32_t count,
+                            float max_distance, struct GridRayHit *hits,
+                            bool *hit_mask) {
+  uint32_t hit_count = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    hit_mask[i] =
+        grid_raycast(grid, origins[i], directions[i], max_distance, &hits[i]);
+    hit_count += hit_mask[i];
+  }
+  return hit_count;
+}
+
+uint32_t grid_chunk_count(struct Grid const *grid) {
+  return grid->chunks_x * grid->chunks_y * grid->chunks_z;
+}
+
+uint32_t grid_chunk_index(struct Grid const *grid, uint32_t cx, uint32_t cy,
+                          uint32_t cz) {
+  return (cz * grid->chunks_y + cy) * grid->chunks_x + cx;
+}
+
+void grid_chunk_coords(struct Grid const *grid, uint32_t index, uint32_t *cx,
+                       uint32_t *cy, uint32_t *cz) {
+  *cx = index % grid->chunks_x;
+  *cy = (index / grid->chunks_x) % grid->chunks_y;
+  *cz = index / (grid->chunks_x * grid->chunks_y);
+}
+
+bool grid_chunk_is_dirty(struct Grid const *grid, uint32_t index) {
+  return grid->chunk_dirty[index] != 0;
+}
+
+void grid_chunk_clear_dirty(struct Grid *grid, uint32_t index) {
+  grid->chunk_dirty[index] = 0;
+}
+
+void grid_mark_all_dirty(struct Grid *grid) {
+  memset(grid->chunk_dirty, 1, grid_chunk_count(grid));
+}
+
+void grid_set_material(struct Grid *grid, uint8_t index,
+                       struct GridMaterial const *material) {
+  grid->palette[index] = *material;
+  if (grid->palette_dirty_begin == grid->palette_dirty_end) {
+    grid->palette_dirty_begin = index;
+    grid->palette_dirty_end = index + 1u;
+    return;
+  }
+  // one range, so a batch of edits is still a single upload
+  if (index < grid->palette_dirty_begin)
+    grid->palette_dirty_begin = index;
+  if (index + 1u > grid->palette_dirty_end)
+    grid->palette_dirty_end = index + 1u;
+}
+
+void grid_palette_clear_dirty(struct Grid *grid) {
+  grid->palette_dirty_begin = 0;
+  grid->palette_dirty_end = 0;
+}
+
+void grid_chunk_read(struct Grid const *grid, uint32_t index, char *out) {
+  struct GridChunk const *chunk = grid->chunks[index];
+  if (chunk == NULL) {
+    memset(out, GRID_EMPTY, GRID_CHUNK_VOLUME);
+  } else if (chunk->voxels != NULL) {
+    memcpy(out, chunk->voxels, GRID_CHUNK_VOLUME);
+  } else {
+    for (uint32_t i = 0; i < GRID_CHUNK_VOLUME; ++i) {
+      out[i] = grid_chunk_get(chunk, i);
+    }
+  }
+}
+
+bool grid_chunk_attach(struct Grid *grid, uint32_t index, char *voxels,
+                       uint32_t solid_count, bool borrowed) {
+  if (grid->storage != GRID_STORAGE_DENSE) {
+    printf("Grid chunks can only be attached to dense grids\n");
+    return false;
+  }
+  struct GridChunk *chunk =
+      (struct GridChunk *)calloc(1, sizeof(struct GridChunk));
+  if (chunk == NULL) {
+    printf("Failed to allocate grid chunk\n");
+    return false;
+  }
+  chunk->voxels = voxels;
+  chunk->borrowed = borrowed;
+  chunk->solid_count = solid_count;
+
+  grid_chunk_free(grid->chunks[index]);
+  grid->chunks[index] = chunk;
+  grid->chunk_dirty[index] = 1;
+  return true;
+}
+
+size_t grid_memory_usage(struct Grid const *grid) {
+  uint32_t chunk_count = grid_chunk_count(grid);
+  size_t bytes = chunk_count * (sizeof(struct GridChunk *) + sizeof(uint8_t));
+  for (uint32_t i = 0; i < chunk_count; ++i) {
+    if (grid->chunks[i] != NULL)
+      bytes += grid_chunk_memory_usage(grid->chunks[i]);
+  }
+  return bytes;
 }
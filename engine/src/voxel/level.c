@@ -0,0 +1,189 @@
+#include "voxel/level.h"
+
+#include "platform/compress.h"
+#include "platform/file.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool level_write_padding(FILE *fp, uint64_t *offset) {
+  static uint8_t const zeros[LEVEL_ALIGNMENT] = {0};
+  uint64_t padding = (LEVEL_ALIGNMENT - *offset % LEVEL_ALIGNMENT) %
+                     LEVEL_ALIGNMENT;
+  *offset += padding;
+  return fwrite(zeros, 1, padding, fp) == padding;
+}
+
+bool level_save(struct Grid const *grid, char const *path, bool compress) {
+  uint32_t chunk_count = grid_chunk_count(grid);
+  struct LevelChunk *entries =
+      (struct LevelChunk *)calloc(chunk_count, sizeof(struct LevelChunk));
+  char *voxels = (char *)malloc(GRID_CHUNK_VOLUME);
+  uint8_t *packed = (uint8_t *)malloc(lz_compress_bound(GRID_CHUNK_VOLUME));
+  FILE *fp = fopen(path, "wb");
+  bool ok = entries != NULL && voxels != NULL && packed != NULL && fp != NULL;
+  if (!ok) {
+    printf("Could not open %s for writing\n", path);
+    goto exit;
+  }
+
+  struct LevelHeader header = {.version = LEVEL_VERSION,
+                               .size = {grid->size_x, grid->size_y,
+                                        grid->size_z},
+                               .chunk_count = chunk_count,
+                               .origin = {grid->origin.x, grid->origin.y,
+                                          grid->origin.z, grid->origin.w}};
+  memcpy(header.magic, LEVEL_MAGIC, sizeof(header.magic));
+  for (int i = 0; i < GRID_MAX_COLORS; ++i) {
+    struct GridMaterial const *m = &grid->palette[i];
+    float entry[8] = {m->color.x,     m->color.y,    m->color.z,
+                      m->color.w,     m->emissive,   m->roughness,
+                      m->reserved[0], m->reserved[1]};
+    memcpy(header.palette[i], entry, sizeof(entry));
+  }
+
+  // the table is written twice, first as a placeholder to reserve its space
+  uint64_t offset = sizeof(header) + chunk_count * sizeof(struct LevelChunk);
+  ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+       fwrite(entries, sizeof(struct LevelChunk), chunk_count, fp) ==
+           chunk_count;
+
+  for (uint32_t i = 0; ok && i < chunk_count; ++i) {
+    struct GridChunk const *chunk = grid->chunks[i];
+    if (chunk == NULL)
+      continue;
+    grid_chunk_read(grid, i, voxels);
+
+    void const *payload = voxels;
+    struct LevelChunk entry = {.size = GRID_CHUNK_VOLUME,
+                               .solid_count = chunk->solid_count,
+                               .encoding = LEVEL_CHUNK_RAW};
+    if (compress) {
+      size_t size = lz_compress((uint8_t const *)voxels, GRID_CHUNK_VOLUME,
+                                packed, lz_compress_bound(GRID_CHUNK_VOLUME));
+      if (size > 0 && size <= GRID_CHUNK_VOLUME * 3 / 4) {
+        payload = packed;
+        entry.size = (uint32_t)size;
+        entry.encoding = LEVEL_CHUNK_LZ;
+      }
+    }
+
+    // only raw chunks are used in place, compressed ones are packed tight
+    if (entry.encoding == LEVEL_CHUNK_RAW)
+      ok = level_write_padding(fp, &offset);
+    entry.offset = offset;
+    ok = ok && fwrite(payload, 1, entry.size, fp) == entry.size;
+    offset += entry.size;
+    entries[i] = entry;
+  }
+
+  ok = ok && fseek(fp, sizeof(header), SEEK_SET) == 0 &&
+       fwrite(entries, sizeof(struct LevelChunk), chunk_count, fp) ==
+           chunk_count;
+  if (!ok)
+    printf("Failed to write level %s\n", path);
+
+exit:
+  if (fp != NULL && fclose(fp) != 0)
+    ok = false;
+  free(entries);
+  free(voxels);
+  free(packed);
+  return ok;
+}
+
+static bool level_chunk_valid(struct LevelChunk const *entry,
+                              struct FileMap const *map) {
+  if (entry->offset > map->length || entry->size > map->length - entry->offset)
+    return false;
+  if (entry->solid_count == 0 || entry->solid_count > GRID_CHUNK_VOLUME)
+    return false;
+  if (entry->encoding == LEVEL_CHUNK_RAW)
+    return entry->size == GRID_CHUNK_VOLUME;
+  return entry->encoding == LEVEL_CHUNK_LZ;
+}
+
+bool level_load(struct Grid *grid, struct FileMap *map, char const *path) {
+  if (!file_map(map, path))
+    return false;
+  if (!level_load_from(grid, map, path)) {
+    file_unmap(map);
+    return false;
+  }
+  return true;
+}
+
+bool level_load_from(struct Grid *grid, struct FileMap const *map,
+                     char const *path) {
+  struct LevelHeader header;
+  if (map->length < sizeof(header)) {
+    printf("Level %s is truncated\n", path);
+    return false;
+  }
+  memcpy(&header, map->data, sizeof(header));
+  if (memcmp(header.magic, LEVEL_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != LEVEL_VERSION) {
+    printf("%s is not a version %d level\n", path, LEVEL_VERSION);
+    return false;
+  }
+
+  *grid = grid_new(header.size[0], header.size[1], header.size[2],
+                   Vector4_new_point(header.origin[0], header.origin[1],
+                                     header.origin[2]));
+  if (grid->chunks == NULL || grid->chunk_dirty == NULL ||
+      header.chunk_count != grid_chunk_count(grid) ||
+      (map->length - sizeof(header)) / sizeof(struct LevelChunk) <
+          header.chunk_count) {
+    printf("Level %s has a bad chunk table\n", path);
+    goto fail_grid;
+  }
+  for (int i = 0; i < GRID_MAX_COLORS; ++i) {
+    float const *entry = header.palette[i];
+    grid->palette[i] = (struct GridMaterial){
+        .color = {entry[0], entry[1], entry[2], entry[3]},
+        .emissive = entry[4],
+        .roughness = entry[5],
+        .reserved = {entry[6], entry[7]}};
+  }
+
+  uint8_t const *table = map->data + sizeof(header);
+  for (uint32_t i = 0; i < header.chunk_count; ++i) {
+    // the table isn't 8 byte aligned in the file
+    struct LevelChunk entry;
+    memcpy(&entry, table + i * sizeof(entry), sizeof(entry));
+    if (entry.encoding == LEVEL_CHUNK_EMPTY)
+      continue;
+    if (!level_chunk_valid(&entry, map)) {
+      printf("Level %s has a bad chunk %u\n", path, i);
+      goto fail_grid;
+    }
+
+    if (entry.encoding == LEVEL_CHUNK_RAW) {
+      if (!grid_chunk_attach(grid, i, (char *)map->data + entry.offset,
+                             entry.solid_count, true))
+        goto fail_grid;
+      continue;
+    }
+
+    char *voxels = (char *)malloc(GRID_CHUNK_VOLUME);
+    if (voxels == NULL ||
+        !lz_decompress(map->data + entry.offset, entry.size,
+                       (uint8_t *)voxels, GRID_CHUNK_VOLUME)) {
+      printf("Level %s chunk %u failed to decompress\n", path, i);
+      free(voxels);
+      goto fail_grid;
+    }
+    if (!grid_chunk_attach(grid, i, voxels, entry.solid_count, false)) {
+      free(voxels);
+      goto fail_grid;
+    }
+  }
+
+  grid_mark_all_dirty(grid);
+  return true;
+
+fail_grid:
+  grid_free(grid);
+  return false;
+}
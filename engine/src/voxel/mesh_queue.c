@@ -0,0 +1,128 @@
+#include "voxel/mesh_queue.h"
+
+#include "core/profiler.h"
+#include "voxel/grid.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool mesh_queue_new(struct MeshQueue *queue, struct Grid const *grid,
+                    struct JobSystem *jobs, enum MeshFormat format) {
+  memset(queue, 0, sizeof(*queue));
+  queue->jobs = jobs;
+  queue->format = format;
+  queue->chunk_count = grid_chunk_count(grid);
+  queue->in_flight = (uint8_t *)calloc(queue->chunk_count, sizeof(uint8_t));
+  if (queue->in_flight == NULL) {
+    printf("Failed to allocate mesh queue\n");
+    queue->chunk_count = 0;
+    return false;
+  }
+  return true;
+}
+
+void mesh_queue_free(struct MeshQueue *queue) {
+  if (queue->jobs != NULL) {
+    jobs_wait(queue->jobs, &queue->counter);
+  }
+  struct MeshResult *result;
+  while ((result = mesh_queue_pop(queue)) != NULL) {
+    mesh_queue_release(queue, result);
+  }
+  free(queue->in_flight);
+  memset(queue, 0, sizeof(*queue));
+}
+
+// runs on a worker. the snapshot is only needed until the mesh is built.
+static void mesh_queue_job(void *data) {
+  struct MeshResult *result = (struct MeshResult *)data;
+  PROFILE_BEGIN("mesh chunk");
+  mesher_build_snapshot(&result->snapshot, &result->data);
+  mesher_snapshot_free(&result->snapshot);
+  PROFILE_END();
+
+  // Treiber stack push. there is a single consumer that takes the whole list
+  // at once, so nodes are never popped individually and ABA can't happen.
+  struct MeshQueue *queue = result->queue;
+  struct MeshResult *head = __atomic_load_n(&queue->completed, __ATOMIC_RELAXED);
+  do {
+    result->next = head;
+  } while (!__atomic_compare_exchange_n(&queue->completed, &head, result, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+uint32_t mesh_queue_dispatch(struct MeshQueue *queue, struct Grid *grid,
+                             uint32_t max_chunks) {
+  PROFILE_BEGIN("mesh dispatch");
+  struct Job jobs[MESH_QUEUE_MAX_IN_FLIGHT];
+  uint32_t job_count = 0;
+  if (max_chunks > MESH_QUEUE_MAX_IN_FLIGHT - queue->in_flight_count)
+    max_chunks = MESH_QUEUE_MAX_IN_FLIGHT - queue->in_flight_count;
+
+  uint32_t scanned = 0;
+  for (; scanned < queue->chunk_count && job_count < max_chunks; ++scanned) {
+    uint32_t i = (queue->cursor + scanned) % queue->chunk_count;
+    if (queue->in_flight[i] || !grid_chunk_is_dirty(grid, i))
+      continue;
+
+    struct MeshResult *result =
+        (struct MeshResult *)calloc(1, sizeof(struct MeshResult));
+    if (result == NULL) {
+      printf("Failed to allocate mesh result\n");
+      break;
+    }
+    if (!mesher_snapshot_chunk(&result->snapshot, grid, queue->format, i)) {
+      free(result);
+      break;
+    }
+    grid_chunk_clear_dirty(grid, i);
+    result->chunk_index = i;
+    result->data = mesh_data_new(queue->format);
+    result->queue = queue;
+
+    queue->in_flight[i] = 1;
+    queue->in_flight_count++;
+    jobs[job_count++] = (struct Job){.func = mesh_queue_job, .data = result};
+  }
+  queue->cursor = queue->chunk_count > 0
+                      ? (queue->cursor + scanned) % queue->chunk_count
+                      : 0;
+
+  queue->chunks_dispatched = job_count;
+  if (job_count > 0) {
+    jobs_run(queue->jobs, jobs, job_count, &queue->counter);
+    if (queue->jobs->worker_count == 0)
+      jobs_wait(queue->jobs, &queue->counter);
+  }
+  PROFILE_END();
+  return job_count;
+}
+
+struct MeshResult *mesh_queue_pop(struct MeshQueue *queue) {
+  if (queue->ready == NULL) {
+    struct MeshResult *list =
+        __atomic_exchange_n(&queue->completed, NULL, __ATOMIC_ACQUIRE);
+    // newest first, reverse it so chunks come out in the order they finished
+    while (list != NULL) {
+      struct MeshResult *next = list->next;
+      list->next = queue->ready;
+      queue->ready = list;
+      list = next;
+    }
+  }
+
+  struct MeshResult *result = queue->ready;
+  if (result != NULL) {
+    queue->ready = result->next;
+    result->next = NULL;
+  }
+  return result;
+}
+
+void mesh_queue_release(struct MeshQueue *queue, struct MeshResult *result) {
+  queue->in_flight[result->chunk_index] = 0;
+  queue->in_flight_count--;
+  mesh_data_free(&result->data);
+  free(result);
+}
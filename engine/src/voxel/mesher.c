@@ -0,0 +1,436 @@
+#include "voxel/mesher.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct MeshData mesh_data_new(enum MeshFormat format) {
+  return (struct MeshData){.format = format};
+}
+
+size_t mesh_format_vertex_size(enum MeshFormat format) {
+  switch (format) {
+  case MESH_FORMAT_PACKED:
+    return sizeof(struct MeshVertex);
+  case MESH_FORMAT_FLOAT:
+    return MESHER_VERTEX_FLOATS * sizeof(float);
+  default:
+    return 0;
+  }
+}
+
+size_t mesh_format_quad_size(enum MeshFormat format) {
+  switch (format) {
+  case MESH_FORMAT_PACKED:
+    return 4 * sizeof(struct MeshVertex);
+  case MESH_FORMAT_FLOAT:
+    return 6 * MESHER_VERTEX_FLOATS * sizeof(float);
+  default:
+    return 2 * sizeof(uint32_t);
+  }
+}
+
+uint32_t mesh_data_triangle_count(struct MeshData const *data) {
+  // 4 vertices per quad unless it is a plain triangle list
+  return data->format == MESH_FORMAT_FLOAT ? data->vertex_count / 3
+                                           : data->vertex_count / 2;
+}
+
+void mesh_data_free(struct MeshData *data) {
+  free(data->vertices);
+  *data = (struct MeshData){0};
+}
+
+void mesh_data_clear(struct MeshData *data) {
+  data->vertices_size = 0;
+  data->vertex_count = 0;
+}
+
+static bool mesh_data_reserve(struct MeshData *data, size_t bytes) {
+  if (data->vertices_size + bytes <= data->vertices_capacity)
+    return true;
+
+  size_t new_capacity =
+      data->vertices_capacity ? data->vertices_capacity * 2 : 4096;
+  while (new_capacity < data->vertices_size + bytes) {
+    new_capacity *= 2;
+  }
+
+  uint8_t *vertices = (uint8_t *)realloc(data->vertices, new_capacity);
+  if (vertices == NULL) {
+    printf("Failed to resize mesh data\n");
+    return false;
+  }
+  data->vertices = vertices;
+  data->vertices_capacity = new_capacity;
+  return true;
+}
+
+bool mesher_snapshot_region(struct MeshSnapshot *snapshot,
+                            struct Grid const *grid, enum MeshFormat format,
+                            uint32_t min_x, uint32_t min_y, uint32_t min_z,
+                            uint32_t max_x, uint32_t max_y, uint32_t max_z) {
+  int32_t min[3] = {(int32_t)min_x, (int32_t)min_y, (int32_t)min_z};
+  int32_t max[3] = {(int32_t)max_x, (int32_t)max_y, (int32_t)max_z};
+  for (int i = 0; i < 3; ++i) {
+    snapshot->min[i] = min[i];
+    snapshot->size[i] = max[i] > min[i] ? max[i] - min[i] + 2 : 2;
+  }
+
+  size_t count = (size_t)snapshot->size[0] * snapshot->size[1] *
+                 (size_t)snapshot->size[2];
+  snapshot->data = (uint8_t *)malloc(count);
+  snapshot->palette = NULL;
+  if (snapshot->data == NULL) {
+    printf("Failed to allocate mesher region\n");
+    return false;
+  }
+  // only float meshes resolve colors, the rest draw through the palette
+  // uniform block
+  if (format == MESH_FORMAT_FLOAT) {
+    snapshot->palette =
+        (struct Vector4 *)malloc(GRID_MAX_COLORS * sizeof(struct Vector4));
+    if (snapshot->palette == NULL) {
+      printf("Failed to allocate mesher palette\n");
+      mesher_snapshot_free(snapshot);
+      return false;
+    }
+    for (int i = 0; i < GRID_MAX_COLORS; ++i) {
+      snapshot->palette[i] = grid->palette[i].color;
+    }
+  }
+
+  int32_t grid_size[3] = {(int32_t)grid->size_x, (int32_t)grid->size_y,
+                          (int32_t)grid->size_z};
+  uint8_t *dst = snapshot->data;
+  for (int32_t z = min[2] - 1; z < min[2] + snapshot->size[2] - 1; ++z) {
+    for (int32_t y = min[1] - 1; y < min[1] + snapshot->size[1] - 1; ++y) {
+      for (int32_t x = min[0] - 1; x < min[0] + snapshot->size[0] - 1; ++x) {
+        bool inside = x >= 0 && y >= 0 && z >= 0 && x < grid_size[0] &&
+                      y < grid_size[1] && z < grid_size[2];
+        *dst++ = inside ? (uint8_t)grid_get(grid, x, y, z) : GRID_EMPTY;
+      }
+    }
+  }
+  return true;
+}
+
+bool mesher_snapshot_chunk(struct MeshSnapshot *snapshot,
+                           struct Grid const *grid, enum MeshFormat format,
+                           uint32_t chunk_index) {
+  uint32_t cx, cy, cz;
+  grid_chunk_coords(grid, chunk_index, &cx, &cy, &cz);
+  uint32_t min_x = cx << GRID_CHUNK_SHIFT;
+  uint32_t min_y = cy << GRID_CHUNK_SHIFT;
+  uint32_t min_z = cz << GRID_CHUNK_SHIFT;
+  uint32_t max_x = min_x + GRID_CHUNK_SIZE;
+  uint32_t max_y = min_y + GRID_CHUNK_SIZE;
+  uint32_t max_z = min_z + GRID_CHUNK_SIZE;
+  return mesher_snapshot_region(
+      snapshot, grid, format, min_x, min_y, min_z,
+      max_x < grid->size_x ? max_x : grid->size_x,
+      max_y < grid->size_y ? max_y : grid->size_y,
+      max_z < grid->size_z ? max_z : grid->size_z);
+}
+
+void mesher_snapshot_free(struct MeshSnapshot *snapshot) {
+  free(snapshot->data);
+  free(snapshot->palette);
+  snapshot->data = NULL;
+  snapshot->palette = NULL;
+}
+
+// coordinates are region local and may step one voxel outside the region.
+static int32_t padded_region_index(struct MeshSnapshot const *region,
+                                   int32_t const p[3]) {
+  return ((p[2] + 1) * region->size[1] + (p[1] + 1)) * region->size[0] +
+         (p[0] + 1);
+}
+
+// brightness of each ambient occlusion level for MESH_FORMAT_FLOAT, the
+// shaders use the same curve.
+static const float mesher_ao_curve[MESH_AO_MAX + 1] = {0.45f, 0.65f, 0.85f,
+                                                       1.f};
+
+static uint32_t mesher_solid(uint8_t const *voxel) {
+  return *voxel != GRID_EMPTY ? 1 : 0;
+}
+
+// ambient occlusion of the 4 corners of a unit face, 2 bits each in the
+// order (0, 0), (1, 0), (1, 1), (0, 1) along u and v. air is the empty voxel
+// in front of the face, each corner looks at its two side neighbours and the
+// diagonal one in that layer.
+static uint32_t mesher_face_ao(uint8_t const *air, int32_t stride_u,
+                               int32_t stride_v) {
+  // indexed by side u | side v << 1 | diagonal << 2, two sides hide the
+  // diagonal and close the corner off completely
+  static const uint8_t levels[8] = {3, 2, 2, 0, 2, 1, 1, 0};
+  uint32_t side_u0 = mesher_solid(air - stride_u);
+  uint32_t side_u1 = mesher_solid(air + stride_u);
+  uint32_t side_v0 = mesher_solid(air - stride_v) << 1;
+  uint32_t side_v1 = mesher_solid(air + stride_v) << 1;
+  uint32_t c0 = side_u0 | side_v0 | mesher_solid(air - stride_u - stride_v) << 2;
+  uint32_t c1 = side_u1 | side_v0 | mesher_solid(air + stride_u - stride_v) << 2;
+  uint32_t c2 = side_u1 | side_v1 | mesher_solid(air + stride_u + stride_v) << 2;
+  uint32_t c3 = side_u0 | side_v1 | mesher_solid(air - stride_u + stride_v) << 2;
+  return levels[c0] | (uint32_t)levels[c1] << 2 | (uint32_t)levels[c2] << 4 |
+         (uint32_t)levels[c3] << 6;
+}
+
+// corners are region local voxel corners, counter clockwise seen from the
+// side the face points to. ao is the mesher_face_ao of the faces merged into
+// the quad.
+static void mesher_emit_quad(struct MeshData *out,
+                             struct MeshSnapshot const *region,
+                             int32_t const corners[4][3], int axis, int sign,
+                             int color, uint32_t ao) {
+  static const int order[6] = {0, 1, 2, 2, 3, 0};
+  // -axis faces walk their corners v first
+  static const int ao_corner[2][4] = {{0, 1, 2, 3}, {0, 3, 2, 1}};
+  uint32_t vertex_count = out->format == MESH_FORMAT_FLOAT ? 6 : 4;
+  size_t quad_size = mesh_format_quad_size(out->format);
+  if (!mesh_data_reserve(out, quad_size))
+    return;
+
+  uint32_t levels[4];
+  for (int i = 0; i < 4; ++i) {
+    levels[i] = (ao >> (2 * ao_corner[sign > 0 ? 0 : 1][i])) & 3;
+  }
+  // split along the darker diagonal, otherwise a single occluded corner
+  // shades one triangle and the seam between them shows
+  int flip = levels[0] + levels[2] > levels[1] + levels[3] ? 1 : 0;
+
+  uint8_t face = (uint8_t)(axis * 2 + (sign > 0 ? 0 : 1));
+  if (out->format == MESH_FORMAT_FACES) {
+    // corner 0 is the min corner of the quad, 2 the opposite one. the plane
+    // of a +axis face is the far side of the voxel it belongs to
+    int u = (axis + 1) % 3;
+    int v = (axis + 2) % 3;
+    uint32_t voxel[3] = {(uint32_t)corners[0][0], (uint32_t)corners[0][1],
+                         (uint32_t)corners[0][2]};
+    if (sign > 0)
+      voxel[axis] -= 1;
+    uint32_t width = (uint32_t)(corners[2][u] - corners[0][u]);
+    uint32_t height = (uint32_t)(corners[2][v] - corners[0][v]);
+    uint32_t words[2];
+    words[0] = voxel[0] | voxel[1] << 4 | voxel[2] << 8 |
+               (uint32_t)face << MESH_FACE_WORD_FACE_SHIFT |
+               (width - 1) << MESH_FACE_WORD_WIDTH_SHIFT |
+               (height - 1) << MESH_FACE_WORD_HEIGHT_SHIFT |
+               (uint32_t)(color & 0xFF) << MESH_FACE_WORD_COLOR_SHIFT |
+               (flip ? MESH_FACE_WORD_FLIP_BIT : 0);
+    words[1] = levels[0] | levels[1] << 2 | levels[2] << 4 | levels[3] << 6;
+    memcpy(out->vertices + out->vertices_size, words, sizeof(words));
+  } else if (out->format == MESH_FORMAT_PACKED) {
+    struct MeshVertex *dst =
+        (struct MeshVertex *)(out->vertices + out->vertices_size);
+    for (int i = 0; i < 4; ++i) {
+      int corner = (i + flip) & 3;
+      int32_t const *c = corners[corner];
+      dst[i] = (struct MeshVertex){
+          .x = (uint8_t)c[0],
+          .y = (uint8_t)c[1],
+          .z = (uint8_t)c[2],
+          .face_ao = (uint8_t)(face | levels[corner] << MESH_AO_SHIFT),
+          .color = (uint8_t)color};
+    }
+  } else {
+    float normal[3] = {0.f, 0.f, 0.f};
+    normal[axis] = (float)sign;
+    struct Vector4 rgb = region->palette[color % GRID_MAX_COLORS];
+    float *dst = (float *)(out->vertices + out->vertices_size);
+    for (int i = 0; i < 6; ++i) {
+      int corner = (order[i] + flip) & 3;
+      int32_t const *c = corners[corner];
+      float light = mesher_ao_curve[levels[corner]];
+      for (int k = 0; k < 3; ++k) {
+        *dst++ = (float)(region->min[k] + c[k]) - 0.5f;
+      }
+      *dst++ = normal[0];
+      *dst++ = normal[1];
+      *dst++ = normal[2];
+      *dst++ = rgb.x * light;
+      *dst++ = rgb.y * light;
+      *dst++ = rgb.z * light;
+    }
+  }
+  out->vertices_size += quad_size;
+  out->vertex_count += vertex_count;
+}
+
+// classic greedy meshing: sweep each axis, build a mask of visible faces
+// between two slices, then grow rectangles of identical mask entries.
+// entries are the color with the face's ambient occlusion above it (bit 8),
+// positive ones face +axis, negative ones -axis. neighbouring faces share the
+// occlusion of their common corners, so merging equal entries loses nothing.
+static void mesher_greedy(struct MeshSnapshot const *region, int32_t *mask,
+                          struct MeshData *out) {
+  int32_t dims[3] = {region->size[0] - 2, region->size[1] - 2,
+                     region->size[2] - 2};
+  int32_t stride[3] = {1, region->size[0], region->size[0] * region->size[1]};
+
+  for (int d = 0; d < 3; ++d) {
+    int u = (d + 1) % 3;
+    int v = (d + 2) % 3;
+    int32_t x[3] = {0, 0, 0};
+
+    for (x[d] = 0; x[d] <= dims[d]; ++x[d]) {
+      bool back_inside = x[d] > 0;
+      bool front_inside = x[d] < dims[d];
+
+      // build the face mask between slice x[d] - 1 and x[d]
+      int32_t n = 0;
+      for (x[v] = 0; x[v] < dims[v]; ++x[v]) {
+        x[u] = 0;
+        uint8_t const *front = region->data + padded_region_index(region, x);
+        uint8_t const *back = front - stride[d];
+        for (; x[u] < dims[u]; ++x[u], ++n) {
+          uint8_t a = *back;
+          uint8_t b = *front;
+
+          int32_t m = 0;
+          if (a != GRID_EMPTY && b == GRID_EMPTY && back_inside) {
+            m = (int32_t)(a | mesher_face_ao(front, stride[u], stride[v]) << 8);
+          } else if (b != GRID_EMPTY && a == GRID_EMPTY && front_inside) {
+            m = -(int32_t)(b | mesher_face_ao(back, stride[u], stride[v]) << 8);
+          }
+          mask[n] = m;
+          back += stride[u];
+          front += stride[u];
+        }
+      }
+
+      // merge the mask into rectangles
+      n = 0;
+      for (int32_t j = 0; j < dims[v]; ++j) {
+        for (int32_t i = 0; i < dims[u];) {
+          int32_t m = mask[n];
+          if (m == 0) {
+            ++i;
+            ++n;
+            continue;
+          }
+
+          int32_t w = 1;
+          while (i + w < dims[u] && mask[n + w] == m) {
+            ++w;
+          }
+
+          int32_t h = 1;
+          for (; j + h < dims[v]; ++h) {
+            bool row_matches = true;
+            for (int32_t k = 0; k < w; ++k) {
+              if (mask[n + k + h * dims[u]] != m) {
+                row_matches = false;
+                break;
+              }
+            }
+            if (!row_matches)
+              break;
+          }
+
+          int32_t base[3];
+          base[d] = x[d];
+          base[u] = i;
+          base[v] = j;
+
+          int32_t corners[4][3];
+          for (int c = 0; c < 4; ++c) {
+            corners[c][0] = base[0];
+            corners[c][1] = base[1];
+            corners[c][2] = base[2];
+          }
+          // keep the winding counter clockwise when viewed along the normal
+          int du_corner = m > 0 ? 1 : 3;
+          int dv_corner = m > 0 ? 3 : 1;
+          corners[du_corner][u] += w;
+          corners[2][u] += w;
+          corners[2][v] += h;
+          corners[dv_corner][v] += h;
+
+          uint32_t entry = (uint32_t)(m > 0 ? m : -m);
+          mesher_emit_quad(out, region, corners, d, m > 0 ? 1 : -1,
+                           (int)(entry & 0xFF), entry >> 8);
+
+          for (int32_t l = 0; l < h; ++l) {
+            memset(&mask[n + l * dims[u]], 0, w * sizeof(int32_t));
+          }
+          i += w;
+          n += w;
+        }
+      }
+    }
+  }
+}
+
+void mesher_build_snapshot(struct MeshSnapshot const *snapshot,
+                           struct MeshData *out) {
+  // the mask is sized for the largest slice of the region
+  int32_t dims[3] = {snapshot->size[0] - 2, snapshot->size[1] - 2,
+                     snapshot->size[2] - 2};
+  if (dims[0] <= 0 || dims[1] <= 0 || dims[2] <= 0)
+    return;
+  if (out->format == MESH_FORMAT_PACKED &&
+      (dims[0] > MESHER_PACKED_MAX_SIZE || dims[1] > MESHER_PACKED_MAX_SIZE ||
+       dims[2] > MESHER_PACKED_MAX_SIZE)) {
+    printf("Region too large for packed vertices\n");
+    return;
+  }
+  if (out->format == MESH_FORMAT_FACES &&
+      (dims[0] > MESHER_FACES_MAX_SIZE || dims[1] > MESHER_FACES_MAX_SIZE ||
+       dims[2] > MESHER_FACES_MAX_SIZE)) {
+    printf("Region too large for face words\n");
+    return;
+  }
+  if (out->format == MESH_FORMAT_FLOAT && snapshot->palette == NULL) {
+    printf("Snapshot has no palette for float vertices\n");
+    return;
+  }
+  int32_t mask_size = dims[0] * dims[1];
+  if (dims[1] * dims[2] > mask_size)
+    mask_size = dims[1] * dims[2];
+  if (dims[2] * dims[0] > mask_size)
+    mask_size = dims[2] * dims[0];
+
+  int32_t *mask = (int32_t *)malloc(mask_size * sizeof(int32_t));
+  if (mask == NULL) {
+    printf("Failed to allocate mesher mask\n");
+    return;
+  }
+
+  mesher_greedy(snapshot, mask, out);
+  free(mask);
+}
+
+void mesher_build_region(struct Grid const *grid, uint32_t min_x,
+                         uint32_t min_y, uint32_t min_z, uint32_t max_x,
+                         uint32_t max_y, uint32_t max_z, struct MeshData *out) {
+  if (max_x <= min_x || max_y <= min_y || max_z <= min_z)
+    return;
+
+  struct MeshSnapshot snapshot;
+  if (!mesher_snapshot_region(&snapshot, grid, out->format, min_x, min_y,
+                              min_z, max_x, max_y, max_z))
+    return;
+  mesher_build_snapshot(&snapshot, out);
+  mesher_snapshot_free(&snapshot);
+}
+
+void mesher_build_chunk(struct Grid const *grid, uint32_t chunk_index,
+                        struct MeshData *out) {
+  // only solid voxels own faces, so an unallocated chunk has no geometry
+  if (grid->chunks[chunk_index] == NULL)
+    return;
+
+  struct MeshSnapshot snapshot;
+  if (!mesher_snapshot_chunk(&snapshot, grid, out->format, chunk_index))
+    return;
+  mesher_build_snapshot(&snapshot, out);
+  mesher_snapshot_free(&snapshot);
+}
+
+void mesher_build(struct Grid const *grid, struct MeshData *out) {
+  mesher_build_region(grid, 0, 0, 0, grid->size_x, grid->size_y, grid->size_z,
+                      out);
+}